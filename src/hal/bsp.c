@@ -89,6 +89,10 @@
 uint32_t SystemCoreClock =
     72000000U; /*!< System Clock Frequency (Core Clock) */
 static UART_HandleTypeDef huart1;
+static DMA_HandleTypeDef hdma_usart1_rx;
+static DMA_HandleTypeDef hdma_usart1_tx;
+/* length of the terminal_out_buffer run the tx dma is sending, 0 when idle */
+static volatile Byte uart1_tx_len;
 
 const uint8_t AHBPrescTable[16U] = {0, 0, 0, 0, 0, 0, 0, 0,
                                     1, 2, 3, 4, 6, 7, 8, 9};
@@ -108,13 +112,20 @@ void BspInit() {
   SystemClock_Config();
   GPIO_Init();
 
-  /* To not be optimized */
-  HAL_UART_Receive_IT(&huart1, &terminal_buffer[terminal_buffer_insert_index],
-                      1);
-  USART1_IRQHandler();
-  /* __HAL_UART_ENABLE_IT(&huart1, UART_IT_RXNE); */
+  /* The dma channel fills the whole ring on its own, interrupts only move the
+   * insert index: on idle line, half transfer and transfer complete */
+  HAL_UART_Receive_DMA(&huart1, terminal_buffer, TIB_SIZE);
+  __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
   __enable_irq();
 }
+/* Sleep until the next interrupt, the reader spins on this while the
+ * terminal buffer is empty */
+void BspWaitInput() { __WFI(); }
+/* Called while a form is incomplete, before each wait for input; the
+ * application overrides it to run background work in short steps and
+ * returns true when it did some, so the reader polls again before the core
+ * sleeps */
+__attribute__((weak)) bool BspIdle() { return false; }
 /*  */
 
 /* end of stack defined in the linker script ---------------------*/
@@ -446,6 +457,7 @@ void GPIO_Init() {
   __HAL_RCC_GPIOC_CLK_ENABLE();
   __HAL_RCC_AFIO_CLK_ENABLE();
   __HAL_RCC_USART1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
   UART1_Init();
 }
 
@@ -481,27 +493,113 @@ void UART1_Init() {
   if (HAL_UART_Init(&huart1) != HAL_OK) {
     Error_Handler();
   }
+
+  /* USART1_RX is wired to DMA1 channel 5 */
+  hdma_usart1_rx.Instance = DMA1_Channel5;
+  hdma_usart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+  hdma_usart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
+  hdma_usart1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+  if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK) {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(&huart1, hdmarx, hdma_usart1_rx);
+
+  /* USART1_TX is wired to DMA1 channel 4 */
+  hdma_usart1_tx.Instance = DMA1_Channel4;
+  hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+  hdma_usart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma_usart1_tx.Init.MemInc = DMA_MINC_ENABLE;
+  hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+  hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+  hdma_usart1_tx.Init.Priority = DMA_PRIORITY_LOW;
+  if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK) {
+    Error_Handler();
+  }
+  __HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
+
   /* Peripheral interrupt init*/
+  HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+  HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
   HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(USART1_IRQn);
 
   /* Initialize uart buffer */
   terminal_buffer_get_index = terminal_buffer_insert_index = 0;
+  terminal_out_get_index = terminal_out_insert_index = 0;
+}
+
+/* Start the tx dma on the contiguous run of pending output, the rest (and
+ * whatever is written meanwhile) goes out as the next run from
+ * HAL_UART_TxCpltCallback. Must run with interrupts off or from the isr. */
+static void UART1_TxStart() {
+  Byte get = terminal_out_get_index, insert = terminal_out_insert_index;
+  if (uart1_tx_len || get == insert) {
+    return;
+  }
+  uart1_tx_len = (Byte)((insert > get ? insert : TOB_SIZE) - get);
+  HAL_UART_Transmit_DMA(&huart1, &terminal_out_buffer[get], uart1_tx_len);
+}
+static void UART1_TxKick() {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  UART1_TxStart();
+  __set_PRIMASK(primask);
+}
+static inline bool UART1_TxFull() {
+  /* the indices are masked, so is their distance */
+  return ((Byte)(terminal_out_insert_index - terminal_out_get_index) &
+          (TOB_SIZE - 1)) >= TOB_SIZE - 1;
+}
+/* Queue one byte, waiting for the dma to make room if the ring is full. With
+ * interrupts masked nothing would ever drain it, so the byte is dropped. */
+static void UART1_TxPut(uint8_t c) {
+  if (UART1_TxFull()) {
+    ++terminal_out_stalls;
+    UART1_TxKick();
+    while (UART1_TxFull()) {
+      if (__get_PRIMASK()) {
+        return;
+      }
+      __WFI();
+    }
+  }
+  terminal_out_buffer[terminal_out_insert_index] = c;
+  terminal_out_insert_index =
+      (Byte)((terminal_out_insert_index + 1) & (TOB_SIZE - 1));
 }
 
-/* TODO: Check for errors */
 void UART1_SendStr(char *s) {
-  HAL_UART_Transmit(&huart1, (uint8_t *)s, (uint16_t)strlen(s), 10);
-  /* __HAL_UART_FLUSH_DRREGISTER(&huart1); */
+  while (*s) {
+    UART1_TxPut((uint8_t)*s++);
+  }
+  UART1_TxKick();
 }
-/* TODO: Check for errors */
 void UART1_SendStrN(char *s, uint16_t len) {
-  HAL_UART_Transmit(&huart1, (uint8_t *)s, len, 10);
-  /* __HAL_UART_FLUSH_DRREGISTER(&huart1); */
+  while (len--) {
+    UART1_TxPut((uint8_t)*s++);
+  }
+  UART1_TxKick();
 }
 void UART1_SendByte(uint8_t c) {
-  HAL_UART_Transmit(&huart1, (uint8_t *)&c, 1, 10);
-  /* __HAL_UART_FLUSH_DRREGISTER(&huart1); */
+  UART1_TxPut(c);
+  UART1_TxKick();
+}
+/* Wait until every queued byte has been handed to the uart */
+void UART1_Flush() {
+  UART1_TxKick();
+  while (uart1_tx_len || terminal_out_get_index != terminal_out_insert_index) {
+    if (__get_PRIMASK()) {
+      return;
+    }
+    __WFI();
+  }
 }
 
 void SysTick_Handler(void) {
@@ -509,24 +607,54 @@ void SysTick_Handler(void) {
   HAL_SYSTICK_IRQHandler();
 }
 
+/* The dma counter counts down the bytes left before it wraps to the start of
+ * the ring, so the next byte lands at TIB_SIZE - counter */
+static void UART1_RxSync() {
+  terminal_buffer_insert_index =
+      (Byte)((TIB_SIZE - __HAL_DMA_GET_COUNTER(&hdma_usart1_rx)) &
+             (TIB_SIZE - 1));
+}
+
 void USART1_IRQHandler(void) {
-  /* terminal_buffer[terminal_buffer_insert_index] = USART1->DR; */
-  /* terminal_buffer_insert_index += 1; */
-  /* terminal_buffer_insert_index &= (TIB_SIZE - 1); */
+  if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_IDLE)) {
+    /* the sender paused: publish what the dma has stored so far */
+    __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+    UART1_RxSync();
+  }
   HAL_UART_IRQHandler(&huart1);
 }
 
-/* This callback is called by the HAL_UART_IRQHandler when the given number of
- * bytes are received */
+void DMA1_Channel4_IRQHandler(void) { HAL_DMA_IRQHandler(&hdma_usart1_tx); }
+void DMA1_Channel5_IRQHandler(void) { HAL_DMA_IRQHandler(&hdma_usart1_rx); }
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+  if (huart->Instance == USART1) {
+    terminal_out_get_index =
+        (Byte)((terminal_out_get_index + uart1_tx_len) & (TOB_SIZE - 1));
+    uart1_tx_len = 0;
+    UART1_TxStart();
+  }
+}
+
+/* Half transfer and transfer complete keep a continuous stream, which never
+ * goes idle, from lapping the reader unnoticed */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart) {
+  if (huart->Instance == USART1) {
+    UART1_RxSync();
+  }
+}
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
   if (huart->Instance == USART1) {
-    terminal_buffer_insert_index += 1;
-    terminal_buffer_insert_index &= (TIB_SIZE - 1);
-    /* needed to fix locking huart1 while transmitting */
-    __HAL_UNLOCK(&huart1);
-    /* Receive one byte in interrupt mode */
-    HAL_UART_Receive_IT(&huart1, &terminal_buffer[terminal_buffer_insert_index],
-                        1);
+    UART1_RxSync();
+  }
+}
+
+/* Overrun or noise aborts the dma in the hal, the unread input is lost
+ * anyway, so drop it and restart from the start of the ring */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+  if (huart->Instance == USART1) {
+    terminal_buffer_get_index = terminal_buffer_insert_index = 0;
+    HAL_UART_Receive_DMA(&huart1, terminal_buffer, TIB_SIZE);
   }
 }
 
@@ -77,6 +77,7 @@
 #ifndef HAL_BSP_H_INCLUDED
 #define HAL_BSP_H_INCLUDED
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define HSE_VALUE 8000000U
@@ -95,11 +96,15 @@ void SystemClock_Config();
 void UART1_Init();
 void GPIO_Init();
 void BspInit();
+void BspWaitInput();
+/* background work between input bytes, true when it did some */
+bool BspIdle();
 void IrqOn();
 void IrqOff();
 void UART1_SendStr(char *s);
 void UART1_SendStrN(char *s, uint16_t len);
 void UART1_SendByte(uint8_t s);
+void UART1_Flush();
 void SystemInit(void);
 void SystemCoreClockUpdate(void);
 
@@ -67,10 +67,53 @@
 #include "lispdoor/symboltree.h"
 #include "lispdoor/utils.h"
 
+/* call builtin fun with its nargs arguments on top of the stack, arity is
+   checked here once so builtins need not to */
+LispObject LispCallCFunction(LispObject fun, LispIndex nargs) {
+  struct LispCFunction *f = &fun->cfun;
+  if (nargs < f->min_args) {
+    ArgCount(f->name, nargs, f->min_args);
+  } else if (f->max_args != LISP_ARGS_ANY && nargs > f->max_args) {
+    ArgCount(f->name, nargs, f->max_args);
+  }
+  switch (f->f_type) {
+    case kFunctionUnary:
+      return (f->f1)(stack[stack_index - 1]);
+    case kFunctionBinary:
+      return (f->f2)(stack[stack_index - 2], stack[stack_index - 1]);
+    default:
+      return (f->f)(nargs);
+  }
+}
+
+/* call the function below its nargs arguments on top of the stack */
+LispObject LispFuncall(LispIndex nargs) {
+  LispIndex base = (LispIndex)(stack_index - nargs), i;
+  LispObject f = stack[base - 1];
+  if (LISP_CFunctionP(f)) {
+    if (LISP_CFUNCTION_SPECIALP(f)) {
+      LispErrorBegin();
+      LispPrintStr("apply: error: cannot apply special operator ");
+      LispPrintStr(f->cfun.name);
+      LispError("\n");
+    }
+    return LispCallCFunction(f, nargs);
+  }
+  /* closures take their arguments as a list */
+  PUSH(LISP_NIL);
+  for (i = nargs; i > 0; --i) {
+    stack[stack_index - 1] =
+        cons(stack[base + i - 1], stack[stack_index - 1]);
+  }
+  f = POP();
+  return LispApply(stack[base - 1], f);
+}
+
 LispObject LispApply(LispObject fun, LispObject arg_list) {
   LispObject v, ans, *arg_syms, sym, *body, *frame;
   LispIndex saved_stack_index = stack_index, nargs;
   LispEnvPtr penv = LispEnv();
+  LispIndex closure_depth = penv->closure_depth;
   /* protect from GC */
   PUSH(penv->frame);
   PUSH(arg_list);
@@ -82,12 +125,12 @@ LispObject LispApply(LispObject fun, LispObject arg_list) {
     v = arg_list;
     /* evaluate argument list, placing arguments on stack */
     while (LISP_ConsP(v)) {
-      PUSH(v);
+      PUSH(LISP_CONS_CAR(v));
       v = LISP_CONS_CDR(v);
     }
-    nargs = (LispIndex)(stack_index - saved_stack_index - 4);
+    nargs = (LispIndex)(stack_index - saved_stack_index - 3);
     /* call function */
-    ans = (fun->cfun.f)(nargs);
+    ans = LispCallCFunction(fun, nargs);
   } else if (LISP_ConsP(fun) && LISP_SymbolP(LISP_CONS_CAR(fun)) &&
              (strcmp(LISP_CONS_CAR(fun)->symbol.name, "lambda") == 0 ||
               strcmp(LISP_CONS_CAR(fun)->symbol.name, "macro") == 0 ||
@@ -134,11 +177,14 @@ LispObject LispApply(LispObject fun, LispObject arg_list) {
     }
 
     penv->frame = *frame;
+    penv->closure_depth = (LispIndex)(closure_depth + 1);
     if (macro_p) {
       stack_index = saved_stack_index;
       PUSH(stack[saved_stack_index]);
       ans = EVAL(*body, penv);
       penv->frame = POP();
+      /* the expansion runs where the macro was called */
+      penv->closure_depth = closure_depth;
       ans = EVAL(ans, penv);
     } else {
       ans = EVAL(*body, penv);
@@ -149,13 +195,14 @@ LispObject LispApply(LispObject fun, LispObject arg_list) {
     ans = LISP_NIL;
   }
   penv->frame = stack[saved_stack_index];
+  penv->closure_depth = closure_depth;
   stack_index = saved_stack_index;
   return ans;
 }
 
 LispObject EvalSexpr(LispObject expr, LispEnvPtr penv) {
   LispObject ans, v, arg_list, bind, func, *frame;
-  LispIndex saved_stack_index;
+  LispIndex saved_stack_index, closure_depth = penv->closure_depth;
 EVAL_TOP:
   if ((Byte *)&ans < stack_bottom) {
     LispError("eval: error: c-stack overflow\n");
@@ -184,6 +231,7 @@ EVAL_TOP:
       ans = expr->symbol.value;
     }
     if (LISP_UNBOUNDP(ans)) {
+      LispErrorBegin();
       LispPrintStr("eval: error: variable ");
       LispPrintStr(LispSymbolName(expr));
       LispError(" has no value\n");
@@ -219,7 +267,7 @@ EVAL_TOP:
         }
         nargs = stack_index - nargs;
         /* call function */
-        ans = ((*fun)->cfun.f)(nargs);
+        ans = LispCallCFunction(*fun, nargs);
       } else if (LISP_ConsP(func) && LISP_SymbolP(LISP_CONS_CAR(func)) &&
                  (strcmp(LISP_CONS_CAR(func)->symbol.name, "lambda") == 0 ||
                   strcmp(LISP_CONS_CAR(func)->symbol.name, "macro") == 0 ||
@@ -295,11 +343,14 @@ EVAL_TOP:
           }
         }
         penv->frame = *frame;
+        penv->closure_depth = (LispIndex)(closure_depth + 1);
         if (macro_p) {
           stack_index = saved_stack_index;
           PUSH(stack[saved_stack_index + 1]);
           ans = EVAL(*body, penv);
           penv->frame = POP();
+          /* the expansion runs where the macro was called */
+          penv->closure_depth = closure_depth;
           TAIL_EVAL(ans, penv);
         } else {
           TAIL_EVAL(*body, penv);
@@ -314,6 +365,7 @@ EVAL_TOP:
   }
   stack_index = saved_stack_index;
   penv->frame = stack[saved_stack_index + 1];
+  penv->closure_depth = closure_depth;
   return ans;
 }
 
@@ -322,6 +374,7 @@ LispObject TopLevelEval(LispObject expr) {
   LispObject v;
   LispIndex saved_stack_index = stack_index;
   LispEnv()->frame = LISP_NIL;
+  LispEnv()->closure_depth = 0; /* an error may have left it raised */
   v = EVAL(expr, LispEnv());
   LispEnv()->frame = LISP_NIL;
   stack_index = saved_stack_index;
@@ -67,14 +67,17 @@
 #define TAIL_EVAL(xpr, env)                         \
   do {                                              \
     stack_index = saved_stack_index;                \
+    expr = (xpr);                                   \
     if ((LISP_ATOM(expr) && !LISP_SymbolP(expr))) { \
-      return (xpr);                                 \
-    } else {                                        \
-      expr = (xpr);                                 \
-      penv = (env);                                 \
-      goto EVAL_TOP;                                \
+      penv->frame = stack[saved_stack_index + 1];   \
+      penv->closure_depth = closure_depth;          \
+      return expr;                                  \
     }                                               \
+    penv = (env);                                   \
+    goto EVAL_TOP;                                  \
   } while (0)
+LispObject LispCallCFunction(LispObject fun, LispIndex nargs);
+LispObject LispFuncall(LispIndex nargs);
 LispObject LispApply(LispObject fun, LispObject arg_list);
 LispObject EvalSexpr(LispObject expr, LispEnvPtr penv);
 LispObject TopLevelEval(LispObject expr);
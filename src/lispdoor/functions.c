@@ -59,12 +59,14 @@
  *    License as published by the Free Software Foundation; either
  *    version 2 of the License, or (at your option) any later version.
  */
+#include "lispdoor/functions.h"
 
 #include "hal/qassert.h"
 #include "lispdoor/eval.h"
 #include "lispdoor/gc.h"
 #include "lispdoor/memorylayout.h"
 #include "lispdoor/objects.h"
+#include "lispdoor/optimize.h"
 #include "lispdoor/print.h"
 #include "lispdoor/read.h"
 #include "lispdoor/symboltree.h"
@@ -72,6 +74,24 @@
 
 Q_DEFINE_THIS_MODULE("functions")
 
+/* build a closure (head args body . frame) from v = (args body), the body is
+   optimised with bound shadowing globals when optimize_p */
+static LispObject MakeClosure(char *head, LispObject v, bool optimize_p,
+                              LispObject bound) {
+  LispIndex saved_stack_index = stack_index;
+  PUSH(v);
+  PUSH(LISP_CONS_CAR_SAFE(LISP_CONS_CDR_SAFE(v)));
+  if (optimize_p) {
+    stack[saved_stack_index + 1] = LispOptimizeBody(
+        LISP_CONS_CAR(v), stack[saved_stack_index + 1], bound);
+  }
+  v = cons(stack[saved_stack_index + 1], LispEnv()->frame);
+  v = cons(LISP_CONS_CAR(stack[saved_stack_index]), v);
+  v = cons(LispMakeSymbol(head), v);
+  stack_index = saved_stack_index;
+  return v;
+}
+
 /* Builtin functions */
 LispObject LdLabel(LispNArg narg) {
   LispObject v, name, body;
@@ -83,7 +103,15 @@ LispObject LdLabel(LispNArg narg) {
   name = LISP_CONS_CAR_SAFE(v); /* name */
   PUSH(name);
   body = LISP_CONS_CAR_SAFE(LISP_CONS_CDR(v)); /* lambda expr */
-  body = EVAL(body, LispEnv());                /* evaluate lambda */
+  if (LispOptimizeP() && LISP_ConsP(body) &&
+      LISP_CONS_CAR(body) == LispMakeSymbol("lambda")) {
+    /* optimise with name shadowing its global value */
+    PUSH(body);
+    v = cons(stack[saved_stack_index], LISP_NIL);
+    body = MakeClosure("lambda", LISP_CONS_CDR(POP()), true, v);
+  } else {
+    body = EVAL(body, LispEnv()); /* evaluate lambda */
+  }
   PUSH(body);
   name = stack[saved_stack_index];
   /* (lambda args body . frame) */
@@ -98,26 +126,34 @@ LispObject LdLabel(LispNArg narg) {
   return body;
 }
 LispObject LdLambda(LispNArg narg) {
-  LispObject v, arg_syms, body, ans;
   ArgCount("lambda", narg, 1);
   /* build a closure (lambda args body . frame) */
-  v = POP();
-  arg_syms = LISP_CONS_CAR_SAFE(v);
-  body = LISP_CONS_CAR_SAFE(LISP_CONS_CDR(v));
-  ans = cons_(LispMakeSymbol("lambda"),
-              cons(arg_syms, cons(body, LispEnv()->frame)));
-  return ans;
+  return MakeClosure("lambda", POP(), LispOptimizeP(), LISP_NIL);
 }
 LispObject LdMacro(LispNArg narg) {
-  LispObject v, arg_syms, body, ans;
   ArgCount("macro", narg, 1);
-  /* build a closure (lambda args body . frame) */
-  v = POP();
-  arg_syms = LISP_CONS_CAR_SAFE(v);
-  body = LISP_CONS_CAR_SAFE(LISP_CONS_CDR(v));
-  ans = cons_(LispMakeSymbol("macro"),
-              cons(arg_syms, cons(body, LispEnv()->frame)));
-  return ans;
+  /* build a closure (macro args body . frame) */
+  return MakeClosure("macro", POP(), false, LISP_NIL);
+}
+LispObject LdDefineInline(LispNArg narg) {
+  /* (define-inline name (args ...) body) is (set (quote name) (lambda ...))
+     with calls to name open coded by the optimiser */
+  LispObject v, name;
+  ArgCount("define-inline", narg, 1);
+  v = stack[stack_index - 1];
+  name = LISP_CONS_CAR_SAFE(v);
+  ToSymbol(name, "define-inline");
+  if (LISP_SYMBOL_CONSTANTP(name)) {
+    LispErrorBegin();
+    LispPrintStr("define-inline: error: constant ");
+    LispPrintStr(LispSymbolName(name));
+    LispError(" cannot be set\n");
+  }
+  v = MakeClosure("lambda", LISP_CONS_CDR(v), LispOptimizeP(), LISP_NIL);
+  name = LISP_CONS_CAR(POP());
+  name->symbol.stype = kSymInline;
+  name->symbol.value = v;
+  return v;
 }
 LispObject LdQuote(LispNArg narg) {
   (void)narg;
@@ -182,6 +218,179 @@ LispObject LdCond(LispNArg narg) {
   }
   return ans;
 }
+/* case dispatch table: #(key0 body0 key1 body1 ... default-body) sorted by
+   CaseKeyLower. keys are ordered by tag, then by address or value; the gc
+   slides objects down without reordering them, so the table stays sorted */
+static bool CaseKeyLower(LispObject a, LispObject b) {
+  if (LISP_IMMEDIATE(a) != LISP_IMMEDIATE(b)) {
+    return LISP_IMMEDIATE(a) < LISP_IMMEDIATE(b);
+  }
+  return (uintptr_t)a < (uintptr_t)b;
+}
+/* index of the first of the n keys of table not lower than key */
+static LispIndex CaseSearch(LispObject table, LispIndex n, LispObject key) {
+  LispIndex lo = 0, hi = n, mid;
+  while (lo < hi) {
+    mid = (LispIndex)((lo + hi) >> 1);
+    if (CaseKeyLower(table->vector.self[2 * mid], key)) {
+      lo = (LispIndex)(mid + 1);
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+static bool CaseDefaultP(LispObject keys) {
+  return keys == LISP_T ||
+         (LISP_SymbolP(keys) && (strcmp(LispSymbolName(keys), "t") == 0 ||
+                                 strcmp(LispSymbolName(keys), "otherwise") == 0));
+}
+/* add the keys of clauses to table, the first clause of a repeated key wins */
+static void CaseAddKeys(LispObject table, LispObject clauses) {
+  LispIndex n = 0, i;
+  LispObject keys, key, fallback = LISP_UNBOUND;
+  for (; LISP_ConsP(clauses); clauses = LISP_CONS_CDR(clauses)) {
+    keys = LISP_CONS_CAR(LISP_CONS_CAR(clauses));
+    if (CaseDefaultP(keys)) {
+      if (LISP_UNBOUNDP(fallback)) {
+        fallback = LISP_CONS_CDR(LISP_CONS_CAR(clauses));
+      }
+      continue;
+    }
+    /* (keys ...) or a single key */
+    while (!LISP_NULL(keys)) {
+      key = LISP_ConsP(keys) ? LISP_CONS_CAR(keys) : keys;
+      keys = LISP_ConsP(keys) ? LISP_CONS_CDR(keys) : LISP_NIL;
+      i = CaseSearch(table, n, key);
+      if (i < n && table->vector.self[2 * i] == key) {
+        continue;
+      }
+      memmove(&table->vector.self[2 * i + 2], &table->vector.self[2 * i],
+              sizeof(LispObject) * 2 * (n - i));
+      table->vector.self[2 * i] = key;
+      table->vector.self[2 * i + 1] = LISP_CONS_CDR(LISP_CONS_CAR(clauses));
+      ++n;
+    }
+  }
+  table->vector.self[2 * n] = LISP_UNBOUNDP(fallback) ? LISP_NIL : fallback;
+  table->vector.fillp = (LispIndex)(2 * n + 1);
+}
+/* table for clauses, nil when a key does not fit one or there are too few
+   keys for a search to beat the scan */
+static LispObject CaseTable(LispObject clauses) {
+  LispIndex n = 0;
+  LispObject c, keys, key;
+  for (c = clauses; LISP_ConsP(c); c = LISP_CONS_CDR(c)) {
+    if (!LISP_ConsP(LISP_CONS_CAR(c))) {
+      return LISP_NIL;
+    }
+    keys = LISP_CONS_CAR(LISP_CONS_CAR(c));
+    if (CaseDefaultP(keys)) {
+      continue;
+    }
+    while (!LISP_NULL(keys)) {
+      key = LISP_ConsP(keys) ? LISP_CONS_CAR(keys) : keys;
+      keys = LISP_ConsP(keys) ? LISP_CONS_CDR(keys) : LISP_NIL;
+      if (!(LISP_SymbolP(key) || LISP_FixNumP(key) ||
+            LISP_CharacterP(key))) {
+        return LISP_NIL;
+      }
+      ++n;
+    }
+  }
+  if (n < 4) {
+    return LISP_NIL;
+  }
+  PUSH(clauses);
+  c = LispMakeVector((LispIndex)(2 * n + 1));
+  CaseAddKeys(c, POP());
+  return c;
+}
+/* table of the case form whose (key clauses ...) cell is form, built the
+   first time it runs; nil to scan the clauses, also when case_tables is
+   full */
+static LispObject CaseTableOf(LispObject form) {
+  LispIndex i, free = 2 * N_CASE_TABLES;
+  LispObject table;
+  for (i = 0; i < 2 * N_CASE_TABLES; i += 2) {
+    if (case_tables[i] == form) {
+      return case_tables[i + 1];
+    }
+    if (LISP_UNBOUNDP(case_tables[i]) && free == 2 * N_CASE_TABLES) {
+      free = i;
+    }
+  }
+  if (free == 2 * N_CASE_TABLES) {
+    return LISP_NIL;
+  }
+  PUSH(form);
+  table = CaseTable(LISP_CONS_CDR(form));
+  form = POP();
+  if (!LISP_NULL(table)) {
+    case_tables[free] = form;
+    case_tables[free + 1] = table;
+  }
+  return table;
+}
+/* body of the first clause holding key, else of the first default clause */
+static LispObject CaseFind(LispObject clauses, LispObject key) {
+  LispObject keys, fallback = LISP_NIL;
+  bool fallback_p = false;
+  for (; LISP_ConsP(clauses); clauses = LISP_CONS_CDR(clauses)) {
+    keys = ToCons(LISP_CONS_CAR(clauses), "case")->car;
+    if (CaseDefaultP(keys)) {
+      if (!fallback_p) {
+        fallback = LISP_CONS_CDR(LISP_CONS_CAR(clauses));
+        fallback_p = true;
+      }
+      continue;
+    }
+    while (!LISP_NULL(keys)) {
+      if ((LISP_ConsP(keys) ? LISP_CONS_CAR(keys) : keys) == key) {
+        return LISP_CONS_CDR(LISP_CONS_CAR(clauses));
+      }
+      keys = LISP_ConsP(keys) ? LISP_CONS_CDR(keys) : LISP_NIL;
+    }
+  }
+  return fallback;
+}
+LispObject LdCase(LispNArg narg) {
+  /* (case key */
+  /*    ((key1 key2 ...) action1) */
+  /*    (key3 action2) */
+  /*    ... */
+  /*    (t actionn)) */
+  /* dispatches by a table kept in case_tables, the form is left as read */
+  (void)narg;
+  LispObject ans = LISP_NIL, *pv, *frame, table;
+  LispIndex n, i;
+  PUSH(LispEnv()->frame);
+  frame = &stack[stack_index - 1];
+  pv = &stack[stack_index - 2];
+  ToCons(*pv, "case");
+  ans = EVAL(LISP_CONS_CAR(*pv), LispEnv());
+  LispEnv()->frame = *frame;
+  table = CaseTableOf(*pv);
+  if (!LISP_NULL(table)) {
+    n = (LispIndex)(table->vector.fillp >> 1);
+    i = CaseSearch(table, n, ans);
+    if (i < n && table->vector.self[2 * i] == ans) {
+      *pv = table->vector.self[2 * i + 1];
+    } else {
+      *pv = table->vector.self[2 * n];
+    }
+  } else {
+    *pv = CaseFind(LISP_CONS_CDR(*pv), ans);
+  }
+  /* evaluate body forms */
+  ans = LISP_NIL;
+  while (LISP_ConsP(*pv)) {
+    ans = EVAL(LISP_CONS_CAR(*pv), LispEnv());
+    LispEnv()->frame = *frame;
+    *pv = LISP_CONS_CDR(*pv);
+  }
+  return ans;
+}
 LispObject LdAnd(LispNArg narg) {
   (void)narg;
   LispObject ans = LISP_T, *pv, *frame;
@@ -263,19 +472,11 @@ LispObject LdProgn(LispNArg narg) {
   return ans;
 }
 /* normal functions  */
-LispObject LdEq(LispNArg narg) {
-  /* (if (test-clause) (action1) (action2)) */
-  ArgCount("eq", narg, 2);
-  /* POPN(2); */
-  return LISP_MAKE_BOOL(stack[stack_index - 1] == stack[stack_index - 2]);
-}
+LispObject LdEq(LispObject a, LispObject b) { return LISP_MAKE_BOOL(a == b); }
 
-LispObject LdSet(LispNArg narg) {
-  LispObject ans, v, e, bind;
-  ArgCount("set", narg, 2);
+LispObject LdSet(LispObject e, LispObject ans) {
+  LispObject v, bind;
   bool done = false;
-  ans = POP();
-  e = POP();
   v = LispEnv()->frame;
   while (LISP_ConsP(v)) {
     bind = LISP_CONS_CAR(v);
@@ -286,64 +487,44 @@ LispObject LdSet(LispNArg narg) {
     v = LISP_CONS_CDR(v);
   }
   if (!done) {
-    ToSymbol(e, "set")->value = ans;
+    ToSymbol(e, "set");
+    if (LISP_SYMBOL_CONSTANTP(e)) {
+      /* constants may have been inlined by the optimiser */
+      LispErrorBegin();
+      LispPrintStr("set: error: constant ");
+      LispPrintStr(LispSymbolName(e));
+      LispError(" cannot be set\n");
+    }
+    /* a plain set drops the inline declaration */
+    e->symbol.stype = kSymOrdinary;
+    e->symbol.value = ans;
   }
 
   return ans;
 }
-LispObject LdBoundp(LispNArg narg) {
-  /* (if (test-clause) (action1) (action2)) */
-  ArgCount("boundp", narg, 1);
-  LispObject v = ToSymbol(stack[stack_index - 1], "boundp")->value;
+LispObject LdBoundp(LispObject sym) {
+  LispObject v = ToSymbol(sym, "boundp")->value;
   return LISP_MAKE_BOOL(!LISP_UNBOUNDP(v));
 }
-LispObject LdCons(LispNArg narg) {
-  ArgCount("cons", narg, 2);
-  LispObject c = MakeCons();
-  LISP_CONS_CAR(c) = stack[stack_index - 2];
-  LISP_CONS_CDR(c) = stack[stack_index - 1];
-  return c;
-}
-LispObject LdCar(LispNArg narg) {
-  ArgCount("car", narg, 1);
-  return LISP_CONS_CAR_SAFE(stack[stack_index - 1]);
-}
-
-LispObject LdCdr(LispNArg narg) {
-  ArgCount("cdr", narg, 1);
-  return LISP_CONS_CDR_SAFE(stack[stack_index - 1]);
+LispObject LdCons(LispObject a, LispObject b) {
+  /* cons roots a and b */
+  return cons(a, b);
 }
-
-LispObject LdRPlacA(LispNArg narg) {
-  ArgCount("rplaca", narg, 2);
-  LISP_CONS_CAR_SAFE(stack[stack_index - 2]) = stack[stack_index - 1];
-  return stack[stack_index - 2];
-}
-LispObject LdRPlacD(LispNArg narg) {
-  ArgCount("rplacd", narg, 2);
-  LISP_CONS_CDR_SAFE(stack[stack_index - 2]) = stack[stack_index - 1];
-  return stack[stack_index - 2];
-}
-LispObject LdAtom(LispNArg narg) {
-  ArgCount("atom", narg, 1);
-  return LISP_MAKE_BOOL(LISP_ATOM(stack[stack_index - 1]));
-}
-LispObject LdConsP(LispNArg narg) {
-  ArgCount("consp", narg, 1);
-  return LISP_MAKE_BOOL(LISP_ConsP(stack[stack_index - 1]));
-}
-LispObject LdSymbolP(LispNArg narg) {
-  ArgCount("symbolp", narg, 1);
-  return LISP_MAKE_BOOL(LISP_SymbolP(stack[stack_index - 1]));
-}
-LispObject LdNumberP(LispNArg narg) {
-  ArgCount("numberp", narg, 1);
-  return LISP_MAKE_BOOL(LISP_NumberP(stack[stack_index - 1]));
+LispObject LdCar(LispObject x) { return LISP_CONS_CAR_SAFE(x); }
+LispObject LdCdr(LispObject x) { return LISP_CONS_CDR_SAFE(x); }
+LispObject LdRPlacA(LispObject c, LispObject x) {
+  LISP_CONS_CAR_SAFE(c) = x;
+  return c;
 }
-LispObject LdFixNumP(LispNArg narg) {
-  ArgCount("fixnump", narg, 1);
-  return LISP_MAKE_BOOL(LISP_FixNumP(stack[stack_index - 1]));
+LispObject LdRPlacD(LispObject c, LispObject x) {
+  LISP_CONS_CDR_SAFE(c) = x;
+  return c;
 }
+LispObject LdAtom(LispObject x) { return LISP_MAKE_BOOL(LISP_ATOM(x)); }
+LispObject LdConsP(LispObject x) { return LISP_MAKE_BOOL(LISP_ConsP(x)); }
+LispObject LdSymbolP(LispObject x) { return LISP_MAKE_BOOL(LISP_SymbolP(x)); }
+LispObject LdNumberP(LispObject x) { return LISP_MAKE_BOOL(LISP_NumberP(x)); }
+LispObject LdFixNumP(LispObject x) { return LISP_MAKE_BOOL(LISP_FixNumP(x)); }
 LispObject LdAdd(LispNArg narg) {
   LispFixNum ans = 0;
   LispIndex i = stack_index - narg;
@@ -353,9 +534,6 @@ LispObject LdAdd(LispNArg narg) {
   return LISP_MAKE_FIXNUM(ans);
 }
 LispObject LdSub(LispNArg narg) {
-  if (narg < 1) {
-    LispError("-: error: too few arguments\n");
-  }
   LispIndex i = stack_index - narg;
   LispFixNum ans = (narg == 1) ? 0 : ToFixNum(stack[i++], "-");
   for (; i < stack_index; ++i) {
@@ -372,9 +550,6 @@ LispObject LdMul(LispNArg narg) {
   return LISP_MAKE_FIXNUM(ans);
 }
 LispObject LdDiv(LispNArg narg) {
-  if (narg < 1) {
-    LispError("-: error: too few arguments\n");
-  }
   LispIndex i = stack_index - narg;
   LispFixNum ans = (narg == 1) ? 1 : ToFixNum(stack[i++], "/");
   LispFixNum tmp;
@@ -387,15 +562,12 @@ LispObject LdDiv(LispNArg narg) {
   }
   return LISP_MAKE_FIXNUM(ans);
 }
-LispObject LdLt(LispNArg narg) {
-  ArgCount("<", narg, 2);
+LispObject LdLt(LispObject o1, LispObject o2) {
   // this implements generic comparison for all atoms
   // strange comparisons (for example with builtins) are resolved
   // arbitrarily but consistently.
   // ordering: cons < builtin < number < symbol
-  LispObject o1, o2, ans = LISP_NIL;
-  o1 = stack[stack_index - 2];
-  o2 = stack[stack_index - 1];
+  LispObject ans = LISP_NIL;
   if (LISP_TYPE_OF(o1) != LISP_TYPE_OF(o2)) {
     ans = ((LISP_TYPE_OF(o1) < LISP_TYPE_OF(o2)) ? LISP_T : LISP_NIL);
   } else {
@@ -405,8 +577,9 @@ LispObject LdLt(LispNArg narg) {
         break;
       }
       case kCharacter:
+      case kQ15:
       case kFixNum: {
-        ans = LISP_MAKE_BOOL(o1 < o2);
+        ans = LISP_MAKE_BOOL(LISP_FIXNUM_LOWER(o1, o2));
         break;
       }
       case kSingleFloat: {
@@ -421,6 +594,10 @@ LispObject LdLt(LispNArg narg) {
         ans = LISP_MAKE_BOOL(o1->long_float.value < o2->long_float.value);
         break;
       }
+      case kQ31: {
+        ans = LISP_MAKE_BOOL(LISP_Q31(o1) < LISP_Q31(o2));
+        break;
+      }
       case kSymbol: {
         ans = LISP_MAKE_BOOL(strcmp(o1->symbol.name, o2->symbol.name));
         break;
@@ -454,38 +631,81 @@ LispObject LdLt(LispNArg narg) {
   return ans;
 }
 
-LispObject LdNot(LispNArg narg) {
-  ArgCount("fixnump", narg, 1);
-  return LISP_MAKE_BOOL(stack[stack_index - 1] == LISP_NIL);
-}
-LispObject LdEval(LispNArg narg) {
-  ArgCount("eval", narg, 1);
-  return EVAL(stack[stack_index - 1], LispEnv());
-}
+LispObject LdNot(LispObject x) { return LISP_MAKE_BOOL(x == LISP_NIL); }
+LispObject LdEval(LispObject x) { return EVAL(x, LispEnv()); }
 LispObject LdPrint(LispNArg narg) {
-  ArgCount("print", narg, 1);
   LispIndex i = stack_index - narg;
   for (; i < stack_index; ++i) {
     LispPrintObject(stack[i], false);
   }
   LispPrintStr("\n");
+  LispPortFlush(print_port);
   return stack[stack_index - 1];
 }
 LispObject LdPrinc(LispNArg narg) {
-  ArgCount("princ", narg, 1);
   LispIndex i = stack_index - narg;
   for (; i < stack_index; ++i) {
     LispPrintObject(stack[i], true);
   }
   LispPrintStr("\n");
+  LispPortFlush(print_port);
   return stack[stack_index - 1];
 }
+LispObject LdWithOutputToString(LispNArg narg) {
+  /* (with-output-to-string body ...) returns what body printed */
+  LispPort port, *prev = print_port;
+  LispIndex body = stack_index - 1;
+  PUSH(LISP_NIL);
+  LispPortInitString(&port, stack_index - 1);
+  PUSH(stack[body]);
+  print_port = &port;
+  LdProgn(narg);
+  print_port = prev;
+  return LispPortString(&port);
+}
+LispObject LdPrin1ToString(LispObject x) {
+  LispPort port, *prev = print_port;
+  PUSH(LISP_NIL);
+  LispPortInitString(&port, stack_index - 1);
+  print_port = &port;
+  LispPrintObject(x, false);
+  print_port = prev;
+  return LispPortString(&port);
+}
+/* (read) takes the next form of the stream being read: the terminal, or the
+ * rest of the source while loading; nil at its end */
 LispObject LdRead(LispNArg narg) {
-  ArgCount("read", narg, 0);
-  return ReadSexpr();
+  LispObject v;
+  (void)narg;
+  v = ReadSexpr(read_stream);
+  return (v == LISP_UNBOUND) ? LISP_NIL : v;
+}
+/* (read-from-string str [start]) */
+LispObject LdReadFromString(LispNArg narg) {
+  LispStream s;
+  LispObject v;
+  LispIndex slot = stack_index - narg;
+  uint32_t start = 0;
+  ToString(stack[slot], "read-from-string");
+  if (narg == 2) {
+    start = (uint32_t)ToFixNum(stack[slot + 1], "read-from-string");
+  }
+  LispStreamInitString(&s, slot, start);
+  v = ReadSexpr(&s);
+  return (v == LISP_UNBOUND) ? LISP_NIL : v;
+}
+/* (load-from-memory address length) evaluates the source text stored there,
+ * e.g. a blob linked into flash, without going through the terminal buffer */
+LispObject LdLoadFromMemory(LispObject address, LispObject length) {
+  LispStream s;
+  LispStreamInitMemory(
+      &s, (const uint8_t *)(uintptr_t)ToFixNum(address, "load-from-memory"),
+      (uint32_t)ToFixNum(length, "load-from-memory"));
+  return LispLoad(&s);
 }
 LispObject LdError(LispNArg narg) {
   LispIndex i = stack_index - narg;
+  LispErrorBegin();
   for (; i < stack_index; ++i) {
     LispPrintObject(stack[i], true);
   }
@@ -493,15 +713,10 @@ LispObject LdError(LispNArg narg) {
   return LISP_NIL;
 }
 LispObject LdProg1(LispNArg narg) {
-  if (narg < 1) {
-    LispError("prog1: error: too few arguments\n");
-  }
   return stack[stack_index - narg];
 }
-LispObject LdAssoc(LispNArg narg) {
-  ArgCount("assoc", narg, 2);
-  LispObject bind, v = stack[stack_index - 2], item = stack[stack_index - 1];
-  LispObject ans = LISP_NIL;
+LispObject LdAssoc(LispObject v, LispObject item) {
+  LispObject bind, ans = LISP_NIL;
   while (LISP_ConsP(v)) {
     bind = LISP_CONS_CAR(v);
     if (LISP_ConsP(bind) && LISP_CONS_CAR(bind) == item) {
@@ -512,25 +727,1052 @@ LispObject LdAssoc(LispNArg narg) {
   }
   return ans;
 }
-LispObject LdApply(LispNArg narg) {
-  ArgCount("apply", narg, 2);
-  LispObject v = stack[stack_index - 1], f = stack[stack_index - 2];
+LispObject LdApply(LispObject f, LispObject v) {
   if (LISP_CFunctionP(f) && LISP_CFUNCTION_SPECIALP(f)) {
+    LispErrorBegin();
     LispPrintStr("apply: error: cannot apply special operator ");
     LispPrintStr(f->cfun.name);
     LispError("\n");
   }
   return LispApply(f, v);
 }
+/* strings */
+static LispIndex StringIndex(LispObject i, LispIndex limit, char *fname) {
+  LispFixNum n = ToFixNum(i, fname);
+  if (n < 0 || n > limit) {
+    LispErrorBegin();
+    LispPrintStr(fname);
+    LispError(": error: index out of range\n");
+  }
+  return (LispIndex)n;
+}
+LispObject LdStringLength(LispObject s) {
+  return LISP_MAKE_FIXNUM(ToString(s, "string-length")->size);
+}
+LispObject LdChar(LispObject s, LispObject i) {
+  struct LispString *str = ToString(s, "char");
+  LispIndex k = StringIndex(i, str->size, "char");
+  if (k == str->size) {
+    LispError("char: error: index out of range\n");
+  }
+  return LISP_MAKE_CHARACTER((uint8_t)str->self[k]);
+}
+/* (substring s start [end]) */
+LispObject LdSubString(LispNArg narg) {
+  LispIndex slot = stack_index - narg, start, end;
+  LispObject r;
+  end = ToString(stack[slot], "substring")->size;
+  start = StringIndex(stack[slot + 1], end, "substring");
+  if (narg == 3) {
+    end = StringIndex(stack[slot + 2], end, "substring");
+  }
+  if (end < start) {
+    LispError("substring: error: end before start\n");
+  }
+  r = LispAllocString((LispIndex)(end - start));
+  memcpy(r->string.self, stack[slot]->string.self + start, end - start);
+  return r;
+}
+LispObject LdStringEqual(LispObject a, LispObject b) {
+  LispIndex n = ToString(a, "string=")->size;
+  return LISP_MAKE_BOOL(
+      ToString(b, "string=")->size == n &&
+      StrMismatch(a->string.self, b->string.self, n) == n);
+}
+/* the index where a first differs from b when a sorts first, else nil */
+LispObject LdStringLess(LispObject a, LispObject b) {
+  LispIndex na = ToString(a, "string<")->size;
+  LispIndex nb = ToString(b, "string<")->size;
+  LispIndex i =
+      StrMismatch(a->string.self, b->string.self, (na < nb) ? na : nb);
+  if ((i < na && i < nb) ? (uint8_t)a->string.self[i] <
+                               (uint8_t)b->string.self[i]
+                         : na < nb) {
+    return LISP_MAKE_FIXNUM(i);
+  }
+  return LISP_NIL;
+}
+/* (string-search pattern s [start]) the index of pattern in s, or nil */
+LispObject LdStringSearch(LispNArg narg) {
+  LispIndex slot = stack_index - narg, start = 0, i;
+  struct LispString *p = ToString(stack[slot], "string-search");
+  struct LispString *s = ToString(stack[slot + 1], "string-search");
+  if (narg == 3) {
+    start = StringIndex(stack[slot + 2], s->size, "string-search");
+  }
+  i = StrSearch(s->self + start, (LispIndex)(s->size - start), p->self,
+                p->size);
+  return (i == NOTFOUND) ? LISP_NIL : LISP_MAKE_FIXNUM(start + i);
+}
+LispObject LdStringAppend(LispNArg narg) {
+  LispIndex i = stack_index - narg, n;
+  uint32_t size = 0;
+  LispObject r;
+  for (; i < stack_index; ++i) {
+    size += ToString(stack[i], "string-append")->size;
+  }
+  if (size > (LispIndex)-1) {
+    LispError("string-append: error: string too long\n");
+  }
+  r = LispAllocString((LispIndex)size);
+  size = 0;
+  for (i = stack_index - narg; i < stack_index; ++i) {
+    n = stack[i]->string.size;
+    memcpy(r->string.self + size, stack[i]->string.self, n);
+    size += n;
+  }
+  return r;
+}
+LispObject LdStringToList(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispIndex i = ToString(stack[slot], "string->list")->size;
+  PUSH(LISP_NIL);
+  while (i > 0) {
+    --i;
+    stack[slot + 1] = cons(
+        LISP_MAKE_CHARACTER((uint8_t)stack[slot]->string.self[i]),
+        stack[slot + 1]);
+  }
+  return POP();
+}
+/* (number->string n [base]) */
+LispObject LdNumberToString(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispObject n = stack[slot];
+  LispFixNum base = 10;
+  char *str;
+  if (narg == 2) {
+    base = ToFixNum(stack[slot + 1], "number->string");
+    if (base < 2 || base > 36) {
+      LispError("number->string: error: base must be 2 to 36\n");
+    }
+  }
+  switch (LISP_TYPE_OF(n)) {
+    case kFixNum:
+      str = Int2Str((char *)scratch_pad, SCRATCH_PAD_SIZE, LISP_FIXNUM(n),
+                    (Byte)base);
+      break;
+    case kSingleFloat:
+      str = Float2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                      LISP_SINGLE_FLOAT(n));
+      break;
+    case kDoubleFloat:
+      str = Double2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                       LISP_DOUBLE_FLOAT(n));
+      break;
+    default:
+      LispTypeError("number->string", "Number", n);
+      return LISP_NIL;
+  }
+  return LispMakeString(str);
+}
+/* numbers, shared by the builtin groups below */
+/* a fixnum when it fits, else a double, which holds any 32 bit integer */
+static inline LispObject MakeInteger(int64_t x) {
+  if (x >= LISP_FIXNUM_MIN && x <= LISP_FIXNUM_MAX) {
+    return LISP_MAKE_FIXNUM(x);
+  }
+  return LispMakeDoubleFloat((double)x);
+}
+static inline int32_t Int32Arg(LispObject x, char *fname) {
+  LispFixNum n = ToFixNum(x, fname);
+  return (n < INT32_MIN)   ? INT32_MIN
+         : (n > INT32_MAX) ? INT32_MAX
+                           : (int32_t)n;
+}
+static inline float FloatArg(LispObject x, char *fname) {
+  if (LISP_SingleFloatP(x)) {
+    return LISP_SINGLE_FLOAT(x);
+  }
+  if (LISP_DoubleFloatP(x)) {
+    return (float)LISP_DOUBLE_FLOAT(x);
+  }
+  return (float)ToFixNum(x, fname);
+}
+#if LISP_WITH_TYPED_ARRAYS
+/* typed arrays */
+static uint8_t ElementType(LispObject type, char *fname) {
+  uint8_t t;
+  char *name = LispSymbolName((LispObject)ToSymbol(type, fname));
+  for (t = 0; t < LISP_ELEMENT_TYPES; ++t) {
+    if (strcmp(name, lisp_element_names[t]) == 0) {
+      return t;
+    }
+  }
+  LispErrorBegin();
+  LispPrintStr(fname);
+  LispError(": error: element type is one of u8 i16 u16 i32 f32\n");
+  return 0;
+}
+static LispObject ArrayElement(LispObject a, LispIndex i) {
+  if (a->typed_array.etype == kElemF32) {
+    return LispMakeSingleFloat(a->typed_array.self.f32[i]);
+  }
+  return MakeInteger(ArrayGetInt(a, i));
+}
+/* [start, end) of a typed array from the optional arguments at slot */
+static void ArrayRange(LispObject a, LispIndex slot, LispIndex n,
+                       LispIndex *start, LispIndex *end, char *fname) {
+  *start = 0;
+  *end = a->typed_array.size;
+  if (n > 0) {
+    *start = StringIndex(stack[slot], *end, fname);
+  }
+  if (n > 1) {
+    *end = StringIndex(stack[slot + 1], *end, fname);
+  }
+  if (*end < *start) {
+    LispErrorBegin();
+    LispPrintStr(fname);
+    LispError(": error: end before start\n");
+  }
+}
+static void ArrayFillWith(LispObject a, LispIndex start, LispIndex end,
+                          LispObject x, char *fname) {
+  if (LISP_FixNumP(x)) {
+    ArrayFill(a, start, end, Int32Arg(x, fname));
+  } else {
+    ArrayFillFloat(a, start, end, FloatArg(x, fname));
+  }
+}
+/* (make-array n type [init]), type one of u8 i16 u16 i32 f32 */
+LispObject LdMakeArray(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispFixNum n = ToFixNum(stack[slot], "make-array");
+  LispObject a;
+  if (n < 0 || n > (LispIndex)-1) {
+    LispError("make-array: error: bad size\n");
+  }
+  a = LispMakeTypedArray(ElementType(stack[slot + 1], "make-array"),
+                         (LispIndex)n);
+  if (narg == 3) {
+    ArrayFillWith(a, 0, (LispIndex)n, stack[slot + 2], "make-array");
+  }
+  return a;
+}
+/* (array-fill a x [start [end]]) */
+LispObject LdArrayFill(LispNArg narg) {
+  LispIndex slot = stack_index - narg, start, end;
+  LispObject a = stack[slot];
+  ToTypedArray(a, "array-fill");
+  ArrayRange(a, slot + 2, narg - 2, &start, &end, "array-fill");
+  ArrayFillWith(a, start, end, stack[slot + 1], "array-fill");
+  return a;
+}
+/* (array-copy dst src [at [start [end]]]) src [start, end) into dst from at,
+ * converting the elements when the types differ */
+LispObject LdArrayCopy(LispNArg narg) {
+  LispIndex slot = stack_index - narg, at = 0, start, end;
+  LispObject dst = stack[slot], src = stack[slot + 1];
+  ToTypedArray(dst, "array-copy");
+  ToTypedArray(src, "array-copy");
+  if (narg > 2) {
+    at = StringIndex(stack[slot + 2], dst->typed_array.size, "array-copy");
+  }
+  ArrayRange(src, slot + 3, narg > 3 ? narg - 3 : 0, &start, &end,
+             "array-copy");
+  if (end - start > dst->typed_array.size - at) {
+    LispError("array-copy: error: destination too small\n");
+  }
+  ArrayCopy(dst, at, src, start, end);
+  return dst;
+}
+LispObject LdArraySum(LispObject a) {
+  if (ToTypedArray(a, "array-sum")->etype == kElemF32) {
+    return LispMakeSingleFloat(ArraySumFloat(a));
+  }
+  return MakeInteger(ArraySumInt(a));
+}
+static LispObject ArrayExtremumElement(LispObject a, bool max, char *fname) {
+  LispIndex i = ArrayExtremum((LispObject)ToTypedArray(a, fname), max);
+  return (i == NOTFOUND) ? LISP_NIL : ArrayElement(a, i);
+}
+LispObject LdArrayMin(LispObject a) {
+  return ArrayExtremumElement(a, false, "array-min");
+}
+LispObject LdArrayMax(LispObject a) {
+  return ArrayExtremumElement(a, true, "array-max");
+}
+/* (array-scale a k [shift]) multiplies each element by k / 2^shift */
+LispObject LdArrayScale(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispObject a = stack[slot];
+  LispFixNum shift = 0;
+  ToTypedArray(a, "array-scale");
+  if (narg == 3) {
+    shift = ToFixNum(stack[slot + 2], "array-scale");
+    if (shift < 0 || shift > 31) {
+      LispError("array-scale: error: shift must be 0 to 31\n");
+    }
+  }
+  ArrayScale(a, Int32Arg(stack[slot + 1], "array-scale"), (uint8_t)shift);
+  return a;
+}
+#endif /* LISP_WITH_TYPED_ARRAYS */
+#if LISP_WITH_FIXED_POINT
+/* fixed point */
+/* the raw value of a Q15 or Q31 argument, *n set to its fraction bits */
+static int32_t QArg(LispObject x, uint8_t *n, char *fname) {
+  if (LISP_Q15P(x)) {
+    *n = 15;
+    return LISP_Q15(x);
+  }
+  if (!LISP_Q31P(x)) {
+    LispTypeError(fname, "Fixed", x);
+  }
+  *n = 31;
+  return LISP_Q31(x);
+}
+static LispObject MakeQ(int32_t x, uint8_t n) {
+  return (n == 15) ? LISP_MAKE_Q15(x) : LispMakeQ31(x);
+}
+/* the raw values of two arguments of one format */
+static uint8_t QArgs(LispObject a, LispObject b, int32_t *x, int32_t *y,
+                     char *fname) {
+  uint8_t n, m;
+  *x = QArg(a, &n, fname);
+  *y = QArg(b, &m, fname);
+  if (n != m) {
+    LispErrorBegin();
+    LispPrintStr(fname);
+    LispError(": error: Q15 and Q31 mixed\n");
+  }
+  return n;
+}
+/* (q15 x) and (q31 x): x a float, the other format, or a fixnum taken as
+ * the raw value, the way samples come from an ADC */
+static LispObject ToQ(LispObject x, uint8_t n, char *fname) {
+  uint8_t m;
+  int32_t q;
+  if (LISP_FixNumP(x)) {
+    return MakeQ(QSaturate(LISP_FIXNUM(x), n), n);
+  }
+  if (LISP_Q15P(x) || LISP_Q31P(x)) {
+    q = QArg(x, &m, fname);
+    /* Q31 to Q15 rounds to nearest */
+    return MakeQ((m < n) ? (int32_t)((uint32_t)q << (n - m))
+                         : QSaturate(((int64_t)q + (1 << (m - n - 1))) >>
+                                         (m - n),
+                                     n),
+                 n);
+  }
+  if (LISP_DoubleFloatP(x)) {
+    return MakeQ(QFromDouble(LISP_DOUBLE_FLOAT(x), n), n);
+  }
+  return MakeQ(QFromDouble(FloatArg(x, fname), n), n);
+}
+LispObject LdQ15(LispObject x) { return ToQ(x, 15, "q15"); }
+LispObject LdQ31(LispObject x) { return ToQ(x, 31, "q31"); }
+LispObject LdQToFixNum(LispObject x) {
+  uint8_t n;
+  return MakeInteger(QArg(x, &n, "q->fixnum"));
+}
+/* single floats hold every Q15 number, doubles every Q31 one */
+LispObject LdQToFloat(LispObject x) {
+  uint8_t n;
+  int32_t q = QArg(x, &n, "q->float");
+  if (n == 15) {
+    return LispMakeSingleFloat((float)q / 32768.0f);
+  }
+  return LispMakeDoubleFloat((double)q / 2147483648.0);
+}
+LispObject LdQAdd(LispObject a, LispObject b) {
+  int32_t x, y;
+  uint8_t n = QArgs(a, b, &x, &y, "q+");
+  return MakeQ(QSaturate((int64_t)x + y, n), n);
+}
+LispObject LdQSub(LispObject a, LispObject b) {
+  int32_t x, y;
+  uint8_t n = QArgs(a, b, &x, &y, "q-");
+  return MakeQ(QSaturate((int64_t)x - y, n), n);
+}
+LispObject LdQMul(LispObject a, LispObject b) {
+  int32_t x, y;
+  uint8_t n = QArgs(a, b, &x, &y, "q*");
+  return MakeQ(QMul(x, y, n), n);
+}
+/* (q-mac acc a b) is acc + a * b, rounded once */
+LispObject LdQMac(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  int32_t acc, x, y;
+  uint8_t n = QArgs(stack[slot], stack[slot + 1], &acc, &x, "q-mac");
+  QArgs(stack[slot + 1], stack[slot + 2], &x, &y, "q-mac");
+  return MakeQ(QMac(acc, x, y, n), n);
+}
+
+#endif /* LISP_WITH_FIXED_POINT */
+/* vectors */
+/* (make-vector n [init [fill]]), room for n elements of which the first fill
+ * (all by default) are in use */
+LispObject LdMakeVector(LispNArg narg) {
+  LispIndex slot = stack_index - narg, i, n;
+  LispFixNum size = ToFixNum(stack[slot], "make-vector");
+  LispFixNum fill = size;
+  LispObject v;
+  if (size < 0 || size > (LispIndex)-1) {
+    LispError("make-vector: error: bad size\n");
+  }
+  if (narg == 3) {
+    fill = ToFixNum(stack[slot + 2], "make-vector");
+    if (fill < 0 || fill > size) {
+      LispError("make-vector: error: bad fill pointer\n");
+    }
+  }
+  n = (LispIndex)size;
+  v = LispMakeVector(n);
+  for (i = 0; i < n; ++i) {
+    v->vector.self[i] = (narg >= 2) ? stack[slot + 1] : LISP_NIL;
+  }
+  v->vector.fillp = (LispIndex)fill;
+  return v;
+}
+LispObject LdVector(LispNArg narg) {
+  LispObject v = LispMakeVector(narg);
+  memcpy(v->vector.self, &stack[stack_index - narg],
+         sizeof(LispObject) * narg);
+  v->vector.fillp = narg;
+  return v;
+}
+/* (aref v i) of a vector or typed array, or the character of a string */
+LispObject LdARef(LispObject v, LispObject i) {
+  LispIndex k;
+  if (LISP_StringP(v)) {
+    return LdChar(v, i);
+  }
+#if LISP_WITH_TYPED_ARRAYS
+  if (LISP_TypedArrayP(v)) {
+    k = StringIndex(i, v->typed_array.size, "aref");
+    if (k == v->typed_array.size) {
+      LispError("aref: error: index out of range\n");
+    }
+    return ArrayElement(v, k);
+  }
+#endif
+  k = StringIndex(i, ToVector(v, "aref")->fillp, "aref");
+  if (k == v->vector.fillp) {
+    LispError("aref: error: index out of range\n");
+  }
+  return v->vector.self[k];
+}
+LispObject LdASet(LispNArg narg) {
+  LispIndex slot = stack_index - narg, k;
+  LispObject v = stack[slot];
+#if LISP_WITH_TYPED_ARRAYS
+  if (LISP_TypedArrayP(v)) {
+    k = StringIndex(stack[slot + 1], v->typed_array.size, "aset");
+    if (k == v->typed_array.size) {
+      LispError("aset: error: index out of range\n");
+    }
+    ArrayFillWith(v, k, (LispIndex)(k + 1), stack[slot + 2], "aset");
+    return stack[slot + 2];
+  }
+#endif
+  k = StringIndex(stack[slot + 1], ToVector(v, "aset")->fillp,
+                            "aset");
+  if (k == v->vector.fillp) {
+    LispError("aset: error: index out of range\n");
+  }
+  return v->vector.self[k] = stack[slot + 2];
+}
+/* (vector-push x v) stores x at the fill pointer of v and returns its index.
+ * v keeps its identity: a full vector grows only where it lies at the top of
+ * the heap, elsewhere that is an error, so make it with room to fill:
+ * (make-vector 16 nil 0) */
+LispObject LdVectorPush(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispIndex k = ToVector(stack[slot + 1], "vector-push")->fillp;
+  if (k == stack[slot + 1]->vector.size &&
+      !LispVectorGrowInPlace(&stack[slot + 1], (LispIndex)(k + 1))) {
+    LispError("vector-push: error: vector full\n");
+  }
+  stack[slot + 1]->vector.self[stack[slot + 1]->vector.fillp++] = stack[slot];
+  return LISP_MAKE_FIXNUM(k);
+}
+LispObject LdVectorPop(LispObject v) { return LispVectorPop(v); }
+/* elements of a list, vector, typed array, string or slice */
+LispObject LdLength(LispObject x) {
+  LispFixNum n = 0;
+  if (LISP_VectorP(x)) {
+    n = x->vector.fillp;
+  } else if (LISP_TypedArrayP(x)) {
+    n = x->typed_array.size;
+  } else if (LISP_StringP(x)) {
+    n = x->string.size;
+  } else if (LISP_BitVectorP(x)) {
+    n = LISP_BIT_VECTOR_LENGTH(x);
+  } else if (LISP_SliceP(x)) {
+    n = x->slice.size;
+  } else {
+    while (LISP_ConsP(x)) {
+      ++n;
+      x = LISP_CONS_CDR(x);
+    }
+    if (!LISP_NULL(x)) {
+      LispTypeError("length", "Sequence", x);
+    }
+  }
+  return LISP_MAKE_FIXNUM(n);
+}
+#if LISP_WITH_BIT_VECTORS
+/* bit vectors */
+static LispIndex BitIndex(LispObject bv, LispObject i, char *fname) {
+  LispFixNum n = ToFixNum(i, fname);
+  if (n < 0 || (uint32_t)n >= LISP_BIT_VECTOR_LENGTH(bv)) {
+    LispErrorBegin();
+    LispPrintStr(fname);
+    LispError(": error: index out of range\n");
+  }
+  return (LispIndex)n;
+}
+static uint8_t BitArg(LispObject x, char *fname) {
+  LispFixNum b = ToFixNum(x, fname);
+  if (b != 0 && b != 1) {
+    LispErrorBegin();
+    LispPrintStr(fname);
+    LispError(": error: a bit is 0 or 1\n");
+  }
+  return (uint8_t)b;
+}
+/* (make-bit-vector n [bit]) */
+LispObject LdMakeBitVector(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispFixNum n = ToFixNum(stack[slot], "make-bit-vector");
+  uint8_t b = 0;
+  if (n < 0 || n >= (LispIndex)-1) {
+    LispError("make-bit-vector: error: bad size\n");
+  }
+  if (narg == 2) {
+    b = BitArg(stack[slot + 1], "make-bit-vector");
+  }
+  return LispMakeInitializedBitVector((LispIndex)n, b ? 0xFF : 0);
+}
+LispObject LdBit(LispObject bv, LispObject i) {
+  LispIndex k = BitIndex((LispObject)ToBitVector(bv, "bit"), i, "bit");
+  return LISP_MAKE_FIXNUM((bv->bit_vector.self[k >> 3] >> (k & 7)) & 1);
+}
+/* (set-bit bv i bit) */
+LispObject LdSetBit(LispNArg narg) {
+  LispIndex slot = stack_index - narg, k;
+  LispObject bv = stack[slot];
+  uint8_t b = BitArg(stack[slot + 2], "set-bit");
+  k = BitIndex((LispObject)ToBitVector(bv, "set-bit"), stack[slot + 1],
+               "set-bit");
+  if (b) {
+    bv->bit_vector.self[k >> 3] |= (uint8_t)(1u << (k & 7));
+  } else {
+    bv->bit_vector.self[k >> 3] &= (uint8_t) ~(1u << (k & 7));
+  }
+  return stack[slot + 2];
+}
+/* (bit-and x y [dst]), and (bit-not x [dst]): the result goes into dst,
+ * which may be x or y, or into a new bit vector when it is left out */
+static LispObject BitLogic(LispNArg narg, LispBitOp op, char *fname) {
+  LispIndex slot = stack_index - narg, i;
+  LispIndex k = (op == kBitNot) ? 1 : 2;
+  LispObject dst = (LispObject)ToBitVector(stack[slot], fname);
+  uint32_t n = LISP_BIT_VECTOR_LENGTH(dst);
+  for (i = 1; i < narg; ++i) {
+    ToBitVector(stack[slot + i], fname);
+    if (LISP_BIT_VECTOR_LENGTH(stack[slot + i]) != n) {
+      LispErrorBegin();
+      LispPrintStr(fname);
+      LispError(": error: bit vectors differ in length\n");
+    }
+  }
+  dst = (narg > k) ? stack[slot + k] : LispMakeBitVector((LispIndex)n);
+  BitVectorLogic(dst, stack[slot], stack[slot + k - 1], op);
+  return dst;
+}
+LispObject LdBitAnd(LispNArg narg) {
+  return BitLogic(narg, kBitAnd, "bit-and");
+}
+LispObject LdBitOr(LispNArg narg) {
+  return BitLogic(narg, kBitOr, "bit-or");
+}
+LispObject LdBitXor(LispNArg narg) {
+  return BitLogic(narg, kBitXor, "bit-xor");
+}
+LispObject LdBitNot(LispNArg narg) {
+  return BitLogic(narg, kBitNot, "bit-not");
+}
+LispObject LdBitCount(LispObject bv) {
+  return LISP_MAKE_FIXNUM(
+      BitVectorCount((LispObject)ToBitVector(bv, "bit-count")));
+}
+/* (find-first-set bv [start]) the index of the first 1 at or after start,
+ * nil when there is none */
+LispObject LdFindFirstSet(LispNArg narg) {
+  LispIndex slot = stack_index - narg, start = 0, i;
+  LispObject bv = (LispObject)ToBitVector(stack[slot], "find-first-set");
+  if (narg == 2) {
+    start = StringIndex(stack[slot + 1], (LispIndex)LISP_BIT_VECTOR_LENGTH(bv),
+                        "find-first-set");
+  }
+  i = BitVectorFindSet(bv, start);
+  return (i == NOTFOUND) ? LISP_NIL : LISP_MAKE_FIXNUM(i);
+}
+#endif /* LISP_WITH_BIT_VECTORS */
+/* hash tables */
+LispObject LdEql(LispObject a, LispObject b) {
+  return LISP_MAKE_BOOL(LispEql(a, b));
+}
+LispObject LdEqual(LispObject a, LispObject b) {
+  return LISP_MAKE_BOOL(LispEqual(a, b));
+}
+#if LISP_WITH_HASH_TABLES
+/* (make-hash-table [test [size]]), test one of eq eql equal, eql when
+ * omitted */
+LispObject LdMakeHashTable(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  uint8_t test = kHashEql;
+  LispFixNum size = 4;
+  char *name;
+  if (narg > 0) {
+    name = LispSymbolName((LispObject)ToSymbol(stack[slot], "make-hash-table"));
+    for (test = 0; test < LISP_HASH_TESTS; ++test) {
+      if (strcmp(name, lisp_hash_test_names[test]) == 0) {
+        break;
+      }
+    }
+    if (test == LISP_HASH_TESTS) {
+      LispError("make-hash-table: error: test is one of eq eql equal\n");
+    }
+  }
+  if (narg > 1) {
+    size = ToFixNum(stack[slot + 1], "make-hash-table");
+    if (size < 0 || size > 4096) {
+      LispError("make-hash-table: error: bad size\n");
+    }
+  }
+  return LispMakeHashTable(test, (LispIndex)size);
+}
+/* (gethash key table [default]) */
+LispObject LdGetHash(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  ToHashTable(stack[slot + 1], "gethash");
+  return HashTableGet(stack[slot + 1], stack[slot],
+                      (narg == 3) ? stack[slot + 2] : LISP_NIL);
+}
+/* (puthash key value table) */
+LispObject LdPutHash(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  ToHashTable(stack[slot + 2], "puthash");
+  HashTablePut(stack[slot + 2], stack[slot], stack[slot + 1]);
+  return stack[slot + 1];
+}
+LispObject LdRemHash(LispObject key, LispObject table) {
+  ToHashTable(table, "remhash");
+  return LISP_MAKE_BOOL(HashTableRemove(table, key));
+}
+/* (maphash f table) calls (f key value) for each pair, oldest first */
+LispObject LdMapHash(LispNArg narg) {
+  LispIndex slot = stack_index - narg, p;
+  LispObject e;
+  ToHashTable(stack[slot + 1], "maphash");
+  for (p = 0;; ++p) {
+    e = stack[slot + 1]->hash_table.entries;
+    if (2u * p >= e->vector.fillp) {
+      break;
+    }
+    if (!LISP_UNBOUNDP(e->vector.self[2 * p])) {
+      PUSH(stack[slot]);
+      PUSH(e->vector.self[2 * p]);
+      PUSH(stack[slot + 1]->hash_table.entries->vector.self[2 * p + 1]);
+      LispFuncall(2);
+      stack_index = (LispIndex)(slot + narg);
+    }
+  }
+  return LISP_NIL;
+}
+LispObject LdHashTableCount(LispObject table) {
+  return LISP_MAKE_FIXNUM(ToHashTable(table, "hash-table-count")->count);
+}
+/* a hash alike for equal objects, that a GC does not change */
+LispObject LdSxHash(LispObject x) {
+  return LISP_MAKE_FIXNUM(LispHash(x, kHashEqual, NULL) & 0x1FFFFFFFU);
+}
+#endif /* LISP_WITH_HASH_TABLES */
+#if LISP_WITH_RECORDS
+/* records */
+/* A record is laid out as a vector whose slot 0 is its descriptor
+ * #(name slot ...), so record slot k is named by descriptor slot k. Its
+ * type is the name: a symbol, which stays eq in compiled code too. */
+static bool RecordOfP(LispObject r, LispObject name) {
+  return LISP_RecordP(r) && r->vector.self[0]->vector.self[0] == name;
+}
+static LispIndex RecordSlot(LispObject r, LispObject name, LispObject k,
+                            char *fname) {
+  LispFixNum i;
+  if (!RecordOfP(r, name)) {
+    LispTypeError(fname,
+                  LISP_SymbolP(name) ? LispSymbolName(name) : "Record", r);
+  }
+  i = ToFixNum(k, fname);
+  if (i < 1 || i >= r->vector.size) {
+    LispErrorBegin();
+    LispPrintStr(fname);
+    LispError(": error: index out of range\n");
+  }
+  return (LispIndex)i;
+}
+/* (make-record desc x1 ... xn) */
+LispObject LdMakeRecord(LispNArg narg) {
+  LispIndex slot = stack_index - narg, i;
+  LispObject r, desc = stack[slot];
+  if (!LISP_VectorP(desc) || desc->vector.fillp != narg ||
+      !LISP_SymbolP(desc->vector.self[0])) {
+    LispError("make-record: error: expected #(name slot ...) and a value "
+              "for each slot\n");
+  }
+  r = LispMakeRecord(desc);
+  for (i = 1; i < narg; ++i) {
+    r->vector.self[i] = stack[slot + i];
+  }
+  return r;
+}
+LispObject LdRecordP(LispObject x, LispObject name) {
+  return LISP_MAKE_BOOL(RecordOfP(x, name));
+}
+/* (record-ref r name k) */
+LispObject LdRecordRef(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispObject r = stack[slot];
+  return r->vector
+      .self[RecordSlot(r, stack[slot + 1], stack[slot + 2], "record-ref")];
+}
+/* (record-set r name k x) */
+LispObject LdRecordSet(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispObject r = stack[slot];
+  r->vector.self[RecordSlot(r, stack[slot + 1], stack[slot + 2],
+                            "record-set")] = stack[slot + 3];
+  return stack[slot + 3];
+}
+/* the list of the n objects on top of the stack, which are popped */
+static LispObject StackList(LispIndex n) {
+  PUSH(LISP_NIL);
+  while (n-- > 0) {
+    stack[stack_index - 2] =
+        cons(stack[stack_index - 2], stack[stack_index - 1]);
+    POPN(1);
+  }
+  return POP();
+}
+/* the symbol prefix name sep slot, e.g. set-point-x */
+static LispObject RecordFunctionName(char *prefix, LispObject name,
+                                     char *sep, char *slot) {
+  char buf[48], *p = LispSymbolName(name);
+  size_t a = strlen(prefix), b = strlen(p), c = strlen(sep), d = strlen(slot);
+  if (a + b + c + d >= sizeof(buf)) {
+    LispError("defstruct: error: name too long\n");
+  }
+  memcpy(buf, prefix, a);
+  memcpy(buf + a, p, b);
+  memcpy(buf + a + b, sep, c);
+  memcpy(buf + a + b + c, slot, d + 1);
+  return LispMakeSymbol(buf);
+}
+/* define-inline of the name, args and body on top of the stack */
+static void DefineRecordFunction(void) {
+  LispObject form = StackList(3);
+  PUSH(form);
+  LdDefineInline(1);
+}
+/* (defstruct name slot ...) defines (make-name x1 ... xn), (name-p x),
+ * (name-slot x) and (set-name-slot x v) with define-inline, so under
+ * *optimize* an access is open coded as one checked load
+ * (record-ref x (quote name) k) */
+LispObject LdDefStruct(LispNArg narg) {
+  LispIndex slot, k, n = 0;
+  LispObject v, o;
+  ArgCount("defstruct", narg, 1);
+  slot = (LispIndex)(stack_index - 1);
+  ToSymbol(LISP_CONS_CAR_SAFE(stack[slot]), "defstruct");
+  for (v = LISP_CONS_CDR(stack[slot]); LISP_ConsP(v); v = LISP_CONS_CDR(v)) {
+    ToSymbol(LISP_CONS_CAR(v), "defstruct");
+    ++n;
+  }
+  o = LispMakeVector((LispIndex)(n + 1));
+  for (v = stack[slot]; LISP_ConsP(v); v = LISP_CONS_CDR(v)) {
+    o->vector.self[o->vector.fillp++] = LISP_CONS_CAR(v);
+  }
+  PUSH(o); /* slot + 1, the descriptor */
+  /* (make-name (slot ...) (make-record (quote desc) slot ...)) */
+  PUSH(RecordFunctionName("make-", LISP_CONS_CAR(stack[slot]), "", ""));
+  PUSH(LISP_CONS_CDR(stack[slot]));
+  PUSH(LispMakeSymbol("quote"));
+  PUSH(stack[slot + 1]);
+  v = StackList(2);
+  PUSH(v);
+  stack[stack_index - 1] =
+      cons(stack[stack_index - 1], LISP_CONS_CDR(stack[slot]));
+  o = LispMakeSymbol("make-record");
+  stack[stack_index - 1] = cons(o, stack[stack_index - 1]);
+  DefineRecordFunction();
+  /* (name-p (x) (record-p x (quote name))) */
+  PUSH(RecordFunctionName("", LISP_CONS_CAR(stack[slot]), "-p", ""));
+  PUSH(LispMakeSymbol("x"));
+  v = StackList(1);
+  PUSH(v);
+  PUSH(LispMakeSymbol("record-p"));
+  PUSH(LispMakeSymbol("x"));
+  PUSH(LispMakeSymbol("quote"));
+  PUSH(LISP_CONS_CAR(stack[slot]));
+  v = StackList(2);
+  PUSH(v);
+  v = StackList(3);
+  PUSH(v);
+  DefineRecordFunction();
+  for (k = 1; k <= n; ++k) {
+    char *field = LispSymbolName(stack[slot + 1]->vector.self[k]);
+    /* (name-slot (x) (record-ref x (quote name) k)) */
+    PUSH(RecordFunctionName("", LISP_CONS_CAR(stack[slot]), "-", field));
+    PUSH(LispMakeSymbol("x"));
+    v = StackList(1);
+    PUSH(v);
+    PUSH(LispMakeSymbol("record-ref"));
+    PUSH(LispMakeSymbol("x"));
+    PUSH(LispMakeSymbol("quote"));
+    PUSH(LISP_CONS_CAR(stack[slot]));
+    v = StackList(2);
+    PUSH(v);
+    PUSH(LISP_MAKE_FIXNUM(k));
+    v = StackList(4);
+    PUSH(v);
+    DefineRecordFunction();
+    /* (set-name-slot (x v) (record-set x (quote name) k v)) */
+    field = LispSymbolName(stack[slot + 1]->vector.self[k]);
+    PUSH(RecordFunctionName("set-", LISP_CONS_CAR(stack[slot]), "-", field));
+    PUSH(LispMakeSymbol("x"));
+    PUSH(LispMakeSymbol("v"));
+    v = StackList(2);
+    PUSH(v);
+    PUSH(LispMakeSymbol("record-set"));
+    PUSH(LispMakeSymbol("x"));
+    PUSH(LispMakeSymbol("quote"));
+    PUSH(LISP_CONS_CAR(stack[slot]));
+    v = StackList(2);
+    PUSH(v);
+    PUSH(LISP_MAKE_FIXNUM(k));
+    PUSH(LispMakeSymbol("v"));
+    v = StackList(5);
+    PUSH(v);
+    DefineRecordFunction();
+  }
+  v = LISP_CONS_CAR(stack[slot]);
+  stack_index = slot;
+  return v;
+}
+#endif /* LISP_WITH_RECORDS */
+#if LISP_WITH_QUEUES
+/* queues */
+/* the interrupt fed ring behind q, NULL when q is a lisp queue */
+static LispIsrQueue *QueueArg(LispObject q, char *fname) {
+  if (LISP_IsrQueueP(q)) {
+    return q->isr_queue.queue;
+  }
+  ToQueue(q, fname);
+  return NULL;
+}
+static LispIndex QueueCount(LispObject q, char *fname) {
+  LispIsrQueue *iq = QueueArg(q, fname);
+  return iq ? (LispIndex)(uint16_t)(iq->insert - iq->get) : q->queue.count;
+}
+/* (make-queue n [overwrite]), when full an overwriting queue drops its
+ * oldest element on enqueue, any other refuses the new one */
+LispObject LdMakeQueue(LispNArg narg) {
+  LispIndex slot = stack_index - narg;
+  LispFixNum n = ToFixNum(stack[slot], "make-queue");
+  if (n < 1 || n > (LispFixNum)(HEAP_SIZE / sizeof(LispObject))) {
+    LispError("make-queue: error: size out of range\n");
+  }
+  return LispMakeQueue((LispIndex)n,
+                       narg > 1 && LISP_TO_BOOL(stack[slot + 1]));
+}
+/* (enqueue q x), nil when q is full and does not overwrite */
+LispObject LdEnqueue(LispObject q, LispObject x) {
+  struct LispQueue *r;
+  LispIndex i;
+  if (QueueArg(q, "enqueue") != NULL) {
+    LispError("enqueue: error: an isr queue is filled by its handler\n");
+  }
+  r = &q->queue;
+  if (r->count == r->size) {
+    if (!r->overwrite) {
+      return LISP_NIL;
+    }
+    if (++r->head == r->size) {
+      r->head = 0;
+    }
+    --r->count;
+  }
+  i = (LispIndex)(r->head + r->count);
+  r->self[i < r->size ? i : i - r->size] = x;
+  ++r->count;
+  return LISP_T;
+}
+/* the oldest element, removed when take, or default when empty */
+static LispObject QueueFront(LispNArg narg, bool take, char *fname) {
+  LispIndex slot = stack_index - narg;
+  LispObject q = stack[slot], x;
+  LispIsrQueue *iq = QueueArg(q, fname);
+  if (QueueCount(q, fname) == 0) {
+    return narg > 1 ? stack[slot + 1] : LISP_NIL;
+  }
+  if (iq != NULL) {
+    uint16_t i = iq->get;
+    int32_t n = iq->self[i & iq->mask];
+    if (take) {
+      iq->get = (uint16_t)(i + 1); /* hands the slot back to the isr */
+    }
+    return MakeInteger(n);
+  }
+  x = q->queue.self[q->queue.head];
+  if (take) {
+    q->queue.self[q->queue.head] = LISP_NIL;
+    if (++q->queue.head == q->queue.size) {
+      q->queue.head = 0;
+    }
+    --q->queue.count;
+  }
+  return x;
+}
+/* (dequeue q [default]) */
+LispObject LdDequeue(LispNArg narg) {
+  return QueueFront(narg, true, "dequeue");
+}
+/* (peek q [default]) */
+LispObject LdPeek(LispNArg narg) { return QueueFront(narg, false, "peek"); }
+LispObject LdQueueCount(LispObject q) {
+  return LISP_MAKE_FIXNUM(QueueCount(q, "queue-count"));
+}
+LispObject LdFullP(LispObject q) {
+  LispIsrQueue *iq = QueueArg(q, "full-p");
+  return LISP_MAKE_BOOL(iq ? (uint16_t)(iq->insert - iq->get) > iq->mask
+                           : q->queue.count == q->queue.size);
+}
+/* pushes an isr queue refused for being full */
+LispObject LdQueueDrops(LispObject q) {
+  return LISP_MAKE_FIXNUM(ToIsrQueue(q, "queue-drops")->queue->drops);
+}
+
+#endif /* LISP_WITH_QUEUES */
+#if LISP_WITH_BYTE_BUFFERS
+/* byte buffers */
+/* the bytes of a u8 array, a string or a slice of either, *n their count;
+ * the pointer is only good until the next allocation */
+static uint8_t *ByteArg(LispObject b, LispIndex *n, char *fname) {
+  LispIndex offset = 0;
+  if (LISP_SliceP(b)) {
+    offset = b->slice.offset;
+    *n = b->slice.size;
+    b = b->slice.buffer;
+  } else if (LISP_StringP(b)) {
+    *n = b->string.size;
+  } else if (LISP_TypedArrayP(b) && b->typed_array.etype == kElemU8) {
+    *n = b->typed_array.size;
+  } else {
+    LispTypeError(fname, "Bytes", b);
+  }
+  return (LISP_StringP(b) ? (uint8_t *)b->string.self
+                          : b->typed_array.self.u8) +
+         offset;
+}
+/* (slice b offset [length]) shares the bytes of b, a slice of a slice is
+ * one of the underlying buffer */
+LispObject LdSlice(LispNArg narg) {
+  LispIndex slot = stack_index - narg, n, offset, length;
+  LispObject b = stack[slot];
+  ByteArg(b, &n, "slice");
+  offset = StringIndex(stack[slot + 1], n, "slice");
+  length = (LispIndex)(n - offset);
+  if (narg == 3) {
+    length = StringIndex(stack[slot + 2], length, "slice");
+  }
+  if (LISP_SliceP(b)) {
+    offset = (LispIndex)(offset + b->slice.offset);
+    b = b->slice.buffer;
+  }
+  return LispMakeSlice(b, offset, length);
+}
+/* the first of width bytes at i in b */
+static uint8_t *BytesAt(LispObject b, LispObject i, uint8_t width,
+                        char *fname) {
+  LispIndex n;
+  uint8_t *p = ByteArg(b, &n, fname);
+  LispFixNum k = ToFixNum(i, fname);
+  if (k < 0 || k + width > n) {
+    LispErrorBegin();
+    LispPrintStr(fname);
+    LispError(": error: index out of range\n");
+  }
+  return p + k;
+}
+static uint32_t BytesGet(LispObject b, LispObject i, uint8_t width, bool big,
+                         char *fname) {
+  uint8_t *p = BytesAt(b, i, width, fname), j;
+  uint32_t x = 0;
+  for (j = 0; j < width; ++j) {
+    x |= (uint32_t)p[big ? width - 1 - j : j] << (8 * j);
+  }
+  return x;
+}
+/* (name b i x) stores the low width bytes of x, a fixnum or what a u32
+ * reader returned */
+static LispObject BytesPut(LispNArg narg, uint8_t width, bool big,
+                           char *fname) {
+  LispIndex slot = stack_index - narg;
+  LispObject x = stack[slot + 2];
+  uint8_t *p = BytesAt(stack[slot], stack[slot + 1], width, fname), j;
+  uint32_t v = LISP_DoubleFloatP(x) ? (uint32_t)(int64_t)LISP_DOUBLE_FLOAT(x)
+                                    : (uint32_t)ToFixNum(x, fname);
+  for (j = 0; j < width; ++j) {
+    p[big ? width - 1 - j : j] = (uint8_t)(v >> (8 * j));
+  }
+  return x;
+}
+LispObject LdU8Ref(LispObject b, LispObject i) {
+  return LISP_MAKE_FIXNUM(*BytesAt(b, i, 1, "u8-ref"));
+}
+LispObject LdU16LeRef(LispObject b, LispObject i) {
+  return LISP_MAKE_FIXNUM(BytesGet(b, i, 2, false, "u16le-ref"));
+}
+LispObject LdU16BeRef(LispObject b, LispObject i) {
+  return LISP_MAKE_FIXNUM(BytesGet(b, i, 2, true, "u16be-ref"));
+}
+/* above 2^29 the fixnums of a 32 bit target end, the result is a float */
+LispObject LdU32LeRef(LispObject b, LispObject i) {
+  return MakeInteger(BytesGet(b, i, 4, false, "u32le-ref"));
+}
+LispObject LdU32BeRef(LispObject b, LispObject i) {
+  return MakeInteger(BytesGet(b, i, 4, true, "u32be-ref"));
+}
+LispObject LdU8Set(LispNArg narg) {
+  return BytesPut(narg, 1, false, "u8-set");
+}
+LispObject LdU16LeSet(LispNArg narg) {
+  return BytesPut(narg, 2, false, "u16le-set");
+}
+LispObject LdU16BeSet(LispNArg narg) {
+  return BytesPut(narg, 2, true, "u16be-set");
+}
+LispObject LdU32LeSet(LispNArg narg) {
+  return BytesPut(narg, 4, false, "u32le-set");
+}
+LispObject LdU32BeSet(LispNArg narg) {
+  return BytesPut(narg, 4, true, "u32be-set");
+}
+
+#endif /* LISP_WITH_BYTE_BUFFERS */
 /* usefull */
 LispObject LdGc(LispNArg narg) {
-  ArgCount("gc", narg, 0);
+  (void)narg;
   GC();
   return LISP_T;
 }
 LispObject LdPrintStack(LispNArg narg) {
+  (void)narg;
   LispIndex i = 0;
-  ArgCount("print-stack", narg, 0);
   LispPrintStr("\nstack_index: ");
   LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE, stack_index,
                         lisp_number_base));
@@ -546,25 +1788,24 @@ LispObject LdPrintStack(LispNArg narg) {
   return LISP_T;
 }
 LispObject LdResetStack(LispNArg narg) {
-  ArgCount("reset-stack", narg, 0);
+  (void)narg;
   stack_index = 0;
   LispPrintObject(LISP_T, false);
   LispPrintByte('\n');
   longjmp(LispEnv()->top_level, 1);
   return LISP_T;
 }
-LispObject LdSymbolName(LispNArg narg) {
-  ArgCount("symbol-name", narg, 1);
-  return LispMakeString(LispSymbolName(POP()));
+LispObject LdSymbolName(LispObject sym) {
+  return LispMakeString(LispSymbolName(sym));
 }
 LispObject LdPrintSymbols(LispNArg narg) {
-  ArgCount("print-symbols", narg, 0);
+  (void)narg;
   LispPrintObject(LispEnv()->symbols, false);
   LispPrintByte('\n');
   return LISP_T;
 }
 LispObject LdNumberOfObjects(LispNArg narg) {
-  ArgCount("print-symbols", narg, 0);
+  (void)narg;
   LispPrintStr("gc: found ");
   LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
                         *LispNumberOfObjectsAllocated(), 10));
@@ -576,6 +1817,13 @@ LispObject LdNumberOfObjects(LispNArg narg) {
   LispPrintStr(" bytes.\n");
   return LISP_T;
 }
+/* (flush) waits for the queued output to go out on the wire and returns how
+ * many bytes so far found the output ring full */
+LispObject LdFlush(LispNArg narg) {
+  (void)narg;
+  LispPrintFlush();
+  return LISP_MAKE_FIXNUM(terminal_out_stalls);
+}
 
 /* initialization */
 void LispInit(void) {
@@ -607,9 +1855,11 @@ void LispInit(void) {
 
   LispObject o;
 
-  LISP_SET_FUNCTION("gc", LdGc);
+  LISP_SET_FUNCTION("gc", LdGc, 0, 0, kFunctionAllocating);
   LISP_SET_CONSTANT_VALUE("nil", LISP_NIL);
   LISP_SET_CONSTANT_VALUE("t", LISP_T);
+  LISP_SET_VALUE("*optimize*", LISP_NIL);
+  LISP_SET_VALUE("*print-circle*", LISP_NIL);
 
   LISP_SET_SPECIAL("quote", LdQuote);
   LISP_SET_SPECIAL("macro", LdMacro);
@@ -617,42 +1867,150 @@ void LispInit(void) {
   LISP_SET_SPECIAL("label", LdLabel);
   LISP_SET_SPECIAL("if", LdIf);
   LISP_SET_SPECIAL("cond", LdCond);
+  LISP_SET_SPECIAL("case", LdCase);
+  LISP_SET_SPECIAL("define-inline", LdDefineInline);
+#if LISP_WITH_RECORDS
+  LISP_SET_SPECIAL("defstruct", LdDefStruct);
+#endif
   LISP_SET_SPECIAL("and", LdAnd);
   LISP_SET_SPECIAL("or", LdOr);
   LISP_SET_SPECIAL("while", LdWhile);
   LISP_SET_SPECIAL("progn", LdProgn);
-  LISP_SET_FUNCTION("set", LdSet);
-  LISP_SET_FUNCTION("boundp", LdBoundp);
-  LISP_SET_FUNCTION("eq", LdEq);
-  LISP_SET_FUNCTION("cons", LdCons);
-  LISP_SET_FUNCTION("car", LdCar);
-  LISP_SET_FUNCTION("cdr", LdCdr);
-  LISP_SET_FUNCTION("rplaca", LdRPlacA);
-  LISP_SET_FUNCTION("rplacd", LdRPlacD);
-  LISP_SET_FUNCTION("atom", LdAtom);
-  LISP_SET_FUNCTION("consp", LdConsP);
-  LISP_SET_FUNCTION("symbolp", LdSymbolP);
-  LISP_SET_FUNCTION("numberp", LdNumberP);
-  LISP_SET_FUNCTION("fixnump", LdFixNumP);
-  LISP_SET_FUNCTION("+", LdAdd);
-  LISP_SET_FUNCTION("-", LdSub);
-  LISP_SET_FUNCTION("*", LdMul);
-  LISP_SET_FUNCTION("/", LdDiv);
-  LISP_SET_FUNCTION("<", LdLt);
-  LISP_SET_FUNCTION("not", LdNot);
-  LISP_SET_FUNCTION("eval", LdEval);
-  LISP_SET_FUNCTION("print", LdPrint);
-  LISP_SET_FUNCTION("princ", LdPrinc);
-  LISP_SET_FUNCTION("read", LdRead);
-  LISP_SET_FUNCTION("error", LdError);
-  LISP_SET_FUNCTION("prog1", LdProg1);
-  LISP_SET_FUNCTION("assoc", LdAssoc);
-  LISP_SET_FUNCTION("apply", LdApply);
+  LISP_SET_SPECIAL("with-output-to-string", LdWithOutputToString);
+  LISP_SET_FUNCTION2("set", LdSet, 0);
+  LISP_SET_FUNCTION1("boundp", LdBoundp, 0);
+  LISP_SET_FUNCTION2("eq", LdEq, kFunctionPure);
+  LISP_SET_FUNCTION2("cons", LdCons, kFunctionAllocating);
+  LISP_SET_FUNCTION1("car", LdCar, kFunctionPure);
+  LISP_SET_FUNCTION1("cdr", LdCdr, kFunctionPure);
+  LISP_SET_FUNCTION2("rplaca", LdRPlacA, 0);
+  LISP_SET_FUNCTION2("rplacd", LdRPlacD, 0);
+  LISP_SET_FUNCTION1("atom", LdAtom, kFunctionPure);
+  LISP_SET_FUNCTION1("consp", LdConsP, kFunctionPure);
+  LISP_SET_FUNCTION1("symbolp", LdSymbolP, kFunctionPure);
+  LISP_SET_FUNCTION1("numberp", LdNumberP, kFunctionPure);
+  LISP_SET_FUNCTION1("fixnump", LdFixNumP, kFunctionPure);
+  LISP_SET_FUNCTION("+", LdAdd, 0, LISP_ARGS_ANY, kFunctionPure);
+  LISP_SET_FUNCTION("-", LdSub, 1, LISP_ARGS_ANY, kFunctionPure);
+  LISP_SET_FUNCTION("*", LdMul, 0, LISP_ARGS_ANY, kFunctionPure);
+  LISP_SET_FUNCTION("/", LdDiv, 1, LISP_ARGS_ANY, kFunctionPure);
+  LISP_SET_FUNCTION2("<", LdLt, kFunctionPure);
+  LISP_SET_FUNCTION1("not", LdNot, kFunctionPure);
+  LISP_SET_FUNCTION1("eval", LdEval, kFunctionAllocating);
+  LISP_SET_FUNCTION("print", LdPrint, 1, LISP_ARGS_ANY, kFunctionAllocating);
+  LISP_SET_FUNCTION("princ", LdPrinc, 1, LISP_ARGS_ANY, kFunctionAllocating);
+  LISP_SET_FUNCTION1("prin1-to-string", LdPrin1ToString, kFunctionAllocating);
+  LISP_SET_FUNCTION("read", LdRead, 0, 0, kFunctionAllocating);
+  LISP_SET_FUNCTION("read-from-string", LdReadFromString, 1, 2,
+                    kFunctionAllocating);
+  LISP_SET_FUNCTION2("load-from-memory", LdLoadFromMemory, kFunctionAllocating);
+  LISP_SET_FUNCTION("error", LdError, 0, LISP_ARGS_ANY, kFunctionAllocating);
+  LISP_SET_FUNCTION("prog1", LdProg1, 1, LISP_ARGS_ANY, 0);
+  LISP_SET_FUNCTION2("assoc", LdAssoc, kFunctionPure);
+  LISP_SET_FUNCTION2("apply", LdApply, kFunctionAllocating);
 
-  LISP_SET_FUNCTION("print-stack", LdPrintStack);
-  LISP_SET_FUNCTION("reset-stack", LdResetStack);
-  LISP_SET_FUNCTION("gensym", LdMakeGenSym);
-  LISP_SET_FUNCTION("symbol-name", LdSymbolName);
-  LISP_SET_FUNCTION("print-symbols", LdPrintSymbols);
-  LISP_SET_FUNCTION("objects", LdNumberOfObjects);
+  LISP_SET_FUNCTION("print-stack", LdPrintStack, 0, 0, kFunctionAllocating);
+  LISP_SET_FUNCTION("reset-stack", LdResetStack, 0, 0, 0);
+  LISP_SET_FUNCTION("gensym", LdMakeGenSym, 0, 0, kFunctionAllocating);
+  LISP_SET_FUNCTION1("symbol-name", LdSymbolName, kFunctionAllocating);
+  LISP_SET_FUNCTION1("string-length", LdStringLength, kFunctionPure);
+  LISP_SET_FUNCTION2("char", LdChar, kFunctionPure);
+  LISP_SET_FUNCTION("substring", LdSubString, 2, 3, kFunctionAllocating);
+  LISP_SET_FUNCTION2("string=", LdStringEqual, kFunctionPure);
+  LISP_SET_FUNCTION2("string<", LdStringLess, kFunctionPure);
+  LISP_SET_FUNCTION("string-search", LdStringSearch, 2, 3, kFunctionPure);
+  LISP_SET_FUNCTION("string-append", LdStringAppend, 0, LISP_ARGS_ANY,
+                    kFunctionAllocating);
+  LISP_SET_FUNCTION("string->list", LdStringToList, 1, 1, kFunctionAllocating);
+  LISP_SET_FUNCTION("number->string", LdNumberToString, 1, 2,
+                    kFunctionAllocating);
+  LISP_SET_FUNCTION("make-vector", LdMakeVector, 1, 3, kFunctionAllocating);
+  LISP_SET_FUNCTION("vector", LdVector, 0, LISP_ARGS_ANY, kFunctionAllocating);
+  LISP_SET_FUNCTION2("aref", LdARef, kFunctionAllocating);
+  LISP_SET_FUNCTION("aset", LdASet, 3, 3, 0);
+  LISP_SET_FUNCTION("vector-push", LdVectorPush, 2, 2, kFunctionAllocating);
+  LISP_SET_FUNCTION1("vector-pop", LdVectorPop, 0);
+  LISP_SET_FUNCTION1("length", LdLength, 0);
+#if LISP_WITH_TYPED_ARRAYS
+  LISP_SET_FUNCTION("make-array", LdMakeArray, 2, 3, kFunctionAllocating);
+  LISP_SET_FUNCTION("array-fill", LdArrayFill, 2, 4, 0);
+  LISP_SET_FUNCTION("array-copy", LdArrayCopy, 2, 5, 0);
+  LISP_SET_FUNCTION1("array-sum", LdArraySum, kFunctionAllocating);
+  LISP_SET_FUNCTION1("array-min", LdArrayMin, kFunctionAllocating);
+  LISP_SET_FUNCTION1("array-max", LdArrayMax, kFunctionAllocating);
+  LISP_SET_FUNCTION("array-scale", LdArrayScale, 2, 3, 0);
+#endif
+#if LISP_WITH_FIXED_POINT
+  LISP_SET_FUNCTION1("q15", LdQ15, kFunctionPure);
+  LISP_SET_FUNCTION1("q31", LdQ31, kFunctionPure | kFunctionAllocating);
+  LISP_SET_FUNCTION1("q->fixnum", LdQToFixNum,
+                     kFunctionPure | kFunctionAllocating);
+  LISP_SET_FUNCTION1("q->float", LdQToFloat,
+                     kFunctionPure | kFunctionAllocating);
+  LISP_SET_FUNCTION2("q+", LdQAdd, kFunctionPure | kFunctionAllocating);
+  LISP_SET_FUNCTION2("q-", LdQSub, kFunctionPure | kFunctionAllocating);
+  LISP_SET_FUNCTION2("q*", LdQMul, kFunctionPure | kFunctionAllocating);
+  LISP_SET_FUNCTION("q-mac", LdQMac, 3, 3,
+                    kFunctionPure | kFunctionAllocating);
+#endif
+#if LISP_WITH_BIT_VECTORS
+  LISP_SET_FUNCTION("make-bit-vector", LdMakeBitVector, 1, 2,
+                    kFunctionAllocating);
+  LISP_SET_FUNCTION2("bit", LdBit, 0);
+  LISP_SET_FUNCTION("set-bit", LdSetBit, 3, 3, 0);
+  LISP_SET_FUNCTION("bit-and", LdBitAnd, 2, 3, kFunctionAllocating);
+  LISP_SET_FUNCTION("bit-or", LdBitOr, 2, 3, kFunctionAllocating);
+  LISP_SET_FUNCTION("bit-xor", LdBitXor, 2, 3, kFunctionAllocating);
+  LISP_SET_FUNCTION("bit-not", LdBitNot, 1, 2, kFunctionAllocating);
+  LISP_SET_FUNCTION1("bit-count", LdBitCount, 0);
+  LISP_SET_FUNCTION("find-first-set", LdFindFirstSet, 1, 2, 0);
+#endif
+  LISP_SET_FUNCTION2("eql", LdEql, kFunctionPure);
+  LISP_SET_FUNCTION2("equal", LdEqual, kFunctionPure);
+#if LISP_WITH_HASH_TABLES
+  LISP_SET_FUNCTION("make-hash-table", LdMakeHashTable, 0, 2,
+                    kFunctionAllocating);
+  LISP_SET_FUNCTION("gethash", LdGetHash, 2, 3, 0);
+  LISP_SET_FUNCTION("puthash", LdPutHash, 3, 3, kFunctionAllocating);
+  LISP_SET_FUNCTION2("remhash", LdRemHash, 0);
+  LISP_SET_FUNCTION("maphash", LdMapHash, 2, 2, kFunctionAllocating);
+  LISP_SET_FUNCTION1("hash-table-count", LdHashTableCount, 0);
+  LISP_SET_FUNCTION1("sxhash", LdSxHash, kFunctionPure);
+#endif
+#if LISP_WITH_RECORDS
+  LISP_SET_FUNCTION("make-record", LdMakeRecord, 1, LISP_ARGS_ANY,
+                    kFunctionAllocating);
+  LISP_SET_FUNCTION2("record-p", LdRecordP, kFunctionPure);
+  LISP_SET_FUNCTION("record-ref", LdRecordRef, 3, 3, 0);
+  LISP_SET_FUNCTION("record-set", LdRecordSet, 4, 4, 0);
+#endif
+#if LISP_WITH_QUEUES
+  LISP_SET_FUNCTION("make-queue", LdMakeQueue, 1, 2, kFunctionAllocating);
+  LISP_SET_FUNCTION2("enqueue", LdEnqueue, 0);
+  LISP_SET_FUNCTION("dequeue", LdDequeue, 1, 2, kFunctionAllocating);
+  LISP_SET_FUNCTION("peek", LdPeek, 1, 2, kFunctionAllocating);
+  LISP_SET_FUNCTION1("queue-count", LdQueueCount, 0);
+  LISP_SET_FUNCTION1("full-p", LdFullP, 0);
+  LISP_SET_FUNCTION1("queue-drops", LdQueueDrops, 0);
+#endif
+#if LISP_WITH_BYTE_BUFFERS
+  LISP_SET_FUNCTION("slice", LdSlice, 2, 3, kFunctionAllocating);
+  LISP_SET_FUNCTION2("u8-ref", LdU8Ref, 0);
+  LISP_SET_FUNCTION2("u16le-ref", LdU16LeRef, 0);
+  LISP_SET_FUNCTION2("u16be-ref", LdU16BeRef, 0);
+  LISP_SET_FUNCTION2("u32le-ref", LdU32LeRef, kFunctionAllocating);
+  LISP_SET_FUNCTION2("u32be-ref", LdU32BeRef, kFunctionAllocating);
+  LISP_SET_FUNCTION("u8-set", LdU8Set, 3, 3, 0);
+  LISP_SET_FUNCTION("u16le-set", LdU16LeSet, 3, 3, 0);
+  LISP_SET_FUNCTION("u16be-set", LdU16BeSet, 3, 3, 0);
+  LISP_SET_FUNCTION("u32le-set", LdU32LeSet, 3, 3, 0);
+  LISP_SET_FUNCTION("u32be-set", LdU32BeSet, 3, 3, 0);
+#endif
+  LISP_SET_FUNCTION("print-symbols", LdPrintSymbols, 0, 0,
+                    kFunctionAllocating);
+  LISP_SET_FUNCTION("objects", LdNumberOfObjects, 0, 0, 0);
+  LISP_SET_FUNCTION("flush", LdFlush, 0, 0, 0);
+#ifdef LISP_COMPILED
+  LispInitCompiled();
+#endif
 }
@@ -64,5 +64,9 @@
 
 /* initialization */
 void LispInit(void);
+#ifdef LISP_COMPILED
+/* generated by tools/lisp2c */
+void LispInitCompiled(void);
+#endif
 
 #endif /* LISPDOOR_FUNCTIONS_H_INCLUDED */
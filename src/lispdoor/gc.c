@@ -79,12 +79,21 @@ Q_DEFINE_THIS_MODULE("gc")
 #define MARKED_P(c) LispBitVectorGet(gc_mark_bit, (uint32_t)OBJ_INDEX(c))
 #define MARK_OBJ(c) LispBitVectorSet(gc_mark_bit, (uint32_t)OBJ_INDEX(c), 1)
 #define UNMARK_OBJ(c) LispBitVectorSet(gc_mark_bit, (uint32_t)OBJ_INDEX(c), 0)
+/* builtin c functions live in flash, see LISP_SET_FUNCTION */
+#define OUTSIDE_HEAP_P(c)    \
+  (LISP_IMMEDIATE(c) == 0 && \
+   ((Byte *)(c) < heap || (Byte *)(c) >= heap + HEAP_SIZE))
 
 LispIndex *LispNumberOfObjectsAllocated() {
   static LispIndex objects = 0;
   return &objects;
 }
 
+uint32_t *LispNumberOfCollections() {
+  static uint32_t collections = 0;
+  return &collections;
+}
+
 /* Data allocation */
 void *GcMalloc(LispIndex num_of_bytes) {
   void *ptr;
@@ -102,6 +111,25 @@ void *GcMalloc(LispIndex num_of_bytes) {
   ++*LispNumberOfObjectsAllocated(); /* better readability */
   return ptr;
 }
+/* Resizes the object allocated last in place, collecting first if it has to
+ * grow; *obj must be rooted, compaction keeps it last. False when it is not
+ * the last object or there is no room. */
+bool GcResizeLast(LispObject *obj, LispIndex old_bytes, LispIndex new_bytes) {
+  LispFixNum end =
+      ((LispFixNum)*obj + old_bytes + (ALIGN_BITS - 1)) & -ALIGN_BITS;
+  if (end != (LispFixNum)curr_heap) {
+    return false;
+  }
+  if ((LispFixNum)*obj + new_bytes > (LispFixNum)heap + HEAP_SIZE) {
+    GC();
+    if ((LispFixNum)*obj + new_bytes > (LispFixNum)heap + HEAP_SIZE) {
+      return false;
+    }
+  }
+  curr_heap =
+      (Byte *)(((LispFixNum)*obj + new_bytes + (ALIGN_BITS - 1)) & -ALIGN_BITS);
+  return true;
+}
 LispObject GcNextHeapObject(LispObject obj) {
   LispIndex l = 0;
   if (CONS_P(obj)) {
@@ -122,6 +150,9 @@ LispObject GcNextHeapObject(LispObject obj) {
     case kLongFloat:
       l = sizeof(struct LispLongFloat);
       break;
+    case kQ31:
+      l = sizeof(struct LispQ31);
+      break;
     case kSymbol:
       if (LISP_GenSymP(obj)) {
         l = sizeof(struct LispGenSym);
@@ -138,11 +169,32 @@ LispObject GcNextHeapObject(LispObject obj) {
           (sizeof(uint8_t) * (obj->bit_vector.size - 1));
       break;
     case kString:
-      l = sizeof(struct LispString) + (obj->string.size - 1) * sizeof(char);
+      l = (LispIndex)(sizeof(struct LispString) +
+                      (obj->string.size ? obj->string.size - 1 : 0));
+      break;
+    case kHashTable:
+      l = sizeof(struct LispHashTable);
+      break;
+    case kIsrQueue:
+      l = sizeof(struct LispIsrQueueHandle);
+      break;
+    case kSlice:
+      l = sizeof(struct LispSlice);
+      break;
+    case kQueue:
+      l = (LispIndex)(sizeof(struct LispQueue) +
+                      sizeof(LispObject) *
+                          (obj->queue.size ? obj->queue.size - 1 : 0));
+      break;
+    case kTypedArray:
+      l = (LispIndex)TYPED_ARRAY_BYTES(obj->typed_array.etype,
+                                       obj->typed_array.size);
       break;
     case kVector:
-      l = sizeof(struct LispVector) +
-          (LispIndex)(sizeof(LispObject) * (obj->vector.size - 1));
+    case kRecord:
+      l = (LispIndex)(sizeof(struct LispVector) +
+                      sizeof(LispObject) *
+                          (obj->vector.size ? obj->vector.size - 1 : 0));
       break;
     default:
       LispError("error: Unkown object located at the heap!\n");
@@ -157,14 +209,40 @@ LispObject GcNextHeapObject(LispObject obj) {
   return obj;
 }
 
+void GcForwardAbove(LispObject old, LispObject to) {
+  LispObject curr = old;
+  LispIndex i;
+  while ((uintptr_t)curr + 1 < (uintptr_t)curr_heap) {
+    if (CONS_P(curr)) {
+      if (LISP_CONS_CAR(curr) == old) {
+        LISP_CONS_CAR(curr) = to;
+      }
+      if (LISP_CONS_CDR(curr) == old) {
+        LISP_CONS_CDR(curr) = to;
+      }
+    } else if (LISP_VectorP(curr) || LISP_RecordP(curr)) {
+      for (i = 0; i < curr->vector.fillp; ++i) {
+        if (curr->vector.self[i] == old) {
+          curr->vector.self[i] = to;
+        }
+      }
+    }
+    curr = GcNextHeapObject(curr);
+  }
+}
+
 void GcMarkObject(LispObject o) {
   if (LISP_UNBOUNDP(o)) {
   } else if (LISP_NULL(o)) {
   } else if (o == LISP_T) {
+  } else if (OUTSIDE_HEAP_P(o)) {
+  } else if (LISP_IMMEDIATE(o) < kCharacter && MARKED_P(o)) {
+    /* shared or circular structure, e.g. label closures */
   } else {
     LispType t = LISP_TYPE_OF(o);
     switch (t) {
       case kCharacter:
+      case kQ15:
       case kFixNum: {
         break;
       }
@@ -179,13 +257,37 @@ void GcMarkObject(LispObject o) {
       case kSingleFloat:
       case kDoubleFloat:
       case kLongFloat:
+      case kQ31:
       case kCFunction:
       case kBitVector:
+      case kTypedArray:
+      case kIsrQueue:
       case kString: {
         MARK_OBJ(o);
         break;
       }
-      case kVector: {
+      case kSlice: {
+        MARK_OBJ(o);
+        GcMarkObject(o->slice.buffer);
+        break;
+      }
+      case kQueue: {
+        MARK_OBJ(o);
+        LispIndex i = 0;
+        for (i = 0; i < o->queue.size; ++i) {
+          GcMarkObject((o->queue.self[i]));
+        }
+        break;
+      }
+      case kHashTable: {
+        MARK_OBJ(o);
+        GcMarkObject(o->hash_table.entries);
+        GcMarkObject(o->hash_table.index);
+        GcMarkObject(o->hash_table.old_index);
+        break;
+      }
+      case kVector:
+      case kRecord: {
         MARK_OBJ(o);
         LispIndex i = 0;
         for (i = 0; i < o->vector.fillp; ++i) {
@@ -202,7 +304,7 @@ void GcMarkObject(LispObject o) {
           d = LISP_CONS_CDR(o);
           GcMarkObject(a);
           o = d;
-        } while (LISP_ConsP(o));
+        } while (LISP_ConsP(o) && !MARKED_P(o));
         GcMarkObject(o);
         break;
       }
@@ -227,17 +329,33 @@ void GcMarkLiveObjects() {
   rs = read_state;
   while (rs != NULL) {
     GcMarkObject(rs->exprs.items);
+    GcMarkObject(rs->exprs.index);
     GcMarkObject(rs->labels.items);
+    GcMarkObject(rs->labels.index);
     rs = rs->prev;
   }
   /* 4. print_conses */
   GcMarkObject(print_conses.items);
+  GcMarkObject(print_conses.index);
+  /* 5. compiled code constants */
+  GcMarkObject(compiled_constants);
+  /* 5b. form being typed at the terminal */
+  GcMarkObject(read_buffer);
 
-  /* 5. cons_flag */
+  /* 6. cons_flag */
   /* GcMarkObject(cons_flags); */
   /* GcMarkObject(gc_cons); */
   /* GcMarkObject(gc_offset); */
   /* GcMarkObject(gc_mark_bit); */
+
+  /* 7. case tables, last: they do not keep their forms alive */
+  for (i = 0; i < 2 * N_CASE_TABLES; i += 2) {
+    if (!LISP_UNBOUNDP(case_tables[i]) && MARKED_P(case_tables[i])) {
+      GcMarkObject(case_tables[i + 1]);
+    } else {
+      case_tables[i] = case_tables[i + 1] = LISP_UNBOUND;
+    }
+  }
 }
 
 LispObject LispAllocObject(LispType t, LispIndex extra_size) {
@@ -260,6 +378,9 @@ LispObject LispAllocObject(LispType t, LispIndex extra_size) {
     case kLongFloat:
       obj = (LispObject)GcMalloc(sizeof(struct LispLongFloat));
       break;
+    case kQ31:
+      obj = (LispObject)GcMalloc(sizeof(struct LispQ31));
+      break;
     case kSymbol:
       obj = (LispObject)GcMalloc(sizeof(struct LispSymbol) +
                                  extra_size * sizeof(char));
@@ -280,9 +401,27 @@ LispObject LispAllocObject(LispType t, LispIndex extra_size) {
       obj = (LispObject)GcMalloc(sizeof(struct LispGenSym));
       break;
     case kVector:
+    case kRecord:
       obj = (LispObject)GcMalloc((LispIndex)(sizeof(struct LispVector) +
                                              sizeof(LispObject) * extra_size));
       break;
+    case kHashTable:
+      obj = (LispObject)GcMalloc(sizeof(struct LispHashTable));
+      break;
+    case kIsrQueue:
+      obj = (LispObject)GcMalloc(sizeof(struct LispIsrQueueHandle));
+      break;
+    case kSlice:
+      obj = (LispObject)GcMalloc(sizeof(struct LispSlice));
+      break;
+    case kQueue:
+      obj = (LispObject)GcMalloc((LispIndex)(sizeof(struct LispQueue) +
+                                             sizeof(LispObject) * extra_size));
+      break;
+    case kTypedArray:
+      obj = (LispObject)GcMalloc(
+          (LispIndex)(sizeof(struct LispTypedArray) + extra_size));
+      break;
     default:
       LispError("error: wrong object type, alloc botch.\n");
   }
@@ -316,6 +455,7 @@ LispObject GcForwardChildObject(LispObject o) {
   if (LISP_UNBOUNDP(o)) {
   } else if (LISP_NULL(o)) {
   } else if (o == LISP_T) {
+  } else if (OUTSIDE_HEAP_P(o)) {
   } else if ((((LispFixNum)o & 3) < 2) && !MARKED_P(o)) {
     /* avoid checking char and fixnum */
     o_new = gc_offset->vector.self[OBJ_INDEX(o)];
@@ -323,6 +463,7 @@ LispObject GcForwardChildObject(LispObject o) {
     LispType t = LISP_TYPE_OF(o);
     switch (t) {
       case kCharacter:
+      case kQ15:
       case kFixNum: {
         break;
       }
@@ -330,9 +471,16 @@ LispObject GcForwardChildObject(LispObject o) {
       case kSingleFloat:
       case kDoubleFloat:
       case kLongFloat:
+      case kQ31:
       case kCFunction:
       case kBitVector:
+      case kTypedArray:
+      case kHashTable:
       case kVector:
+      case kRecord:
+      case kQueue:
+      case kIsrQueue:
+      case kSlice:
       case kString: {
         o_new = (LispObject)((LispFixNum)o -
                              LISP_FIXNUM(gc_offset->vector.self[OBJ_INDEX(o)]));
@@ -364,6 +512,7 @@ LispObject GcForwardObject(LispObject o) {
     LispType t = LISP_TYPE_OF(o);
     switch (t) {
       case kCharacter:
+      case kQ15:
       case kFixNum: {
         break;
       }
@@ -378,15 +527,29 @@ LispObject GcForwardObject(LispObject o) {
       case kSingleFloat:
       case kDoubleFloat:
       case kLongFloat:
+      case kQ31:
       case kCFunction:
       case kBitVector:
+      case kTypedArray:
+      case kIsrQueue:
       case kString: {
         o_new =
             (LispObject)((LispFixNum)o_new -
                          LISP_FIXNUM(gc_offset->vector.self[OBJ_INDEX(o_new)]));
         break;
       }
-      case kVector: {
+      case kHashTable: {
+        o->hash_table.entries = GcForwardChildObject(o->hash_table.entries);
+        o->hash_table.index = GcForwardChildObject(o->hash_table.index);
+        o->hash_table.old_index =
+            GcForwardChildObject(o->hash_table.old_index);
+        o_new =
+            (LispObject)((LispFixNum)o_new -
+                         LISP_FIXNUM(gc_offset->vector.self[OBJ_INDEX(o_new)]));
+        break;
+      }
+      case kVector:
+      case kRecord: {
         LispIndex i = 0;
         for (i = 0; i < o->vector.fillp; ++i) {
           o->vector.self[i] = GcForwardChildObject(o->vector.self[i]);
@@ -396,6 +559,23 @@ LispObject GcForwardObject(LispObject o) {
                          LISP_FIXNUM(gc_offset->vector.self[OBJ_INDEX(o_new)]));
         break;
       }
+      case kSlice: {
+        o->slice.buffer = GcForwardChildObject(o->slice.buffer);
+        o_new =
+            (LispObject)((LispFixNum)o_new -
+                         LISP_FIXNUM(gc_offset->vector.self[OBJ_INDEX(o_new)]));
+        break;
+      }
+      case kQueue: {
+        LispIndex i = 0;
+        for (i = 0; i < o->queue.size; ++i) {
+          o->queue.self[i] = GcForwardChildObject(o->queue.self[i]);
+        }
+        o_new =
+            (LispObject)((LispFixNum)o_new -
+                         LISP_FIXNUM(gc_offset->vector.self[OBJ_INDEX(o_new)]));
+        break;
+      }
       case kList: {
         LISP_CONS_CAR(o) = GcForwardChildObject(LISP_CONS_CAR(o));
         LISP_CONS_CDR(o) = GcForwardChildObject(LISP_CONS_CDR(o));
@@ -448,17 +628,29 @@ void GcUpdateObjectsRelocate() {
   rs = read_state;
   while (rs != NULL) {
     rs->exprs.items = GcForwardChildObject(rs->exprs.items);
+    rs->exprs.index = GcForwardChildObject(rs->exprs.index);
     rs->labels.items = GcForwardChildObject(rs->labels.items);
+    rs->labels.index = GcForwardChildObject(rs->labels.index);
     rs = rs->prev;
   }
   /* 4. print_conses */
   print_conses.items = GcForwardChildObject(print_conses.items);
+  print_conses.index = GcForwardChildObject(print_conses.index);
+  /* 5. compiled code constants */
+  compiled_constants = GcForwardChildObject(compiled_constants);
+  /* 5b. form being typed at the terminal */
+  read_buffer = GcForwardChildObject(read_buffer);
 
-  /* 5. cons_flag */
+  /* 6. cons_flag */
   /* cons_flags = GcForwardChildObject(cons_flags); */
   /* gc_cons = GcForwardChildObject(gc_cons); */
   /* gc_offset = GcForwardChildObject(gc_offset); */
   /* gc_mark_bit = GcForwardChildObject(gc_mark_bit); */
+
+  /* 7. case tables */
+  for (i = 0; i < 2 * N_CASE_TABLES; i++) {
+    case_tables[i] = GcForwardChildObject(case_tables[i]);
+  }
 }
 
 void GcCompact() {
@@ -467,13 +659,16 @@ void GcCompact() {
 }
 
 void GC() {
+  LispPort *port = print_port; /* the report is for the terminal */
   memset(gc_mark_bit->bit_vector.self, 0, gc_mark_bit->bit_vector.size);
   memset(gc_offset->vector.self, 0,
          sizeof(LispObject) * gc_offset->vector.fillp);
   GcMarkLiveObjects();
   GcCompact();
   curr_heap = heap_free;
+  ++*LispNumberOfCollections(); /* address keyed tables are stale now */
 
+  print_port = &lisp_uart_port;
   LispPrintStr("gc: found ");
   LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
                         *LispNumberOfObjectsAllocated(), 10));
@@ -484,6 +679,7 @@ void GC() {
   LispPrintStr("/");
   LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE, HEAP_SIZE, 10));
   LispPrintStr(" bytes.\n");
+  print_port = port;
 
   /* All data was live */
   if ((LispFixNum)curr_heap >= (LispFixNum)heap + HEAP_SIZE) {
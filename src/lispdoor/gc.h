@@ -65,7 +65,12 @@
 /* Data allocation */
 void GC();
 void *GcMalloc(LispIndex num_of_bytes);
+bool GcResizeLast(LispObject *obj, LispIndex old_bytes, LispIndex new_bytes);
 LispObject LispAllocObject(LispType t, LispIndex extra_size);
+/* replaces old by to in the conses, vectors and records allocated after old,
+ * where whatever was built since old took its references to it */
+void GcForwardAbove(LispObject old, LispObject to);
 LispIndex *LispNumberOfObjectsAllocated();
+uint32_t *LispNumberOfCollections();
 
 #endif /* LISPDOOR_GC_H_INCLUDED */
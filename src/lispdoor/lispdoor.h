@@ -65,6 +65,7 @@
 #include "lispdoor/gc.h"
 #include "lispdoor/memorylayout.h"
 #include "lispdoor/objects.h"
+#include "lispdoor/optimize.h"
 #include "lispdoor/print.h"
 #include "lispdoor/read.h"
 #include "lispdoor/symboltree.h"
@@ -93,19 +93,28 @@ LispIndex stack_index = 0;
 /* 3. Terminal input buffer FIFO cycle */
 Byte terminal_buffer[TIB_SIZE];
 Byte terminal_buffer_get_index;
-Byte terminal_buffer_insert_index;
+volatile Byte terminal_buffer_insert_index;
 /* 4. scratch pad buffer */
 Byte scratch_pad[SCRATCH_PAD_SIZE];
 /* 5. number base to print */
 Byte lisp_number_base = 10;
-/* 6. fractional part precision to print */
-Byte lisp_fractional_precision = 10;
-/* 7. used for self circular cons*/
+/* 6. used for self circular cons*/
 LispObject cons_flags = (LispObject)&cons_flags_bit_vector;
 LabelTable print_conses;
-/* 8. used for reading labels */
+/* 7. used for reading labels */
 ReadState *read_state = NULL;
-/* 9. mark-compacting gc */
+/* 8. mark-compacting gc */
 LispObject gc_mark_bit = (LispObject)&gc_mark_bit_vector;
 LispObject gc_offset = (LispObject)&gc_offset_vector;
 LispObject gc_cons = (LispObject)&gc_cons_bit_vector;
+/* 9. constants referenced by compiled code (tools/lisp2c) */
+LispObject compiled_constants = LISP_NIL;
+/* 10. Terminal output buffer FIFO cycle, drained by the uart tx */
+Byte terminal_out_buffer[TOB_SIZE];
+Byte terminal_out_insert_index;
+volatile Byte terminal_out_get_index;
+uint32_t terminal_out_stalls;
+/* 11. text of the form being typed, see LispReaderPoll */
+LispObject read_buffer = LISP_NIL;
+/* 12. dispatch tables of case forms */
+LispObject case_tables[2 * N_CASE_TABLES];
@@ -71,10 +71,42 @@
 #define ALIGN_TYPE max_align_t
 #define ALIGN_BITS (LispFixNum)alignof(ALIGN_TYPE)
 #define N_STACK 512U
+#define N_CASE_TABLES 8U /* case forms dispatching by binary search */
+/* The firmware heap is 7936 bytes. At boot, on the 32 bit target, every
+ * builtin costs its symbol, 12 bytes plus the name rounded up to 8, and a
+ * slot of the symbol table; the descriptors stay in flash. The 73 core
+ * builtins take about 1650 bytes and all the groups below about 1270 more,
+ * so with the table some 3.4 KB is gone before the first form is read,
+ * 2.1 KB with every group switched off. */
+#ifndef HEAP_SIZE /* the host tools set their own */
 #define HEAP_SIZE (LispIndex)(8 * 1024 - 256) /* bytes */
+#endif
+/* builtin groups, 1 to link them in; boot heap cost in brackets */
+#ifndef LISP_WITH_TYPED_ARRAYS
+#define LISP_WITH_TYPED_ARRAYS 1 /* make-array and its kernels (168) */
+#endif
+#ifndef LISP_WITH_FIXED_POINT
+#define LISP_WITH_FIXED_POINT 1 /* q15 q31 arithmetic (152) */
+#endif
+#ifndef LISP_WITH_BIT_VECTORS
+#define LISP_WITH_BIT_VECTORS 1 /* make-bit-vector and bit ops (224) */
+#endif
+#ifndef LISP_WITH_HASH_TABLES
+#define LISP_WITH_HASH_TABLES 1 /* make-hash-table, gethash... (184) */
+#endif
+#ifndef LISP_WITH_RECORDS
+#define LISP_WITH_RECORDS 1 /* defstruct and record-ref... (120) */
+#endif
+#ifndef LISP_WITH_QUEUES
+#define LISP_WITH_QUEUES 1 /* make-queue, enqueue, dequeue... (160) */
+#endif
+#ifndef LISP_WITH_BYTE_BUFFERS
+#define LISP_WITH_BYTE_BUFFERS 1 /* slice and u8/u16/u32 access (264) */
+#endif
 /* #define HEAP_SIZE (LispIndex)(8 * 1024 - 396) /\* bytes *\/ */
 #define TIB_SIZE \
-  256U /* Should be divisable by 2 (see HAL_UART_RxCpltCallback)*/
+  256U /* Power of 2, indices are masked; also the uart rx dma length */
+#define TOB_SIZE 128U /* Power of 2, terminal output ring */
 #define SCRATCH_PAD_SIZE 128U
 #define HEAP_MAX_SIZE (LispIndex)(HEAP_SIZE / sizeof(LispSmallestStruct))
 
@@ -100,21 +132,31 @@ extern LispIndex stack_index;
 /* 3. Terminal input buffer FIFO cycle */
 extern Byte terminal_buffer[TIB_SIZE];
 extern Byte terminal_buffer_get_index;
-extern Byte terminal_buffer_insert_index;
+extern volatile Byte terminal_buffer_insert_index; /* written by the isr */
 /* 4. scratch pad buffer */
 extern Byte scratch_pad[SCRATCH_PAD_SIZE];
 /* 5. number base to print */
 extern Byte lisp_number_base;
-/* 6. fractional part precision to print */
-extern Byte lisp_fractional_precision;
-/* 7. used for self circular cons*/
+/* 6. used for self circular cons*/
 extern LispObject cons_flags;
 extern LabelTable print_conses;
-/* 8. used for reading labels */
+/* 7. used for reading labels */
 extern ReadState *read_state;
-/* 9. mark-compacting gc */
+/* 8. mark-compacting gc */
 extern LispObject gc_mark_bit;
 extern LispObject gc_offset;
 extern LispObject gc_cons;
+/* 9. constants referenced by compiled code (tools/lisp2c) */
+extern LispObject compiled_constants;
+/* 10. Terminal output buffer FIFO cycle, drained by the uart tx */
+extern Byte terminal_out_buffer[TOB_SIZE];
+extern Byte terminal_out_insert_index;
+extern volatile Byte terminal_out_get_index; /* written by the isr */
+extern uint32_t terminal_out_stalls; /* bytes that found the ring full */
+/* 11. text of the form being typed, see LispReaderPoll */
+extern LispObject read_buffer;
+/* 12. dispatch tables of case forms, pairs of the form's (key clauses ...)
+   cell and its table, unbound when free; an entry goes with its form */
+extern LispObject case_tables[2 * N_CASE_TABLES];
 
 #endif /* LISPDOOR_MEMORYLAYOUT_H_INCLUDED */
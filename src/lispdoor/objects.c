@@ -87,9 +87,15 @@ SAFECAST_OP(CFunction, struct LispCFunction *, IDENTITY)
 SAFECAST_OP(Vector, struct LispVector *, IDENTITY)
 SAFECAST_OP(String, struct LispString *, IDENTITY)
 SAFECAST_OP(BitVector, struct LispBitVector *, IDENTITY)
+SAFECAST_OP(TypedArray, struct LispTypedArray *, IDENTITY)
+SAFECAST_OP(HashTable, struct LispHashTable *, IDENTITY)
+SAFECAST_OP(Queue, struct LispQueue *, IDENTITY)
+SAFECAST_OP(IsrQueue, struct LispIsrQueueHandle *, IDENTITY)
+SAFECAST_OP(Slice, struct LispSlice *, IDENTITY)
 SAFECAST_OP(SingleFloat, struct LispSingleFloat *, IDENTITY)
 SAFECAST_OP(DoubleFloat, struct LispDoubleFloat *, IDENTITY)
 SAFECAST_OP(LongFloat, struct LispLongFloat *, IDENTITY)
+SAFECAST_OP(Q31, int32_t, LISP_Q31)
 SAFECAST_OP(GenSym, struct LispGenSym *, IDENTITY)
 
 /* numbers */
@@ -102,42 +108,89 @@ SAFECAST_OP(GenSym, struct LispGenSym *, IDENTITY)
 MAKE_FUNC(SingleFloat, single_float, float)
 MAKE_FUNC(DoubleFloat, double_float, double)
 MAKE_FUNC(LongFloat, long_float, long double)
+MAKE_FUNC(Q31, q31, int32_t)
 
 /* c function */
-LispObject LispMakeCFunction(char *name, LispFunc fun) {
+static LispObject LispMakeCFunctionHeader(char *name, uint8_t f_type,
+                                          uint8_t min_args, uint8_t max_args,
+                                          uint8_t flags) {
   LispObject obj = LispAllocObject(kCFunction, 0);
-  obj->cfun.f = fun;
   obj->cfun.name = name;
-  obj->cfun.f_type = kFunctionOrdinary;
+  obj->cfun.f_type = f_type;
+  obj->cfun.flags = flags;
+  obj->cfun.min_args = min_args;
+  obj->cfun.max_args = max_args;
+  return obj;
+}
+LispObject LispMakeCFunction(char *name, LispFunc fun, uint8_t min_args,
+                             uint8_t max_args, uint8_t flags) {
+  LispObject obj = LispMakeCFunctionHeader(name, kFunctionOrdinary, min_args,
+                                           max_args, flags);
+  obj->cfun.f = fun;
+  return obj;
+}
+LispObject LispMakeCFunction1(char *name, LispFunc1 fun, uint8_t flags) {
+  LispObject obj = LispMakeCFunctionHeader(name, kFunctionUnary, 1, 1, flags);
+  obj->cfun.f1 = fun;
+  return obj;
+}
+LispObject LispMakeCFunction2(char *name, LispFunc2 fun, uint8_t flags) {
+  LispObject obj = LispMakeCFunctionHeader(name, kFunctionBinary, 2, 2, flags);
+  obj->cfun.f2 = fun;
   return obj;
 }
 LispObject LispMakeCFunctionSpecial(char *name, LispFunc fun) {
-  LispObject obj = LispAllocObject(kCFunction, 0);
+  /* specials get their unevaluated argument list as a single argument */
+  LispObject obj = LispMakeCFunctionHeader(name, kFunctionOrdinary, 1, 1,
+                                           kFunctionSpecial);
   obj->cfun.f = fun;
-  obj->cfun.name = name;
-  obj->cfun.f_type = kFunctionSpecial;
   return obj;
 }
 
 /* string */
+LispObject LispAllocString(LispIndex n) {
+  LispObject obj = LispAllocObject(kString, n ? (LispIndex)(n - 1) : 0);
+  obj->string.size = n;
+  return obj;
+}
+#define STRING_BYTES(n) \
+  ((LispIndex)(sizeof(struct LispString) + ((n) ? (n) - 1 : 0)))
+LispObject LispStringResize(LispObject s, LispIndex n) {
+  LispObject r;
+  PUSH(s);
+  if (GcResizeLast(&stack[stack_index - 1], STRING_BYTES(s->string.size),
+                   STRING_BYTES(n))) {
+    /* the usual case, s is being built at the top of the heap */
+    s = POP();
+    s->string.size = n;
+    return s;
+  }
+  r = LispAllocString(n);
+  s = POP();
+  memcpy(r->string.self, s->string.self,
+         (n < s->string.size) ? n : s->string.size);
+  return r;
+}
 LispObject LispMakeString(char *str) {
   LispIndex n = (LispIndex)strlen(str);
-  LispObject obj;
-  obj = LispAllocObject(kString, (LispIndex)n - 1);
-  obj->string.size = n;
-  strncpy(obj->string.self, str, n);
+  LispObject obj = LispAllocString(n);
+  memcpy(obj->string.self, str, n);
   return obj;
 }
 
 /* bit-vector */
-#define BIT_VECTOR_SIZE(n) ((LispIndex)((n + 7) >> 3));
+#define BIT_VECTOR_SIZE(n) ((LispIndex)((n) ? ((uint32_t)(n) + 7) >> 3 : 1))
+#define BIT_VECTOR_PAD(n, sz) ((uint8_t)((uint32_t)(sz)*8u - (n)))
 LispObject LispBitVectorResize(LispObject bv, LispIndex n) {
   LispObject bv_new;
   LispIndex i = 0, sz = BIT_VECTOR_SIZE(n);
   if (sz > ToBitVector(bv, "bit-vector-resize")->size) {
+    PUSH(bv);
     bv_new = LispAllocObject(kBitVector, sz - 1);
+    bv = POP();
     bv_new->bit_vector.size = sz;
-    for (; i < bv->vector.size; ++i) {
+    bv_new->bit_vector.pad = BIT_VECTOR_PAD(n, sz);
+    for (; i < bv->bit_vector.size; ++i) {
       bv_new->bit_vector.self[i] = bv->bit_vector.self[i];
     }
     for (; i < sz; ++i) {
@@ -154,9 +207,12 @@ LispObject LispMakeInitializedBitVector(LispIndex n, uint8_t val) {
   LispIndex i;
   bv = LispAllocObject(kBitVector, sz - 1);
   bv->bit_vector.size = sz;
+  bv->bit_vector.pad = BIT_VECTOR_PAD(n, sz);
   for (i = 0; i < sz; ++i) {
     bv->bit_vector.self[i] = val;
   }
+  /* the bits past n stay clear, the word kernels count on it */
+  bv->bit_vector.self[sz - 1] &= (uint8_t)(0xFFu >> bv->bit_vector.pad);
   return bv;
 }
 
@@ -165,6 +221,8 @@ LispObject LispMakeBitVector(LispIndex n) {
   LispIndex sz = BIT_VECTOR_SIZE(n);
   bv = LispAllocObject(kBitVector, sz - 1);
   bv->bit_vector.size = sz;
+  bv->bit_vector.pad = BIT_VECTOR_PAD(n, sz);
+  memset(bv->bit_vector.self, 0, sz);
   return bv;
 }
 LispObject LispMakeBitVectorExactSize(LispIndex n) {
@@ -172,6 +230,7 @@ LispObject LispMakeBitVectorExactSize(LispIndex n) {
   LispIndex sz = n;
   bv = LispAllocObject(kBitVector, sz - 1);
   bv->bit_vector.size = sz;
+  bv->bit_vector.pad = 0;
   return bv;
 }
 
@@ -189,20 +248,54 @@ uint8_t LispBitVectorGet(LispObject o, uint32_t n) {
   return b[n >> 3] & (uint8_t)(1 << (n & 7));
 }
 /* vector */
+#define VECTOR_BYTES(n)                 \
+  ((LispIndex)(sizeof(struct LispVector) + \
+               sizeof(LispObject) * ((n) ? (n) - 1 : 0)))
 LispObject LispMakeVector(LispIndex size) {
   LispObject vec;
-  vec = LispAllocObject(kVector, (LispIndex)size - 1);
+  vec = LispAllocObject(kVector, size ? (LispIndex)(size - 1) : 0);
   vec->vector.size = size;
   vec->vector.fillp = 0;
   return vec;
 }
+LispObject LispMakeRecord(LispObject desc) {
+  LispObject r;
+  LispIndex i, size = desc->vector.fillp;
+  PUSH(desc);
+  r = LispAllocObject(kRecord, (LispIndex)(size - 1));
+  r->vector.size = r->vector.fillp = size;
+  r->vector.self[0] = POP();
+  for (i = 1; i < size; ++i) {
+    r->vector.self[i] = LISP_NIL;
+  }
+  return r;
+}
+/* the size a vector of size grows to when it must hold alloc_size */
+static LispIndex VectorGrowth(LispIndex size, LispIndex alloc_size) {
+  return (alloc_size > size * 2u) ? alloc_size
+                                  : (LispIndex)((alloc_size * 3u) >> 1u);
+}
+bool LispVectorGrowInPlace(LispObject *v, LispIndex alloc_size) {
+  LispIndex new_size = VectorGrowth((*v)->vector.size, alloc_size);
+  if (!GcResizeLast(v, VECTOR_BYTES((*v)->vector.size),
+                    VECTOR_BYTES(new_size))) {
+    return false;
+  }
+  (*v)->vector.size = new_size;
+  return true;
+}
 LispObject LispVectorResize(LispObject v, LispIndex alloc_size) {
   LispObject vec;
   if (alloc_size > ToVector(v, "vector-resize")->size) {
-    LispIndex new_size = (alloc_size > v->vector.size * 2u)
-                             ? alloc_size
-                             : (LispIndex)((alloc_size * 3u) >> 1u);
+    LispIndex new_size;
+    PUSH(v); /* allocation may move v */
+    if (LispVectorGrowInPlace(&stack[stack_index - 1], alloc_size)) {
+      /* at the top of the heap it grows in place and keeps its identity */
+      return POP();
+    }
+    new_size = VectorGrowth(stack[stack_index - 1]->vector.size, alloc_size);
     vec = LispAllocObject(kVector, new_size - 1);
+    v = POP();
     vec->vector.size = new_size;
     vec->vector.fillp = v->vector.fillp;
     memcpy(vec->vector.self, v->vector.self,
@@ -214,22 +307,96 @@ LispObject LispVectorResize(LispObject v, LispIndex alloc_size) {
 }
 LispObject LispVectorPush(LispObject v, LispObject value) {
   LispObject vec;
+  PUSH(value);
   vec = LispVectorResize(v, (LispIndex)ToVector(v, "vector-push")->fillp + 1);
-  vec->vector.self[vec->vector.fillp++] = value;
+  vec->vector.self[vec->vector.fillp++] = POP();
   return vec;
 }
 LispObject LispVectorPop(LispObject v) {
-  static LispObject vec;
-  if (ToVector(v, "vector-pop")->fillp > 0) {
-    vec = v->vector.self[v->vector.fillp--];
-  } else {
-    LispError("pop empty vector.");
+  if (ToVector(v, "vector-pop")->fillp == 0) {
+    LispError("vector-pop: error: empty vector\n");
   }
-  return vec;
+  return v->vector.self[--v->vector.fillp];
 }
+/* typed array */
+const uint8_t lisp_element_shift[LISP_ELEMENT_TYPES] = {0, 1, 1, 2, 2};
+const char *const lisp_element_names[LISP_ELEMENT_TYPES] = {"u8", "i16", "u16",
+                                                            "i32", "f32"};
+LispObject LispMakeTypedArray(uint8_t etype, LispIndex n) {
+  uint32_t bytes = TYPED_ARRAY_BYTES(etype, n);
+  LispObject a;
+  if (bytes > (LispIndex)-1) {
+    LispError("make-array: error: array too large\n");
+  }
+  a = LispAllocObject(kTypedArray,
+                      (LispIndex)(bytes - sizeof(struct LispTypedArray)));
+  a->typed_array.etype = etype;
+  a->typed_array.size = n;
+  memset(&a->typed_array.self, 0,
+         bytes - offsetof(struct LispTypedArray, self));
+  return a;
+}
+
+/* hash table */
+const char *const lisp_hash_test_names[LISP_HASH_TESTS] = {"eq", "eql",
+                                                           "equal"};
+LispObject LispMakeHashTable(uint8_t test, LispIndex n) {
+  LispObject t = LispAllocObject(kHashTable, 0);
+  uint32_t slots = 8;
+  t->hash_table.test = test;
+  t->hash_table.moving = false;
+  t->hash_table.count = 0;
+  t->hash_table.migrated = t->hash_table.migrate_end = 0;
+  t->hash_table.gc_epoch = *LispNumberOfCollections();
+  t->hash_table.entries = t->hash_table.index = LISP_NIL;
+  t->hash_table.old_index = LISP_NIL;
+  PUSH(t);
+  stack[stack_index - 1]->hash_table.entries =
+      LispMakeVector((LispIndex)(2 * (n ? n : 1)));
+  while (slots < 2u * n) {
+    slots <<= 1;
+  }
+  if (slots * sizeof(LispIndex) > (LispIndex)-1) {
+    LispError("make-hash-table: error: too large\n");
+  }
+  t = LispAllocString((LispIndex)(slots * sizeof(LispIndex)));
+  memset(t->string.self, 0, t->string.size);
+  stack[stack_index - 1]->hash_table.index = t;
+  return POP();
+}
+
+/* queues */
+LispObject LispMakeQueue(LispIndex n, bool overwrite) {
+  LispIndex i;
+  LispObject q = LispAllocObject(kQueue, (LispIndex)(n ? n - 1 : 0));
+  q->queue.overwrite = overwrite;
+  q->queue.size = n;
+  q->queue.head = q->queue.count = 0;
+  for (i = 0; i < n; ++i) {
+    q->queue.self[i] = LISP_NIL;
+  }
+  return q;
+}
+LispObject LispMakeIsrQueue(LispIsrQueue *q) {
+  LispObject h = LispAllocObject(kIsrQueue, 0);
+  h->isr_queue.queue = q;
+  return h;
+}
+
+/* slices */
+LispObject LispMakeSlice(LispObject buffer, LispIndex offset, LispIndex n) {
+  LispObject s;
+  PUSH(buffer);
+  s = LispAllocObject(kSlice, 0);
+  s->slice.offset = offset;
+  s->slice.size = n;
+  s->slice.buffer = POP();
+  return s;
+}
+
 /* gen-symbol */
 LispObject LdMakeGenSym(LispIndex nargs) {
-  ArgCount("gensym", nargs, 0);
+  (void)nargs;
   LispObject gs = (LispObject)LispAllocObject(kGenSym, 0);
   gs->gen_sym.stype = kSymGenSym;
   gs->gen_sym.id = gen_sym_ctr++;
@@ -65,6 +65,7 @@
 #include <ctype.h>
 #include <setjmp.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -81,6 +82,8 @@ typedef uint8_t Byte;
 typedef char LispBaseChar;
 typedef LispIndex LispNArg;
 typedef LispObject (*LispFunc)(LispNArg narg);
+typedef LispObject (*LispFunc1)(LispObject a);
+typedef LispObject (*LispFunc2)(LispObject a, LispObject b);
 
 /*
         Object NULL value.
@@ -102,6 +105,9 @@ struct _LispEnv {
   /* Cons Frame to store lexical scope */
   LispObject frame;
 
+  /* closures being applied, definitions are optimised only at depth 0 */
+  LispIndex closure_depth;
+
   /* toplevel jmp for errors*/
   jmp_buf top_level;
 
@@ -139,13 +145,21 @@ typedef enum {
   kSingleFloat,
   kDoubleFloat,
   kLongFloat,
-  kLastNumber = kLongFloat,
+  kQ15, /* immediate Q15 fixed point, under the character tag */
+  kQ31, /* Q31 fixed point */
+  kLastNumber = kQ31,
   kSymbol,
   kBitVector,
   kString,
   kCFunction, /* internal */
   kGenSym,    /* internal only, no valid lisp object should have this type */
   kVector,
+  kTypedArray,
+  kHashTable,
+  kRecord, /* laid out as a vector, slot 0 the descriptor #(name slot ...) */
+  kQueue,
+  kIsrQueue, /* handle of a LispIsrQueue outside the heap */
+  kSlice,    /* window on the bytes of a u8 array or a string */
 } LispType;
 
 /*
@@ -162,7 +176,10 @@ typedef enum {
 /* Immediate fixnums:           */
 #define LISP_FIXNUM_TAG kFixNum
 #define LISP_FixNumP(o) (LISP_IMMEDIATE(o) == kFixNum)
-#define LISP_MAKE_FIXNUM(n) ((LispObject)(((LispFixNum)(n) << 2) | kFixNum))
+#define LISP_MAKE_FIXNUM(n) \
+  ((LispObject)(((uintptr_t)(LispFixNum)(n) << 2) | kFixNum))
+#define LISP_FIXNUM_MAX ((LispFixNum)(~(uintptr_t)0 >> 3))
+#define LISP_FIXNUM_MIN (-LISP_FIXNUM_MAX - 1)
 #define LISP_FIXNUM_LOWER(a, b) ((LispFixNum)(a) < (LispFixNum)(b))
 #define LISP_FIXNUM_GREATER(a, b) ((LispFixNum)(a) > (LispFixNum)(b))
 #define LISP_FIXNUM_LEQ(a, b) ((LispFixNum)(a) <= (LispFixNum)(b))
@@ -171,12 +188,20 @@ typedef enum {
 #define LISP_FIXNUM_MINUSP(a) ((LispFixNum)(a) < (LispFixNum)(0))
 #define LISP_FIXNUM(a) (((LispFixNum)(a)) >> 2)
 
-/* Immediate characters:        */
+/* Immediate characters, bit 2 clear:        */
 #define LISP_CHARACTER_TAG kCharacter
-#define LISP_CharacterP(o) (LISP_IMMEDIATE(o) == kCharacter)
+#define LISP_CharacterP(o) (((LispFixNum)(o)&7) == LISP_CHARACTER_TAG)
 #define LISP_MAKE_CHARACTER(c) \
-  ((LispObject)(((LispFixNum)(c << 2) | LISP_CHARACTER_TAG)))
-#define LISP_CHAR_CODE(obje) (((LispFixNum)(obje)) >> 2)
+  ((LispObject)((((LispFixNum)(c)) << 3) | LISP_CHARACTER_TAG))
+#define LISP_CHAR_CODE(obje) (((LispFixNum)(obje)) >> 3)
+
+/* Immediate Q15 fixed point, character tag with bit 2 set: the int16_t q
+ * stands for q / 2^15 */
+#define LISP_Q15_TAG (4 | kCharacter)
+#define LISP_Q15P(o) (((LispFixNum)(o)&7) == LISP_Q15_TAG)
+#define LISP_MAKE_Q15(q) \
+  ((LispObject)((((LispFixNum)(int16_t)(q)) << 3) | LISP_Q15_TAG))
+#define LISP_Q15(o) ((int16_t)(((LispFixNum)(o)) >> 3))
 
 #define LISP_NumberP(x) \
   (LISP_TYPE_OF(x) >= kFixNum && LISP_TYPE_OF(x) <= kLastNumber)
@@ -184,6 +209,14 @@ typedef enum {
 #define LISP_BitVectorP(x) \
   ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kBitVector))
 #define LISP_StringP(x) ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kString))
+#define LISP_HashTableP(x) \
+  ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kHashTable))
+#define LISP_RecordP(x) ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kRecord))
+#define LISP_QueueP(x) ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kQueue))
+#define LISP_IsrQueueP(x) ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kIsrQueue))
+#define LISP_SliceP(x) ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kSlice))
+#define LISP_TypedArrayP(x) \
+  ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kTypedArray))
 #define LISP_ExtendedStringP(x) 0
 /* TODO: big_nums*/
 /* #define LISP_BigNumP(x) ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kbignum))
@@ -197,6 +230,8 @@ typedef enum {
 #define LISP_SINGLE_FLOAT(o) ((o)->single_float.value)
 #define LISP_DOUBLE_FLOAT(o) ((o)->double_float.value)
 #define LISP_LONG_FLOAT(o) ((o)->long_float.value)
+#define LISP_Q31P(x) ((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kQ31))
+#define LISP_Q31(o) ((o)->q31.value)
 
 #define LISP_ListP(x) (LISP_IMMEDIATE(x) == kList)
 #define LISP_ConsP(x) (LISP_ListP(x) && !LISP_NULL(x))
@@ -207,9 +242,11 @@ typedef enum {
 #define LISP_GenSymP(x) (((LISP_IMMEDIATE(x) == 0) && ((x)->d.t == kGenSym)))
 #define LISP_SYMBOL_GENSYMP(sym) (sym->symbol.stype == kSymGenSym)
 #define LISP_SYMBOL_CONSTANTP(sym) (sym->symbol.stype == kSymConstant)
+#define LISP_SYMBOL_INLINEP(sym) (sym->symbol.stype == kSymInline)
 
 #define LISP_CFunctionP(x) ((LISP_IMMEDIATE(x) == 0) && (x)->d.t == kCFunction)
-#define LISP_CFUNCTION_SPECIALP(x) ((x)->cfun.f_type == kFunctionSpecial)
+#define LISP_CFUNCTION_SPECIALP(x) ((x)->cfun.flags & kFunctionSpecial)
+#define LISP_CFUNCTION_PUREP(x) ((x)->cfun.flags & kFunctionPure)
 
 #define LISP_PTR_CONS(x) (LispObject)((intptr_t)(x) | kList)
 #define LISP_CONS_PTR(x) ((struct LispCons *)((intptr_t)(x)-kList))
@@ -222,31 +259,58 @@ typedef enum {
 #define LISP_RPLACA(x, v) (LISP_CONS_CAR(x) = (v))
 #define LISP_RPLACD(x, v) (LISP_CONS_CDR(x) = (v))
 
-#define LISP_SET_FUNCTION(f_name, f) \
-  o = LispMakeSymbol(f_name);        \
-  o->symbol.value = LispMakeCFunction(f_name, f)
-#define LISP_SET_CONSTANT_FUNCTION(f_name, f) \
-  o = LispMakeSymbol(f_name);                 \
-  o->symbol.stype = kSymConstant;             \
-  o->symbol.value = LispMakeCFunction(f_name, f)
+/* builtins keep their descriptor in const memory, flash on the target, so
+ * only the symbol takes heap; the gc skips objects outside the heap */
+#define LISP_SET_STATIC_CFUNCTION(f_name, ...)                        \
+  static const struct LispCFunction cfun_ = {kCFunction, __VA_ARGS__, \
+                                             f_name};                 \
+  o = LispMakeSymbol(f_name);                                         \
+  o->symbol.value = (LispObject)(uintptr_t)&cfun_
+#define LISP_SET_FUNCTION(f_name, f, min, max, flags)                     \
+  do {                                                                    \
+    LISP_SET_STATIC_CFUNCTION(f_name, kFunctionOrdinary, flags, min, max, \
+                              {f});                                       \
+  } while (0)
+#define LISP_SET_FUNCTION1(f_name, f, flags)                       \
+  do {                                                             \
+    LISP_SET_STATIC_CFUNCTION(f_name, kFunctionUnary, flags, 1, 1, \
+                              {.f1 = f});                          \
+  } while (0)
+#define LISP_SET_FUNCTION2(f_name, f, flags)                        \
+  do {                                                              \
+    LISP_SET_STATIC_CFUNCTION(f_name, kFunctionBinary, flags, 2, 2, \
+                              {.f2 = f});                           \
+  } while (0)
+#define LISP_SET_CONSTANT_FUNCTION(f_name, f, min, max, flags)            \
+  do {                                                                    \
+    LISP_SET_STATIC_CFUNCTION(f_name, kFunctionOrdinary, flags, min, max, \
+                              {f});                                       \
+    o->symbol.stype = kSymConstant;                                       \
+  } while (0)
 #define LISP_SET_VALUE(f_name, v) \
   o = LispMakeSymbol(f_name);     \
-  o->symbol.stype = kSymConstant; \
   o->symbol.value = v
 #define LISP_SET_CONSTANT_VALUE(f_name, v) \
   o = LispMakeSymbol(f_name);              \
   o->symbol.stype = kSymConstant;          \
   o->symbol.value = v
-#define LISP_SET_SPECIAL(f_name, f) \
-  o = LispMakeSymbol(f_name);       \
-  o->symbol.value = LispMakeCFunctionSpecial(f_name, f)
-#define LISP_SET_CONSTANT_SPECIAL(f_name, f) \
-  o = LispMakeSymbol(f_name);                \
-  o->symbol.stype = kSymConstant;            \
-  o->symbol.value = LispMakeCFunctionSpecial(f_name, f)
-
-#define LISP_TYPE_OF(o) \
-  ((LispType)(LISP_IMMEDIATE(o) ? LISP_IMMEDIATE(o) : ((o)->d.t)))
+/* specials get their unevaluated argument list as a single argument */
+#define LISP_SET_SPECIAL(f_name, f)                                        \
+  do {                                                                     \
+    LISP_SET_STATIC_CFUNCTION(f_name, kFunctionOrdinary, kFunctionSpecial, \
+                              1, 1, {f});                                  \
+  } while (0)
+#define LISP_SET_CONSTANT_SPECIAL(f_name, f)                               \
+  do {                                                                     \
+    LISP_SET_STATIC_CFUNCTION(f_name, kFunctionOrdinary, kFunctionSpecial, \
+                              1, 1, {f});                                  \
+    o->symbol.stype = kSymConstant;                                        \
+  } while (0)
+
+#define LISP_TYPE_OF(o)                                                   \
+  ((LispType)(LISP_IMMEDIATE(o)                                           \
+                  ? (LISP_Q15P(o) ? kQ15 : (LispType)LISP_IMMEDIATE(o)) \
+                  : ((o)->d.t)))
 
 #define _LISP_HDR uint8_t t
 #define _LISP_HDR1(field) uint8_t t, field
@@ -267,12 +331,17 @@ struct LispLongFloat {
   long double value; /*  longdoublefloat value  */
 };
 
+struct LispQ31 {
+  _LISP_HDR;
+  int32_t value; /*  stands for value / 2^31  */
+};
+
 struct LispCons {
   LispObject car; /*  car  */
   LispObject cdr; /*  cdr  */
 };
 
-enum LispSymType { kSymOrdinary = 0, kSymGenSym, kSymConstant };
+enum LispSymType { kSymOrdinary = 0, kSymGenSym, kSymConstant, kSymInline };
 
 struct LispSymbol {
   _LISP_HDR1(stype); /*symbol type */
@@ -281,11 +350,28 @@ struct LispSymbol {
   char name[1];
 };
 
-enum LispCFunctionType { kFunctionOrdinary = 0, kFunctionSpecial };
+/* calling convention */
+enum LispCFunctionType {
+  kFunctionOrdinary = 0, /* f(narg), arguments on the lisp stack */
+  kFunctionUnary,        /* f1(a) */
+  kFunctionBinary        /* f2(a, b) */
+};
+enum LispCFunctionFlags {
+  kFunctionSpecial = 1,   /* arguments are passed unevaluated */
+  kFunctionPure = 2,      /* no side effects, result depends on args only */
+  kFunctionAllocating = 4 /* may allocate, arguments must be rooted */
+};
+#define LISP_ARGS_ANY ((uint8_t)-1)
 
 struct LispCFunction {
-  _LISP_HDR1(f_type);
-  LispFunc f;
+  _LISP_HDR2(f_type, flags);
+  uint8_t min_args; /* arity, checked once by the caller */
+  uint8_t max_args; /* LISP_ARGS_ANY for &rest */
+  union {
+    LispFunc f;
+    LispFunc1 f1;
+    LispFunc2 f2;
+  };
   char *name;
 };
 
@@ -298,10 +384,12 @@ struct LispVector {   /*  vector header  */
 };
 
 struct LispBitVector { /*  vector header  */
-  _LISP_HDR;           /*  array element type*/
-  LispIndex size;      /*  dimension  */
-  uint8_t self[1];     /*  pointer to the vector  */
+  _LISP_HDR1(pad);     /*  unused high bits of the last byte, kept 0 */
+  LispIndex size;      /*  dimension in bytes  */
+  uint8_t self[1];     /*  bit n is bit n & 7 of byte n >> 3  */
 };
+#define LISP_BIT_VECTOR_LENGTH(x) \
+  ((uint32_t)(x)->bit_vector.size * 8u - (x)->bit_vector.pad)
 
 struct LispString {     /*  vector header  */
   _LISP_HDR;            /*  array element type*/
@@ -309,6 +397,97 @@ struct LispString {     /*  vector header  */
   LispBaseChar self[1]; /*  pointer to the string  */
 };
 
+/* element types of typed arrays, kElemF32 last, the integers before it */
+enum LispElementType { kElemU8 = 0, kElemI16, kElemU16, kElemI32, kElemF32 };
+#define LISP_ELEMENT_TYPES (kElemF32 + 1)
+extern const uint8_t lisp_element_shift[LISP_ELEMENT_TYPES]; /* log2 size */
+extern const char *const lisp_element_names[LISP_ELEMENT_TYPES];
+
+struct LispTypedArray { /*  homogeneous numbers, packed, no pointers  */
+  _LISP_HDR1(etype);    /*  enum LispElementType  */
+  LispIndex size;       /*  number of elements  */
+  union {
+    uint8_t u8[4];
+    int16_t i16[2];
+    uint16_t u16[2];
+    int32_t i32[1];
+    float f32[1];
+  } self;
+};
+/* whole words, at least the one in the struct */
+#define TYPED_ARRAY_BYTES(etype, n)                                      \
+  ((uint32_t)offsetof(struct LispTypedArray, self) +                     \
+   ((n) ? ((((uint32_t)(n) << lisp_element_shift[etype]) + 3U) & ~3U) \
+        : 4U))
+
+enum LispHashTest { kHashEq = 0, kHashEql, kHashEqual };
+#define LISP_HASH_TESTS (kHashEqual + 1)
+extern const char *const lisp_hash_test_names[LISP_HASH_TESTS];
+
+/* open addressing over the pairs kept in insertion order; the index grows a
+ * few pairs per operation, from old_index, and is rehashed after a GC only
+ * when some key hashes by address */
+struct LispHashTable {
+  _LISP_HDR2(test, moving); /*  enum LispHashTest, a key hashed by address  */
+  LispIndex count;          /*  pairs present  */
+  LispIndex migrated;       /*  pairs below it are in index too  */
+  LispIndex migrate_end;    /*  pairs old_index holds  */
+  uint32_t gc_epoch;        /*  collections when index was last hashed  */
+  LispObject entries;       /*  vector key, value, ...; removed key unbound  */
+  LispObject index;         /*  string of LispIndex slots, pair + 1, 0 empty  */
+  LispObject old_index;     /*  index being migrated from, or nil  */
+};
+
+/* fixed capacity ring of objects, a dequeued slot is cleared to nil */
+struct LispQueue {
+  _LISP_HDR1(overwrite); /*  a full queue drops its oldest on enqueue  */
+  LispIndex size;        /*  capacity  */
+  LispIndex head;        /*  slot of the oldest element  */
+  LispIndex count;       /*  elements present  */
+  LispObject self[1];
+};
+
+/* Single producer single consumer ring of int32_t an interrupt handler
+ * fills with LispIsrQueuePush while lisp dequeues, through a kIsrQueue
+ * handle. It lives outside the heap so the collector never moves it, the
+ * free running indices are each written by one side only. */
+typedef struct {
+  volatile uint16_t insert; /*  written by the isr  */
+  volatile uint16_t get;    /*  written by lisp  */
+  uint16_t mask;            /*  capacity - 1, the capacity a power of 2  */
+  volatile uint16_t drops;  /*  pushes that found it full  */
+  volatile int32_t *self;
+} LispIsrQueue;
+#define LISP_ISR_QUEUE(name, n)                                 \
+  static volatile int32_t name##_self[n];                       \
+  LispIsrQueue name = {0, 0, (uint16_t)((n)-1), 0, name##_self}
+/* from the isr: false, and counted as a drop, when the queue is full */
+static inline bool LispIsrQueuePush(LispIsrQueue *q, int32_t x) {
+  uint16_t i = q->insert;
+  if ((uint16_t)(i - q->get) > q->mask) {
+    q->drops = (uint16_t)(q->drops + 1);
+    return false;
+  }
+  q->self[i & q->mask] = x;
+  q->insert = (uint16_t)(i + 1); /* publish after the store */
+  return true;
+}
+
+struct LispIsrQueueHandle {
+  _LISP_HDR;
+  LispIsrQueue *queue;
+};
+
+/* bytes [offset, offset + size) of buffer, kept as an object and an offset
+ * rather than a pointer so the window follows the buffer when the
+ * collector moves it */
+struct LispSlice {
+  _LISP_HDR;
+  LispIndex offset;
+  LispIndex size;
+  LispObject buffer; /*  a u8 typed array or a string, never a slice  */
+};
+
 struct LispGenSym {
   _LISP_HDR1(stype);
   LispIndex id;
@@ -334,9 +513,15 @@ SAFECAST_OP_HEADER(CFunction, struct LispCFunction *, IDENTITY);
 SAFECAST_OP_HEADER(Vector, struct LispVector *, IDENTITY);
 SAFECAST_OP_HEADER(String, struct LispString *, IDENTITY);
 SAFECAST_OP_HEADER(BitVector, struct LispBitVector *, IDENTITY);
+SAFECAST_OP_HEADER(TypedArray, struct LispTypedArray *, IDENTITY);
+SAFECAST_OP_HEADER(HashTable, struct LispHashTable *, IDENTITY);
+SAFECAST_OP_HEADER(Queue, struct LispQueue *, IDENTITY);
+SAFECAST_OP_HEADER(IsrQueue, struct LispIsrQueueHandle *, IDENTITY);
+SAFECAST_OP_HEADER(Slice, struct LispSlice *, IDENTITY);
 SAFECAST_OP_HEADER(SingleFloat, struct LispSingleFloat *, IDENTITY);
 SAFECAST_OP_HEADER(DoubleFloat, struct LispDoubleFloat *, IDENTITY);
 SAFECAST_OP_HEADER(LongFloat, struct LispLongFloat *, IDENTITY);
+SAFECAST_OP_HEADER(Q31, int32_t, LISP_Q31);
 SAFECAST_OP_HEADER(GenSym, struct LispGenSym *, IDENTITY);
 
 /*
@@ -348,10 +533,16 @@ union LispUnion {
   struct LispSingleFloat single_float; /*  single floating-point number  */
   struct LispDoubleFloat double_float; /*  double floating-point number  */
   struct LispLongFloat long_float;     /*  long-float */
+  struct LispQ31 q31;                  /*  Q31 fixed point  */
   struct LispSymbol symbol;            /*  symbol  */
   struct LispVector vector;            /*  vector  */
   struct LispString string;            /*  string  */
   struct LispBitVector bit_vector;     /*  bitvector  */
+  struct LispTypedArray typed_array;   /*  typed numeric array  */
+  struct LispHashTable hash_table;     /*  hash table  */
+  struct LispQueue queue;              /*  ring buffer  */
+  struct LispIsrQueueHandle isr_queue; /*  interrupt fed ring buffer  */
+  struct LispSlice slice;              /*  window on a byte buffer  */
   struct LispGenSym gen_sym;           /*  gensym  */
   struct LispCFunction cfun;           /*  c-function  */
   struct LispDummy d;                  /*  dummy  */
@@ -364,13 +555,19 @@ typedef struct LispDummy LispSmallestStruct;
 MAKE_FUNC_HEADER(SingleFloat, single_float, float);
 MAKE_FUNC_HEADER(DoubleFloat, double_float, double);
 MAKE_FUNC_HEADER(LongFloat, long_float, long double);
+MAKE_FUNC_HEADER(Q31, q31, int32_t);
 
 /* cfunction */
-LispObject LispMakeCFunction(char *name, LispFunc fun);
+LispObject LispMakeCFunction(char *name, LispFunc fun, uint8_t min_args,
+                             uint8_t max_args, uint8_t flags);
+LispObject LispMakeCFunction1(char *name, LispFunc1 fun, uint8_t flags);
+LispObject LispMakeCFunction2(char *name, LispFunc2 fun, uint8_t flags);
 LispObject LispMakeCFunctionSpecial(char *name, LispFunc fun);
 
 /* string */
 LispObject LispMakeString(char *str);
+LispObject LispAllocString(LispIndex n); /* n chars, not initialized */
+LispObject LispStringResize(LispObject s, LispIndex n); /* keeps the chars */
 
 /* bit-vector */
 LispObject LispBitVectorResize(LispObject bv, LispIndex n);
@@ -382,10 +579,30 @@ uint8_t LispBitVectorGet(LispObject o, uint32_t n);
 
 /* vector */
 LispObject LispMakeVector(LispIndex size);
+/* grows the rooted *v to hold alloc_size where it lies, keeping its identity;
+ * false when it is not the last object on the heap or there is no room */
+bool LispVectorGrowInPlace(LispObject *v, LispIndex alloc_size);
 LispObject LispVectorResize(LispObject v, LispIndex alloc_size);
 LispObject LispVectorPush(LispObject v, LispObject value);
 LispObject LispVectorPop(LispObject v);
 
+/* record of the descriptor #(name slot ...), its slots nil */
+LispObject LispMakeRecord(LispObject desc);
+
+/* typed array, n elements set to zero */
+LispObject LispMakeTypedArray(uint8_t etype, LispIndex n);
+
+/* hash table, room for n pairs before it grows */
+LispObject LispMakeHashTable(uint8_t test, LispIndex n);
+
+/* queue of capacity n, empty */
+LispObject LispMakeQueue(LispIndex n, bool overwrite);
+/* handle of q for lisp, e.g. bound to a symbol after LispInit */
+LispObject LispMakeIsrQueue(LispIsrQueue *q);
+
+/* slice of n bytes of buffer from offset, bounds checked by the caller */
+LispObject LispMakeSlice(LispObject buffer, LispIndex offset, LispIndex n);
+
 /* gen-symbol */
 LispObject LdMakeGenSym(LispIndex nargs);
 char *LispSymbolName(LispObject sym);
@@ -398,9 +615,14 @@ LispObject cons(LispObject car, LispObject cdr);
 /* allocate n consecutive conses */
 LispObject ConsReserve(LispIndex n);
 
-/* used for labels */
+/* used for labels, eq keyed: items in insertion order, a label is its
+   position; index is an open addressing hash of positions + 1 (LispIndex
+   slots in a string), keyed on the item's bits, so it is rehashed in place
+   after a GC moves the items */
 typedef struct {
   LispObject items;
+  LispObject index;
+  uint32_t gc_epoch; /* collections when index was last hashed */
 } LabelTable;
 
 typedef struct _ReadState {
@@ -0,0 +1,670 @@
+/*
+ *    \file optimize.c
+ *
+ * Copyright (c) 2020 Islam Omar (io1131@fayoum.edu.eg)
+ *
+ * This file is part of LispDoor.
+ *
+ *     LispDoor is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     LispDoor is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with LispDoor.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This file incorporates work covered by the following copyrights and
+ * permission notices:
+ *
+ *    Copyright (c) 2008 Jeff Bezanson
+ *
+ *    All rights reserved.
+ *
+ *    Redistribution and use in source and binary forms, with or without
+ *    modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *        * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *        * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *        * Neither the author nor the names of any contributors may be used to
+ *          endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ *    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *    Copyright (c) 1984, Taiichi Yuasa and Masami Hagiya.
+ *    Copyright (c) 1990, Giuseppe Attardi.
+ *    Copyright (c) 2001, Juan Jose Garcia Ripoll.
+ *
+ *    ECL is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Library General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2 of the License, or (at your option) any later version.
+ */
+#include "lispdoor/optimize.h"
+
+#include "lispdoor/eval.h"
+#include "lispdoor/memorylayout.h"
+#include "lispdoor/print.h"
+#include "lispdoor/symboltree.h"
+
+/* Rewrites are copy-on-change: the source form is shared with whatever the
+   reader returned, so conses are never modified in place. Anything that
+   allocates may move every object, so live values are kept on the stack. */
+
+typedef LispObject (*OptFunc)(LispObject expr, LispObject bound);
+
+static bool Memq(LispObject x, LispObject list) {
+  while (LISP_ConsP(list)) {
+    if (LISP_CONS_CAR(list) == x) {
+      return true;
+    }
+    list = LISP_CONS_CDR(list);
+  }
+  return false;
+}
+
+/* global value of the operator f or unbound if f is lexically bound */
+static LispObject GlobalValue(LispObject f, LispObject bound) {
+  if (LISP_SymbolP(f) && !Memq(f, bound)) {
+    return f->symbol.value;
+  }
+  return LISP_UNBOUND;
+}
+
+static bool SpecialP(LispObject f, LispObject bound, char *name) {
+  LispObject v = GlobalValue(f, bound);
+  return !LISP_UNBOUNDP(v) && LISP_CFunctionP(v) && LISP_CFUNCTION_SPECIALP(v) &&
+         strcmp(v->cfun.name, name) == 0;
+}
+
+static bool ConstantP(LispObject x, LispObject bound) {
+  if (LISP_ATOM(x)) {
+    return !LISP_SymbolP(x);
+  }
+  return SpecialP(LISP_CONS_CAR(x), bound, "quote") &&
+         LISP_ConsP(LISP_CONS_CDR(x));
+}
+
+static LispObject ConstantValue(LispObject x) {
+  return LISP_ATOM(x) ? x : LISP_CONS_CAR(LISP_CONS_CDR(x));
+}
+
+/* expression evaluating to v */
+static LispObject Literal(LispObject v) {
+  if (LISP_ATOM(v) && !LISP_SymbolP(v)) {
+    return v;
+  }
+  v = cons(v, LISP_NIL);
+  return cons(LispMakeSymbol("quote"), v);
+}
+
+/* expr with its n-th cdr replaced by tail, copying only when it differs */
+static LispObject ReplaceTail(LispObject expr, LispIndex n, LispObject tail) {
+  if (n == 0) {
+    return tail;
+  }
+  PUSH(expr);
+  tail = ReplaceTail(LISP_CONS_CDR(expr), (LispIndex)(n - 1), tail);
+  expr = POP();
+  if (tail == LISP_CONS_CDR(expr)) {
+    return expr;
+  }
+  return cons(LISP_CONS_CAR(expr), tail);
+}
+
+/* apply opt to every element of list */
+static LispObject OptMap(LispObject list, LispObject bound, OptFunc opt) {
+  LispObject head, tail;
+  if (!LISP_ConsP(list)) {
+    return list;
+  }
+  PUSH(list);
+  PUSH(bound);
+  head = opt(LISP_CONS_CAR(list), bound);
+  PUSH(head);
+  tail = OptMap(LISP_CONS_CDR(stack[stack_index - 3]), stack[stack_index - 2],
+                opt);
+  head = POP();
+  POPN(1);
+  list = POP();
+  if (head == LISP_CONS_CAR(list) && tail == LISP_CONS_CDR(list)) {
+    return list;
+  }
+  return cons(head, tail);
+}
+
+static LispObject OptClause(LispObject clause, LispObject bound) {
+  return OptMap(clause, bound, LispOptimize);
+}
+
+/* (keys body ...) of case, the keys are data */
+static LispObject OptCaseClause(LispObject clause, LispObject bound) {
+  LispObject v;
+  if (!LISP_ConsP(clause)) {
+    return clause;
+  }
+  PUSH(clause);
+  v = OptMap(LISP_CONS_CDR(clause), bound, LispOptimize);
+  return ReplaceTail(POP(), 1, v);
+}
+
+/* bound extended by the symbols of a lambda list */
+static LispObject ExtendBound(LispObject arg_syms, LispObject bound) {
+  PUSH(arg_syms);
+  while (LISP_ConsP(stack[stack_index - 1])) {
+    bound = cons(LISP_CONS_CAR(stack[stack_index - 1]), bound);
+    stack[stack_index - 1] = LISP_CONS_CDR(stack[stack_index - 1]);
+  }
+  if (LISP_SymbolP(stack[stack_index - 1])) {
+    bound = cons(stack[stack_index - 1], bound);
+  }
+  POPN(1);
+  return bound;
+}
+
+/* call fun, unbound when it signals an error; LispErrorBegin checks the
+ * trap before the first byte, so nothing of the message is printed */
+static LispObject TrapCall(LispObject fun, LispIndex nargs) {
+  jmp_buf trap, *saved_trap = lisp_error_trap;
+  LispObject volatile ans = LISP_UNBOUND; /* set between setjmp and longjmp */
+  LispIndex closure_depth = LispEnv()->closure_depth;
+  lisp_error_trap = &trap;
+  if (setjmp(trap) == 0) {
+    ans = LispCallCFunction(fun, nargs);
+  }
+  LispEnv()->closure_depth = closure_depth;
+  lisp_error_trap = saved_trap;
+  return ans;
+}
+
+/* call pure builtin fun on the constant args */
+static LispObject Fold(LispObject fun, LispObject args) {
+  LispIndex saved_stack_index = stack_index, nargs = 0;
+  LispObject ans = LISP_UNBOUND;
+  while (LISP_ConsP(args)) {
+    PUSH(ConstantValue(LISP_CONS_CAR(args)));
+    args = LISP_CONS_CDR(args);
+    nargs++;
+  }
+  if (nargs >= fun->cfun.min_args &&
+      (fun->cfun.max_args == LISP_ARGS_ANY || nargs <= fun->cfun.max_args)) {
+    ans = TrapCall(fun, nargs);
+  }
+  stack_index = saved_stack_index;
+  return ans;
+}
+
+/* define-inline: a call is replaced by the body of the closure with its
+   parameters replaced by the argument forms, which must keep every
+   argument evaluated once, in its turn. Constants and local variables go
+   anywhere no side effect can come before a use; any other side effect
+   free form, a global variable too as it may be unbound, only to a single
+   use the template is sure to reach with nothing impure called before it.
+   Templates that bind, capture a caller variable or quote a symbol that
+   set could reach are not inlined. */
+
+#define INLINE_ARGS_MAX 8
+#define INLINE_DEPTH_MAX 4
+
+typedef struct {
+  LispObject self, params, args, bound;
+  bool effects; /* an impure call may have run by this point */
+  uint8_t n_first;
+  uint8_t uses[INLINE_ARGS_MAX];
+  uint8_t first[INLINE_ARGS_MAX]; /* the order of the first uses */
+  bool first_p[INLINE_ARGS_MAX]; /* the first use is certain and clean */
+  bool late_p[INLINE_ARGS_MAX];  /* some use follows a side effect */
+} InlineScan;
+
+static LispIndex inline_depth;
+
+static int Position(LispObject x, LispObject list) {
+  int i;
+  for (i = 0; LISP_ConsP(list); list = LISP_CONS_CDR(list), ++i) {
+    if (LISP_CONS_CAR(list) == x) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* f names a builtin without side effects */
+static bool PureFunctionP(LispObject f, LispObject bound) {
+  f = GlobalValue(f, bound);
+  return !LISP_UNBOUNDP(f) && LISP_CFunctionP(f) && LISP_CFUNCTION_PUREP(f) &&
+         !LISP_CFUNCTION_SPECIALP(f);
+}
+
+static bool InlineScanP(LispObject x, InlineScan *s, bool cond_p);
+
+/* the forms of list in order, each only maybe evaluated after the first
+   when rest_cond_p */
+static bool InlineScanList(LispObject list, InlineScan *s, bool cond_p,
+                           bool rest_cond_p) {
+  for (; LISP_ConsP(list); list = LISP_CONS_CDR(list)) {
+    if (!InlineScanP(LISP_CONS_CAR(list), s, cond_p)) {
+      return false;
+    }
+    cond_p = cond_p || rest_cond_p;
+  }
+  return true;
+}
+
+/* note the parameter uses of template x in evaluation order, cond_p when
+   x may not be evaluated or evaluated again; false if it cannot be
+   inlined */
+static bool InlineScanP(LispObject x, InlineScan *s, bool cond_p) {
+  LispObject f;
+  int i;
+  if (LISP_SymbolP(x)) {
+    if ((i = Position(x, s->params)) >= 0) {
+      if (s->uses[i] == 0) {
+        s->first_p[i] = !cond_p && !s->effects;
+        s->first[i] = s->n_first++;
+      }
+      if (s->uses[i] < UINT8_MAX) {
+        ++s->uses[i];
+      }
+      s->late_p[i] = s->late_p[i] || s->effects;
+      return true;
+    }
+    /* free variables must not be captured at the call site, recursion
+       is not unrolled */
+    return !Memq(x, s->bound) && x != s->self;
+  }
+  if (!LISP_ConsP(x)) {
+    return true;
+  }
+  f = LISP_CONS_CAR(x);
+  if (SpecialP(f, s->params, "quote")) {
+    f = LISP_CONS_CAR_SAFE(LISP_CONS_CDR(x));
+    return !(LISP_SymbolP(f) && (Memq(f, s->params) || Memq(f, s->bound) ||
+                                 Memq(f, s->args)));
+  } else if (SpecialP(f, s->params, "lambda") ||
+             SpecialP(f, s->params, "label") ||
+             SpecialP(f, s->params, "macro") ||
+             SpecialP(f, s->params, "define-inline") ||
+             SpecialP(f, s->params, "defstruct")) {
+    return false;
+  } else if (SpecialP(f, s->params, "progn")) {
+    return InlineScanList(LISP_CONS_CDR(x), s, cond_p, false);
+  } else if (SpecialP(f, s->params, "if") || SpecialP(f, s->params, "and") ||
+             SpecialP(f, s->params, "or")) {
+    /* the first form is evaluated, the others maybe */
+    return InlineScanList(LISP_CONS_CDR(x), s, cond_p, true);
+  } else if (SpecialP(f, s->params, "cond")) {
+    for (x = LISP_CONS_CDR(x); LISP_ConsP(x); x = LISP_CONS_CDR(x)) {
+      if (!InlineScanList(LISP_CONS_CAR(x), s, cond_p, true)) {
+        return false;
+      }
+      cond_p = true;
+    }
+    return true;
+  } else if (SpecialP(f, s->params, "case")) {
+    x = LISP_CONS_CDR(x);
+    if (!LISP_ConsP(x) || !InlineScanP(LISP_CONS_CAR(x), s, cond_p)) {
+      return false;
+    }
+    for (x = LISP_CONS_CDR(x); LISP_ConsP(x); x = LISP_CONS_CDR(x)) {
+      f = LISP_CONS_CAR(x);
+      if (LISP_ConsP(f) &&
+          !InlineScanList(LISP_CONS_CDR(f), s, true, true)) {
+        return false;
+      }
+    }
+    return true;
+  } else if (SpecialP(f, s->params, "while")) {
+    /* a loop runs the test after the body's side effects too */
+    s->effects = true;
+    return InlineScanList(LISP_CONS_CDR(x), s, true, true);
+  } else if (!LISP_SymbolP(f) || Position(f, s->params) < 0) {
+    if (!LISP_SymbolP(f) &&
+        !InlineScanP(f, s, cond_p)) { /* ((lambda ...) ...) is refused */
+      return false;
+    }
+    if (!InlineScanList(LISP_CONS_CDR(x), s, cond_p, false)) {
+      return false;
+    }
+    /* the arguments are evaluated before the call */
+    s->effects = s->effects || !PureFunctionP(f, s->params);
+    return true;
+  }
+  /* a parameter called as a function */
+  if (!InlineScanList(x, s, cond_p, false)) {
+    return false;
+  }
+  s->effects = true;
+  return true;
+}
+
+/* x is evaluated without side effects */
+static bool PureP(LispObject x, LispObject bound) {
+  if (LISP_ATOM(x) || ConstantP(x, bound)) {
+    return true;
+  }
+  if (!PureFunctionP(LISP_CONS_CAR(x), bound)) {
+    return false;
+  }
+  for (x = LISP_CONS_CDR(x); LISP_ConsP(x); x = LISP_CONS_CDR(x)) {
+    if (!PureP(LISP_CONS_CAR(x), bound)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static LispObject Subst(LispObject x, LispIndex base);
+
+/* Subst of every element of list, or of the bodies of case clauses */
+static LispObject SubstList(LispObject list, LispIndex base, bool clauses_p) {
+  LispObject head, tail;
+  if (!LISP_ConsP(list)) {
+    return list;
+  }
+  PUSH(list);
+  head = LISP_CONS_CAR(list);
+  if (!clauses_p) {
+    head = Subst(head, base);
+  } else if (LISP_ConsP(head)) {
+    PUSH(head);
+    tail = SubstList(LISP_CONS_CDR(head), base, false);
+    head = ReplaceTail(POP(), 1, tail);
+  }
+  PUSH(head);
+  tail = SubstList(LISP_CONS_CDR(stack[stack_index - 2]), base, clauses_p);
+  head = POP();
+  list = POP();
+  if (head == LISP_CONS_CAR(list) && tail == LISP_CONS_CDR(list)) {
+    return list;
+  }
+  return cons(head, tail);
+}
+
+/* template x with the parameters in stack[base] replaced by the argument
+   forms in stack[base + 1] */
+static LispObject Subst(LispObject x, LispIndex base) {
+  LispObject params = stack[base], args = stack[base + 1], v;
+  if (LISP_SymbolP(x)) {
+    for (; LISP_ConsP(params); params = LISP_CONS_CDR(params)) {
+      if (LISP_CONS_CAR(params) == x) {
+        return LISP_CONS_CAR(args);
+      }
+      args = LISP_CONS_CDR(args);
+    }
+    return x;
+  }
+  if (!LISP_ConsP(x)) {
+    return x;
+  }
+  if (SpecialP(LISP_CONS_CAR(x), stack[base], "quote")) {
+    return x;
+  }
+  if (!SpecialP(LISP_CONS_CAR(x), stack[base], "case")) {
+    return SubstList(x, base, false);
+  }
+  /* (case key clauses ...) */
+  PUSH(x);
+  v = SubstList(LISP_CONS_CDR(LISP_CONS_CDR(x)), base, true);
+  PUSH(v);
+  v = Subst(LISP_CONS_CAR(LISP_CONS_CDR(stack[stack_index - 2])), base);
+  x = stack[stack_index - 2];
+  if (v == LISP_CONS_CAR(LISP_CONS_CDR(x)) &&
+      stack[stack_index - 1] == LISP_CONS_CDR(LISP_CONS_CDR(x))) {
+    stack_index -= 2;
+    return x;
+  }
+  v = cons(v, stack[stack_index - 1]);
+  v = cons(LISP_CONS_CAR(stack[stack_index - 2]), v);
+  stack_index -= 2;
+  return v;
+}
+
+/* the call of name on the argument forms args inlined, or unbound */
+static LispObject Inline(LispObject name, LispObject args, LispObject bound) {
+  LispObject fun = name->symbol.value;
+  InlineScan s;
+  LispObject params, body, a;
+  LispIndex base = stack_index;
+  int n = 0, i, last = -1;
+  /* (lambda params body) closed over the global frame */
+  if (!(LISP_ConsP(fun) && LISP_ConsP(LISP_CONS_CDR(fun)) &&
+        LISP_ConsP(LISP_CONS_CDR(LISP_CONS_CDR(fun))) &&
+        LISP_NULL(LISP_CONS_CDR(LISP_CONS_CDR(LISP_CONS_CDR(fun)))))) {
+    return LISP_UNBOUND;
+  }
+  params = LISP_CONS_CAR(LISP_CONS_CDR(fun));
+  body = LISP_CONS_CAR(LISP_CONS_CDR(LISP_CONS_CDR(fun)));
+  for (a = params; LISP_ConsP(a); a = LISP_CONS_CDR(a), ++n) {
+    if (n == INLINE_ARGS_MAX || !LISP_SymbolP(LISP_CONS_CAR(a))) {
+      return LISP_UNBOUND;
+    }
+  }
+  if (!LISP_NULL(a)) {
+    return LISP_UNBOUND;
+  }
+  for (a = args, i = 0; LISP_ConsP(a); a = LISP_CONS_CDR(a), ++i) {
+  }
+  if (i != n) {
+    /* leave the arity error to the call */
+    return LISP_UNBOUND;
+  }
+  s.self = name;
+  s.params = params;
+  s.args = args;
+  s.bound = bound;
+  s.effects = false;
+  s.n_first = 0;
+  memset(s.uses, 0, sizeof(s.uses));
+  memset(s.first_p, 0, sizeof(s.first_p));
+  memset(s.late_p, 0, sizeof(s.late_p));
+  if (!InlineScanP(body, &s, false)) {
+    return LISP_UNBOUND;
+  }
+  for (a = args, i = 0; LISP_ConsP(a); a = LISP_CONS_CDR(a), ++i) {
+    LispObject x = LISP_CONS_CAR(a);
+    if (ConstantP(x, bound) ||
+        (LISP_SymbolP(x) && LISP_SYMBOL_CONSTANTP(x))) {
+      continue;
+    }
+    if (LISP_SymbolP(x) && Memq(x, bound)) {
+      /* a local is bound and holds its value until a side effect */
+      if (s.late_p[i]) {
+        return LISP_UNBOUND;
+      }
+    } else if (!(s.uses[i] == 1 && s.first_p[i] && s.first[i] > last &&
+                 PureP(x, bound))) {
+      /* dropped, moved past a side effect or another such argument,
+         repeated or maybe skipped */
+      return LISP_UNBOUND;
+    } else {
+      last = s.first[i];
+    }
+  }
+  PUSH(params);
+  PUSH(args);
+  body = Subst(body, base);
+  stack_index = base;
+  return body;
+}
+
+static LispObject OptSpecial(LispObject expr, LispObject bound, char *name) {
+  LispIndex saved_stack_index = stack_index;
+  LispObject v;
+  PUSH(expr);
+  PUSH(bound);
+  if (strcmp(name, "if") == 0) {
+    v = OptMap(LISP_CONS_CDR(expr), bound, LispOptimize);
+    if (LISP_ConsP(v) &&
+        ConstantP(LISP_CONS_CAR(v), stack[saved_stack_index + 1])) {
+      /* (if test then else) with a known test */
+      if (LISP_NULL(ConstantValue(LISP_CONS_CAR(v)))) {
+        v = LISP_CONS_CDR(v);
+        v = LISP_ConsP(v) ? LISP_CONS_CDR(v) : LISP_NIL;
+      } else {
+        v = LISP_CONS_CDR(v);
+      }
+      v = LISP_ConsP(v) ? LISP_CONS_CAR(v) : LISP_NIL;
+    } else {
+      v = ReplaceTail(stack[saved_stack_index], 1, v);
+    }
+  } else if (strcmp(name, "cond") == 0) {
+    v = OptMap(LISP_CONS_CDR(expr), bound, OptClause);
+    v = ReplaceTail(stack[saved_stack_index], 1, v);
+  } else if (strcmp(name, "case") == 0 && LISP_ConsP(LISP_CONS_CDR(expr))) {
+    /* (case key clauses ...) */
+    v = LISP_CONS_CDR(LISP_CONS_CDR(expr));
+    v = OptMap(v, bound, OptCaseClause);
+    v = ReplaceTail(stack[saved_stack_index], 2, v);
+    stack[saved_stack_index] = v;
+    v = LispOptimize(LISP_CONS_CAR(LISP_CONS_CDR(v)),
+                     stack[saved_stack_index + 1]);
+    if (v != LISP_CONS_CAR(LISP_CONS_CDR(stack[saved_stack_index]))) {
+      v = cons(v, LISP_CONS_CDR(LISP_CONS_CDR(stack[saved_stack_index])));
+      v = cons(LISP_CONS_CAR(stack[saved_stack_index]), v);
+    } else {
+      v = stack[saved_stack_index];
+    }
+  } else if (strcmp(name, "and") == 0 || strcmp(name, "or") == 0 ||
+             strcmp(name, "while") == 0 || strcmp(name, "progn") == 0 ||
+             strcmp(name, "with-output-to-string") == 0) {
+    v = OptMap(LISP_CONS_CDR(expr), bound, LispOptimize);
+    v = ReplaceTail(stack[saved_stack_index], 1, v);
+  } else if (strcmp(name, "lambda") == 0 && LISP_ConsP(LISP_CONS_CDR(expr))) {
+    /* (lambda args body) */
+    v = ExtendBound(LISP_CONS_CAR(LISP_CONS_CDR(expr)), bound);
+    stack[saved_stack_index + 1] = v;
+    v = LISP_CONS_CDR(LISP_CONS_CDR(stack[saved_stack_index]));
+    v = OptMap(v, stack[saved_stack_index + 1], LispOptimize);
+    v = ReplaceTail(stack[saved_stack_index], 2, v);
+  } else if (strcmp(name, "label") == 0 && LISP_ConsP(LISP_CONS_CDR(expr))) {
+    /* (label name (lambda args body)) */
+    v = cons(LISP_CONS_CAR(LISP_CONS_CDR(expr)), bound);
+    stack[saved_stack_index + 1] = v;
+    v = LISP_CONS_CDR(LISP_CONS_CDR(stack[saved_stack_index]));
+    v = OptMap(v, stack[saved_stack_index + 1], LispOptimize);
+    v = ReplaceTail(stack[saved_stack_index], 2, v);
+  } else {
+    /* quote, macro and unknown specials see their arguments as data */
+    v = expr;
+  }
+  stack_index = saved_stack_index;
+  return v;
+}
+
+bool LispOptimizeP(void) {
+  /* only definitions made outside any closure, at top level or load time;
+     nested lambdas are rewritten with their enclosing body */
+  return LispEnv()->closure_depth == 0 &&
+         LISP_TO_BOOL(LispMakeSymbol("*optimize*")->symbol.value);
+}
+
+/* fold pure builtins on constant arguments, drop dead if branches, inline
+   constant symbols and define-inline calls; bound holds the lexically bound
+   symbols */
+LispObject LispOptimize(LispObject expr, LispObject bound) {
+  LispIndex saved_stack_index = stack_index;
+  LispObject f, v;
+  if ((Byte *)&f < stack_bottom) {
+    LispError("optimize: error: c-stack overflow\n");
+  }
+  if (LISP_SymbolP(expr)) {
+    if (LISP_SYMBOL_CONSTANTP(expr) && !LISP_UNBOUNDP(expr->symbol.value) &&
+        !Memq(expr, bound)) {
+      expr = Literal(expr->symbol.value);
+    }
+    return expr;
+  }
+  if (!LISP_ConsP(expr)) {
+    return expr;
+  }
+  f = LISP_CONS_CAR(expr);
+  if (LISP_ConsP(f)) {
+    /* ((lambda args body) ...) */
+    if (!SpecialP(LISP_CONS_CAR(f), bound, "lambda")) {
+      return expr;
+    }
+    PUSH(expr);
+    PUSH(bound);
+    v = OptMap(expr, bound, LispOptimize);
+    stack_index = saved_stack_index;
+    return v;
+  }
+  v = GlobalValue(f, bound);
+  if (LISP_UNBOUNDP(v)) {
+    /* unknown operator, might be a macro defined later */
+    return expr;
+  }
+  if (LISP_CFunctionP(v)) {
+    if (LISP_CFUNCTION_SPECIALP(v)) {
+      return OptSpecial(expr, bound, v->cfun.name);
+    }
+  } else if (!(LISP_ConsP(v) && LISP_SymbolP(LISP_CONS_CAR(v)) &&
+               (strcmp(LISP_CONS_CAR(v)->symbol.name, "lambda") == 0 ||
+                strcmp(LISP_CONS_CAR(v)->symbol.name, "label") == 0))) {
+    /* macros and non-functions are left alone */
+    return expr;
+  }
+  PUSH(expr);
+  PUSH(bound);
+  v = OptMap(LISP_CONS_CDR(expr), bound, LispOptimize);
+  PUSH(v);
+  f = LISP_CONS_CAR(stack[saved_stack_index]);
+  if (LISP_SYMBOL_INLINEP(f) && inline_depth < INLINE_DEPTH_MAX) {
+    v = Inline(f, v, stack[saved_stack_index + 1]);
+    if (!LISP_UNBOUNDP(v)) {
+      /* inline calls in the expansion too, up to a depth for recursion */
+      ++inline_depth;
+      v = LispOptimize(v, stack[saved_stack_index + 1]);
+      --inline_depth;
+      stack_index = saved_stack_index;
+      return v;
+    }
+  }
+  f = f->symbol.value;
+  if (LISP_CFunctionP(f) && LISP_CFUNCTION_PUREP(f)) {
+    bool constant_p = true;
+    while (LISP_ConsP(v) && constant_p) {
+      constant_p = ConstantP(LISP_CONS_CAR(v), stack[saved_stack_index + 1]);
+      v = LISP_CONS_CDR(v);
+    }
+    if (constant_p) {
+      v = Fold(f, stack[stack_index - 1]);
+      if (!LISP_UNBOUNDP(v)) {
+        v = Literal(v);
+        stack_index = saved_stack_index;
+        return v;
+      }
+    }
+  }
+  v = ReplaceTail(stack[saved_stack_index], 1, stack[stack_index - 1]);
+  stack_index = saved_stack_index;
+  return v;
+}
+
+LispObject LispOptimizeBody(LispObject arg_syms, LispObject body,
+                            LispObject bound) {
+  inline_depth = 0; /* an error may have left it raised */
+  PUSH(body);
+  bound = ExtendBound(arg_syms, bound);
+  body = POP();
+  return LispOptimize(body, bound);
+}
@@ -65,23 +65,41 @@
 #include "hal/bsp.h"
 #include "lispdoor/memorylayout.h"
 #include "lispdoor/read.h"
+#include "lispdoor/symboltree.h"
 #include "lispdoor/utils.h"
 
-#define CONS_INDEX(c)                         \
-  (((LispSmallestStruct *)LISP_CONS_PTR(c)) - \
+/* conses and vectors, the objects *print-circle* labels */
+#define CONS_INDEX(c)                                              \
+  (((LispSmallestStruct *)((intptr_t)(c) & ~(intptr_t)0x3)) - \
    ((LispSmallestStruct *)(void *)heap))
 
 #define MARKED_P(c) LispBitVectorGet(cons_flags, (uint32_t)CONS_INDEX(c))
 #define MARK_CONS(c) LispBitVectorSet(cons_flags, (uint32_t)CONS_INDEX(c), 1)
 #define UNMARK_CONS(c) LispBitVectorSet(cons_flags, (uint32_t)CONS_INDEX(c), 0)
 
+/* nesting printed before giving up with # when *print-circle* is nil */
+#define PRINT_MAX_DEPTH 32
+static bool print_circle;
+static LispIndex print_depth;
+
 // error utilities ------------------------------------------------------------
+jmp_buf *lisp_error_trap = NULL;
+void LispErrorBegin(void) {
+  print_depth = 0;
+  if (lisp_error_trap != NULL) {
+    longjmp(*lisp_error_trap, 1);
+  }
+  print_port = &lisp_uart_port;
+}
 void LispError(char *format) {
+  LispErrorBegin();
   read_state = NULL;
+  read_stream = &lisp_tib_stream;
   LispPrintStr(format);
   longjmp(LispEnv()->top_level, 1);
 }
 void LispTypeError(char *fname, char *expected, LispObject got) {
+  LispErrorBegin();
   LispPrintStr(fname);
   LispPrintStr(": error: expected ");
   LispPrintStr(expected);
@@ -91,6 +109,21 @@ void LispTypeError(char *fname, char *expected, LispObject got) {
 }
 
 static void PrintTraverse(LispObject v) {
+  LispIndex i;
+  if (LISP_VectorP(v) || LISP_RecordP(v)) {
+    if (MARKED_P(v)) {
+      LabelTableAdjoin(&print_conses, v);
+      return;
+    }
+    MARK_CONS(v);
+    /* a record's descriptor is printed as names only */
+    for (i = LISP_RecordP(v) ? 1 : 0; i < v->vector.fillp; ++i) {
+      PUSH(v);
+      PrintTraverse(v->vector.self[i]);
+      v = POP();
+    }
+    return;
+  }
   while (LISP_ConsP(v) && !LISP_UNBOUNDP(LISP_CONS_CAR(v))) {
     if (MARKED_P(v)) {
       LabelTableAdjoin(&print_conses, v);
@@ -102,6 +135,9 @@ static void PrintTraverse(LispObject v) {
     v = POP();
     v = LISP_CONS_CDR(v);
   }
+  if (LISP_VectorP(v) || LISP_RecordP(v)) {
+    PrintTraverse(v); /* a dotted tail */
+  }
 }
 
 static void PrintSymbol(char *name) {
@@ -151,6 +187,61 @@ static void PrintSymbol(char *name) {
   }
 }
 
+/* For *print-circle*: #n# when o is shared and printed already, true as
+ * it is then done; #n= before the first print of a shared o */
+static bool PrintLabel(LispObject o) {
+  LispIndex label = LabelTableLookUp(&print_conses, o);
+  if (label == NOTFOUND) {
+    return false;
+  }
+  LispPrintByte('#');
+  LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE, label, 10));
+  if (!MARKED_P(o)) {
+    LispPrintByte('#');
+    return true;
+  }
+  LispPrintByte('=');
+  return false;
+}
+
+static void DoPrint(LispObject o, bool princ);
+/* Single pass list printer for *print-circle* nil: Brent's cycle check on
+ * the cdr chain ends a circular list with ..., and the depth limit stops
+ * the car direction */
+static void DoPrintList(LispObject o, bool princ) {
+  LispObject cd, tortoise = o;
+  LispIndex power = 1, lam = 0;
+  if (print_depth >= PRINT_MAX_DEPTH) {
+    LispPrintByte('#');
+    return;
+  }
+  ++print_depth;
+  LispPrintByte('(');
+  while (1) {
+    DoPrint(LISP_CONS_CAR(o), princ);
+    cd = LISP_CONS_CDR(o);
+    if (!LISP_ConsP(cd)) {
+      if (cd != LISP_NIL) {
+        LispPrintStr(" . ");
+        DoPrint(cd, princ);
+      }
+      break;
+    }
+    if (cd == tortoise) {
+      LispPrintStr(" ...");
+      break;
+    }
+    if (++lam == power) {
+      tortoise = cd;
+      power = (LispIndex)(power << 1);
+      lam = 0;
+    }
+    LispPrintByte(' ');
+    o = cd;
+  }
+  LispPrintByte(')');
+  --print_depth;
+}
 static void DoPrint(LispObject o, bool princ) {
   LispObject cd;
   LispIndex label;
@@ -163,8 +254,8 @@ static void DoPrint(LispObject o, bool princ) {
   } else {
     switch (LISP_TYPE_OF(o)) {
       case kFixNum: {
-        LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
-                              (uint32_t)LISP_FIXNUM(o), lisp_number_base));
+        LispPrintStr(Int2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                             LISP_FIXNUM(o), lisp_number_base));
         break;
       }
       case kCharacter: {
@@ -175,42 +266,116 @@ static void DoPrint(LispObject o, bool princ) {
       }
       case kSingleFloat: {
         LispPrintStr(Float2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
-                               LISP_SINGLE_FLOAT(o),
-                               lisp_fractional_precision));
+                               LISP_SINGLE_FLOAT(o)));
         break;
       }
       case kDoubleFloat: {
         LispPrintStr(Double2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
-                                LISP_DOUBLE_FLOAT(o),
-                                lisp_fractional_precision));
+                                LISP_DOUBLE_FLOAT(o)));
+        break;
+      }
+      case kQ15: {
+        LispPrintStr(Fixed2Str((char *)scratch_pad, LISP_Q15(o), 15));
+        break;
+      }
+      case kQ31: {
+        LispPrintStr(Fixed2Str((char *)scratch_pad, LISP_Q31(o), 31));
         break;
       }
       case kString: {
+        LispIndex start = 0;
+        if (princ) {
+          LispPrintStrN(o->string.self, o->string.size);
+          break;
+        }
         LispPrintByte('\"');
-        LispPrintStrN(o->string.self, o->string.size);
+        for (label = 0; label < o->string.size; label++) {
+          char c = o->string.self[label];
+          if (c == '\"' || c == '\\') {
+            LispPrintStrN(o->string.self + start, (LispIndex)(label - start));
+            LispPrintByte('\\');
+            start = label;
+          }
+        }
+        LispPrintStrN(o->string.self + start, (LispIndex)(label - start));
         LispPrintByte('\"');
         break;
       }
       case kBitVector: {
-        LispPrintStr("#b(");
-        for (label = 0;;) {
-          LispPrintStr("0b");
-          LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
-                                o->bit_vector.self[label], 2));
-          if (++label < o->bit_vector.size) {
+        uint32_t i, n = LISP_BIT_VECTOR_LENGTH(o);
+        LispPrintStr("#*");
+        for (i = 0; i < n; ++i) {
+          uint8_t b = o->bit_vector.self[i >> 3];
+          LispPrintByte((Byte)('0' + ((b >> (i & 7)) & 1)));
+        }
+        break;
+      }
+      case kHashTable: {
+        LispPrintStr("#<hash-table ");
+        LispPrintStr((char *)lisp_hash_test_names[o->hash_table.test]);
+        LispPrintByte(' ');
+        LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                              o->hash_table.count, 10));
+        LispPrintByte('>');
+        break;
+      }
+      case kSlice: {
+        LispPrintStr("#<slice ");
+        LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                              o->slice.offset, 10));
+        LispPrintByte(' ');
+        LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                              o->slice.size, 10));
+        LispPrintByte('>');
+        break;
+      }
+      case kQueue:
+      case kIsrQueue: {
+        LispIsrQueue *iq = LISP_IsrQueueP(o) ? o->isr_queue.queue : NULL;
+        LispPrintStr(iq ? "#<isr-queue " : "#<queue ");
+        LispPrintStr(Uint2Str(
+            (char *)scratch_pad, SCRATCH_PAD_SIZE,
+            iq ? (uint16_t)(iq->insert - iq->get) : o->queue.count, 10));
+        LispPrintByte('/');
+        LispPrintStr(Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                              iq ? iq->mask + 1u : o->queue.size, 10));
+        LispPrintByte('>');
+        break;
+      }
+      case kTypedArray: {
+        LispPrintByte('#');
+        LispPrintStr((char *)lisp_element_names[o->typed_array.etype]);
+        LispPrintByte('(');
+        for (label = 0; label < o->typed_array.size; ++label) {
+          if (label > 0) {
             LispPrintByte(' ');
+          }
+          if (o->typed_array.etype == kElemF32) {
+            LispPrintStr(Float2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                                   o->typed_array.self.f32[label]));
           } else {
-            break;
+            LispPrintStr(Int2Str((char *)scratch_pad, SCRATCH_PAD_SIZE,
+                                 ArrayGetInt(o, label), 10));
           }
         }
         LispPrintByte(')');
         break;
       }
       case kVector: {
+        if (print_circle) {
+          if (PrintLabel(o)) {
+            break;
+          }
+          UNMARK_CONS(o);
+        } else if (print_depth >= PRINT_MAX_DEPTH) {
+          LispPrintByte('#');
+          break;
+        }
+        ++print_depth;
         LispPrintStr("#(");
         if (o->vector.fillp > 0) {
           for (label = 0;;) {
-            LispPrintObject(o->vector.self[label], princ);
+            DoPrint(o->vector.self[label], princ);
             if (++label < o->vector.fillp) {
               LispPrintByte(' ');
             } else {
@@ -219,6 +384,31 @@ static void DoPrint(LispObject o, bool princ) {
           }
         }
         LispPrintByte(')');
+        --print_depth;
+        break;
+      }
+      case kRecord: {
+        /* #S(name :slot value ...) */
+        if (print_circle) {
+          if (PrintLabel(o)) {
+            break;
+          }
+          UNMARK_CONS(o);
+        } else if (print_depth >= PRINT_MAX_DEPTH) {
+          LispPrintByte('#');
+          break;
+        }
+        ++print_depth;
+        LispPrintStr("#S(");
+        DoPrint(o->vector.self[0]->vector.self[0], princ);
+        for (label = 1; label < o->vector.fillp; ++label) {
+          LispPrintStr(" :");
+          DoPrint(o->vector.self[0]->vector.self[label], princ);
+          LispPrintByte(' ');
+          DoPrint(o->vector.self[label], princ);
+        }
+        LispPrintByte(')');
+        --print_depth;
         break;
       }
       /* case kForwarded: { */
@@ -245,19 +435,12 @@ static void DoPrint(LispObject o, bool princ) {
         break;
       }
       case kList: {
-        label = LabelTableLookUp(&print_conses, o);
-        if (label != NOTFOUND) {
-          if (!MARKED_P(o)) {
-            LispPrintByte('#');
-            LispPrintStr(
-                Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE, label, 10));
-            LispPrintByte('#');
-            break;
-          }
-          LispPrintByte('#');
-          LispPrintStr(
-              Uint2Str((char *)scratch_pad, SCRATCH_PAD_SIZE, label, 10));
-          LispPrintByte('=');
+        if (!print_circle) {
+          DoPrintList(o, princ);
+          break;
+        }
+        if (PrintLabel(o)) {
+          break;
         }
         LispPrintByte('(');
         while (1) {
@@ -291,13 +474,144 @@ static void DoPrint(LispObject o, bool princ) {
   }
 }
 
-void LispPrintObject(LispObject v, bool princ) {
-  LabelTableClear(&print_conses);
-  PUSH(v);
-  PrintTraverse(v);
-  v = POP();
+// output ports ---------------------------------------------------------------
+/* uart: DoPrint writes a few bytes at a time, stage them and hand the uart
+ * whole runs */
+#define UART_PORT_BUFFER_SIZE 32U
+static char uart_port_buffer[UART_PORT_BUFFER_SIZE];
+static void UartPortFlush(LispPort *p) {
+  if (p->fill) {
+    UART1_SendStrN(p->base, (uint16_t)p->fill);
+    p->fill = 0;
+  }
+}
+static void UartPortWrite(LispPort *p, const char *s, LispIndex n) {
+  if (p->fill + n > p->size) {
+    UartPortFlush(p);
+    if (n >= p->size) {
+      UART1_SendStrN((char *)s, n);
+      return;
+    }
+  }
+  memcpy(p->base + p->fill, s, n);
+  p->fill += n;
+}
+static const LispPortOps uart_port_ops = {UartPortWrite, UartPortFlush, NULL};
+LispPort lisp_uart_port = {&uart_port_ops, uart_port_buffer, 0, 0,
+                           UART_PORT_BUFFER_SIZE};
+LispPort *print_port = &lisp_uart_port;
+
+/* fixed buffer: what does not fit is dropped, fill still counts it */
+static void BufferPortWrite(LispPort *p, const char *s, LispIndex n) {
+  if (p->fill < p->size) {
+    memcpy(p->base + p->fill, s,
+           (p->size - p->fill < n) ? p->size - p->fill : n);
+  }
+  p->fill += n;
+}
+static void PortNoFlush(LispPort *p) { (void)p; }
+static const LispPortOps buffer_port_ops = {BufferPortWrite, PortNoFlush,
+                                            NULL};
+void LispPortInitBuffer(LispPort *p, char *buf, uint32_t size) {
+  p->ops = &buffer_port_ops;
+  p->base = buf;
+  p->slot = 0;
+  p->fill = 0;
+  p->size = size;
+}
+
+/* growable string: stack[slot] holds a string of capacity size, it moves with
+ * the heap so it is never held by pointer across an allocation */
+static void StringPortReserve(LispPort *p, uint32_t n) {
+  LispObject s;
+  uint32_t size = p->size ? p->size : 16;
+  if (p->fill + n <= p->size) {
+    return;
+  }
+  while (size < p->fill + n) {
+    size <<= 1;
+  }
+  if (size > (LispIndex)-1) {
+    LispError("print: error: string too long\n");
+  }
+  s = LispAllocString((LispIndex)size);
+  if (p->fill) {
+    memcpy(s->string.self, stack[p->slot]->string.self, p->fill);
+  }
+  stack[p->slot] = s;
+  p->size = size;
+}
+static void StringPortWrite(LispPort *p, const char *s, LispIndex n) {
+  StringPortReserve(p, n);
+  memcpy(stack[p->slot]->string.self + p->fill, s, n);
+  p->fill += n;
+}
+static const LispPortOps string_port_ops = {StringPortWrite, PortNoFlush,
+                                            StringPortReserve};
+void LispPortInitString(LispPort *p, LispIndex slot) {
+  p->ops = &string_port_ops;
+  p->base = NULL;
+  p->slot = slot;
+  p->fill = 0;
+  p->size = 0;
+  stack[slot] = LISP_NIL;
+}
+LispObject LispPortString(LispPort *p) {
+  LispObject s = LispAllocString((LispIndex)p->fill);
+  if (p->fill) {
+    memcpy(s->string.self, stack[p->slot]->string.self, p->fill);
+  }
+  return s;
+}
+
+/* counts what a print would write, to reserve it up front */
+static void CountPortWrite(LispPort *p, const char *s, LispIndex n) {
+  (void)s;
+  p->fill += n;
+}
+static const LispPortOps count_port_ops = {CountPortWrite, PortNoFlush, NULL};
+
+static void PrintObject(LispObject v, bool princ) {
+  print_circle =
+      LISP_TO_BOOL(LispMakeSymbol("*print-circle*")->symbol.value);
+  if (print_circle) {
+    LabelTableClear(&print_conses);
+    PUSH(v);
+    PrintTraverse(v);
+    v = POP();
+  }
   DoPrint(v, princ);
 }
-void LispPrintStr(char *str) { UART1_SendStr(str); }
-void LispPrintByte(Byte c) { UART1_SendByte(c); }
-void LispPrintStrN(char *s, LispIndex len) { UART1_SendStrN(s, len); }
+void LispPrintObject(LispObject v, bool princ) {
+  LispPort count = {&count_port_ops, NULL, 0, 0, 0}, *port = print_port;
+  if (port->ops->reserve != NULL) {
+    /* DoPrint holds bare object pointers, so a sink that allocates gets all
+     * the room it needs before, measured by a dry run */
+    PUSH(v);
+    print_port = &count;
+    PrintObject(v, princ);
+    print_port = port;
+    port->ops->reserve(port, count.fill);
+    v = POP();
+  }
+  PrintObject(v, princ);
+}
+void LispPrintStr(char *str) {
+  print_port->ops->write(print_port, str, (LispIndex)strlen(str));
+}
+void LispPrintByte(Byte c) {
+  LispPort *p = print_port;
+  if (p->ops == &uart_port_ops && p->fill < p->size) {
+    p->base[p->fill++] = (char)c;
+  } else {
+    p->ops->write(p, (char *)&c, 1);
+  }
+}
+void LispPrintStrN(char *s, LispIndex len) {
+  print_port->ops->write(print_port, s, len);
+}
+void LispPrintFlush() {
+  LispPortFlush(print_port);
+  LispPortFlush(&lisp_uart_port);
+  UART1_Flush();
+}
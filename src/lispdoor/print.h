@@ -64,13 +64,42 @@
 
 #include "lispdoor/objects.h"
 
+/* Output ports, the printer writes through the ops of print_port */
+typedef struct _LispPort LispPort;
+typedef struct {
+  void (*write)(LispPort *p, const char *s, LispIndex n);
+  void (*flush)(LispPort *p); /* push staged bytes to the sink */
+  /* make room for n more bytes ahead of a print that must not allocate,
+     NULL for sinks that never allocate */
+  void (*reserve)(LispPort *p, uint32_t n);
+} LispPortOps;
+struct _LispPort {
+  const LispPortOps *ops;
+  char *base;     /* uart: staging buffer, buffer sink: the buffer */
+  LispIndex slot; /* string sink: stack slot holding the string grown */
+  uint32_t fill;  /* bytes written, may exceed size for a full buffer sink */
+  uint32_t size;
+};
+extern LispPort lisp_uart_port;
+extern LispPort *print_port;
+void LispPortInitBuffer(LispPort *p, char *buf, uint32_t size);
+/* stack[slot] must stay reserved for the port while it is used */
+void LispPortInitString(LispPort *p, LispIndex slot);
+LispObject LispPortString(LispPort *p); /* what a string port got so far */
+static inline void LispPortFlush(LispPort *p) { p->ops->flush(p); }
+
 /* print */
 void LispPrintObject(LispObject v, bool princ);
 void LispPrintStr(char *str);
 void LispPrintStrN(char *s, LispIndex len);
 void LispPrintByte(Byte c);
+void LispPrintFlush();
 
 /* error utilities  */
+extern jmp_buf *lisp_error_trap; /* when set errors jump here silently */
+/* before the first byte of an error message printed in parts, e.g.
+ * LispErrorBegin(); LispPrintStr(fname); LispError(": error: ...") */
+void LispErrorBegin(void);
 void LispError(char *format);
 void LispTypeError(char *fname, char *expected, LispObject got);
 
@@ -62,7 +62,9 @@
 
 #include "lispdoor/read.h"
 
+#include "hal/bsp.h"
 #include "lispdoor/eval.h"
+#include "lispdoor/gc.h"
 #include "lispdoor/memorylayout.h"
 #include "lispdoor/print.h"
 #include "lispdoor/read.h"
@@ -118,17 +120,43 @@ static const uint8_t trailing_bytes_for_utf8[256] = {
     1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
     3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5};
 
+/* Character classes of the tokenizer */
+enum {
+  kCharSpace = 1,   /* separates tokens */
+  kCharSpecial = 2, /* ( ) ' ; ` , \ | " end or change a token */
+  kCharDigit = 4,   /* 0-9 */
+  kCharHex = 8      /* a-f A-F */
+};
+#define CHAR_CLASS(c) char_class[(uint8_t)(c)]
+static const uint8_t char_class[256] = {
+    ['\t'] = kCharSpace,   ['\n'] = kCharSpace,   ['\v'] = kCharSpace,
+    ['\f'] = kCharSpace,   ['\r'] = kCharSpace,   [' '] = kCharSpace,
+    ['('] = kCharSpecial,  [')'] = kCharSpecial,  ['\''] = kCharSpecial,
+    [';'] = kCharSpecial,  ['`'] = kCharSpecial,  [','] = kCharSpecial,
+    ['\\'] = kCharSpecial, ['|'] = kCharSpecial,  ['"'] = kCharSpecial,
+    ['0'] = kCharDigit,    ['1'] = kCharDigit,    ['2'] = kCharDigit,
+    ['3'] = kCharDigit,    ['4'] = kCharDigit,    ['5'] = kCharDigit,
+    ['6'] = kCharDigit,    ['7'] = kCharDigit,    ['8'] = kCharDigit,
+    ['9'] = kCharDigit,    ['a'] = kCharHex,      ['b'] = kCharHex,
+    ['c'] = kCharHex,      ['d'] = kCharHex,      ['e'] = kCharHex,
+    ['f'] = kCharHex,      ['A'] = kCharHex,      ['B'] = kCharHex,
+    ['C'] = kCharHex,      ['D'] = kCharHex,      ['E'] = kCharHex,
+    ['F'] = kCharHex};
+
 bool SymCharP(char c) {
-  static char *special = "()';`,\\|";
-  return (!isspace(c) && !strchr(special, c));
+  return !(CHAR_CLASS(c) & (kCharSpace | kCharSpecial));
 }
 static inline bool TibEmpty() {
   return (terminal_buffer_get_index == terminal_buffer_insert_index);
 }
 uint8_t TibReadChar() {
+  if (TibEmpty()) {
+    /* whatever asked for this input should be on the wire first */
+    LispPortFlush(&lisp_uart_port);
+  }
   while (TibEmpty()) {
     /* TODO: multitasking */
-    /* pause(); */
+    BspWaitInput();
   }
   uint8_t index = terminal_buffer_get_index;
   ++terminal_buffer_get_index;
@@ -141,9 +169,90 @@ void TibUnReadChar() {
 }
 void TibFlush() { terminal_buffer_get_index = terminal_buffer_insert_index; }
 
-/* get char */
-static inline uint8_t GetChar() { return TibReadChar(); }
-static inline void UnGetChar() { TibUnReadChar(); }
+/* Streams */
+static uint8_t TibStreamGet(LispStream *s) {
+  ++s->pos;
+  return TibReadChar();
+}
+static void TibStreamUnGet(LispStream *s) {
+  --s->pos;
+  TibUnReadChar();
+}
+static LispIndex TibStreamPeek(LispStream *s, uint8_t *buf, LispIndex n) {
+  LispIndex i = 0;
+  Byte index = terminal_buffer_get_index;
+  (void)s;
+  while (i < n && index != terminal_buffer_insert_index) {
+    buf[i++] = terminal_buffer[index];
+    index = (Byte)((index + 1) & (TIB_SIZE - 1));
+  }
+  return i;
+}
+static uint32_t StreamPosition(LispStream *s) { return s->pos; }
+static const LispStreamOps tib_stream_ops = {TibStreamGet, TibStreamUnGet,
+                                             TibStreamPeek, StreamPosition};
+
+static uint8_t MemoryStreamGet(LispStream *s) {
+  return (s->pos < s->end) ? s->base[s->pos++] : EOF;
+}
+static void MemoryStreamUnGet(LispStream *s) { --s->pos; }
+static LispIndex MemoryStreamPeek(LispStream *s, uint8_t *buf, LispIndex n) {
+  if (n > s->end - s->pos) {
+    n = (LispIndex)(s->end - s->pos);
+  }
+  memcpy(buf, s->base + s->pos, n);
+  return n;
+}
+static const LispStreamOps memory_stream_ops = {
+    MemoryStreamGet, MemoryStreamUnGet, MemoryStreamPeek, StreamPosition};
+
+/* strings move with the heap, so they are reached through their stack slot
+ * on every byte instead of through a base pointer */
+static uint8_t StringStreamGet(LispStream *s) {
+  return (s->pos < s->end)
+             ? (uint8_t)stack[s->slot]->string.self[s->pos++]
+             : EOF;
+}
+static LispIndex StringStreamPeek(LispStream *s, uint8_t *buf, LispIndex n) {
+  if (n > s->end - s->pos) {
+    n = (LispIndex)(s->end - s->pos);
+  }
+  memcpy(buf, stack[s->slot]->string.self + s->pos, n);
+  return n;
+}
+static const LispStreamOps string_stream_ops = {
+    StringStreamGet, MemoryStreamUnGet, StringStreamPeek, StreamPosition};
+
+LispStream lisp_tib_stream = {&tib_stream_ops, NULL, 0, 0, 0};
+LispStream *read_stream = &lisp_tib_stream;
+
+void LispStreamInitMemory(LispStream *s, const uint8_t *base, uint32_t len) {
+  s->ops = &memory_stream_ops;
+  s->base = base;
+  s->slot = 0;
+  s->pos = 0;
+  s->end = len;
+}
+void LispStreamInitString(LispStream *s, LispIndex slot, uint32_t start) {
+  s->ops = &string_stream_ops;
+  s->base = NULL;
+  s->slot = slot;
+  s->end = ToString(stack[slot], "string-stream")->size;
+  s->pos = (start < s->end) ? start : s->end;
+}
+
+/* get char, memory streams skip the indirect call */
+static inline uint8_t GetChar() {
+  LispStream *s = read_stream;
+  if (s->base != NULL) {
+    return (s->pos < s->end) ? s->base[s->pos++] : EOF;
+  }
+  return s->ops->get(s);
+}
+static inline void UnGetChar() {
+  LispStream *s = read_stream;
+  s->ops->unget(s);
+}
 
 uint8_t UTF8SeqLen(const uint8_t c) { return trailing_bytes_for_utf8[c] + 1; }
 
@@ -172,17 +281,17 @@ char nextchar() {
 
   do {
     ch = GetChar();
-    if (ch == EOF) return 0;
+    if (ch == EOF) return (char)EOF;
     c = (char)ch;
     if (c == ';') {
       // single-line comment
       do {
         ch = GetChar();
-        if (ch == EOF) return 0;
+        if (ch == EOF) return (char)EOF;
       } while ((char)ch != '\n');
       c = (char)ch;
     }
-  } while (isspace(c));
+  } while (CHAR_CLASS(c) & kCharSpace);
   return c;
 }
 
@@ -195,38 +304,272 @@ void accumchar(char c, LispIndex *pi) {
   }
 }
 
-/* return: true for dot token, false for symbol */
+/* The token read last: a slice of a memory stream when it could be, else of
+ * scratch_pad, with the integer it spells when tok_number, or the float
+ * when tok_float; tok_escaped when it had | or \ */
+static const char *tok_name;
+static LispIndex tok_len;
+static LispFixNum tok_integer;
+static bool tok_number, tok_escaped, tok_fixnum;
+static FloatKind tok_float;
+static float tok_single;
+static double tok_double;
+
+/* integer syntax: [+-]digits, [+-]0x hex, [+-]0 octal, 0b binary */
+typedef enum { kNumStart, kNumSign, kNumZero, kNumDigits, kNumBad } NumState;
+typedef struct {
+  NumState state;
+  uint8_t base;
+  bool neg;
+  bool sign;
+  bool overflow; /* value past 64 bits, the digits are still checked */
+  LispIndex ndigits;
+  uint64_t value;
+} NumScan;
+
+static inline void NumAccum(NumScan *n, uint8_t c) {
+  uint8_t d;
+  switch (n->state) {
+    case kNumBad:
+      return;
+    case kNumStart:
+      if (c == '-' || c == '+') {
+        n->neg = (c == '-');
+        n->sign = true;
+        n->state = kNumSign;
+        return;
+      }
+      /* fall through */
+    case kNumSign:
+      if (c == '0') {
+        n->state = kNumZero;
+        n->base = 8;
+        ++n->ndigits;
+        return;
+      }
+      n->base = 10;
+      n->state = kNumDigits;
+      break;
+    case kNumZero:
+      /* the radix prefix, 0b only without a sign */
+      n->state = kNumDigits;
+      if (c == 'x' || c == 'X' || (c == 'b' && !n->sign)) {
+        n->base = (c == 'b') ? 2 : 16;
+        n->ndigits = 0;
+        return;
+      }
+      break;
+    case kNumDigits:
+      break;
+  }
+  if (CHAR_CLASS(c) & kCharDigit) {
+    d = (uint8_t)(c - '0');
+  } else if (CHAR_CLASS(c) & kCharHex) {
+    d = (uint8_t)((c | 0x20) - 'a' + 10);
+  } else {
+    d = 0xff;
+  }
+  if (d >= n->base) {
+    n->state = kNumBad;
+    return;
+  }
+  /* the division only for values near the top */
+  if (n->value > UINT64_MAX / 16 && n->value > (UINT64_MAX - d) / n->base) {
+    n->overflow = true;
+  }
+  n->value = n->value * n->base + d;
+  ++n->ndigits;
+}
+
+/* Scan the token starting with c (already consumed) in one pass, stopping
+ * before the first character that cannot be part of it; digits: only digits
+ * can. Returns true for a lone dot. */
 bool read_token(char c, bool digits) {
-  LispIndex i = 0, escaped = 0, dot = (c == '.'), totread = 0;
-  uint8_t ch;
+  LispStream *s = read_stream;
+  LispIndex i = 0, escaped = 0;
+  bool slice = (s->base != NULL), escapes = false;
+  uint32_t start = s->pos - 1;
+  NumScan num = {kNumStart, 0, false, false, false, 0, 0};
+  uint8_t ch = (uint8_t)c;
 
-  UnGetChar();
-  while (1) {
-    ch = GetChar();
-    totread++;
-    if (ch == EOF) goto terminate;
-    c = (char)ch;
-    if (c == '|') {
-      escaped = !escaped;
-    } else if (c == '\\') {
-      ch = GetChar();
-      if (ch == EOF) goto terminate;
-      accumchar((char)ch, &i);
-    } else if (!escaped && !(SymCharP(c) && (!digits || isdigit(c)))) {
+  if (digits) {
+    num.state = kNumDigits;
+    num.base = 10;
+  }
+
+  for (;;) {
+    if (ch == '|' || ch == '\\') {
+      escapes = true;
+      if (slice) {
+        /* escapes change the name, it has to be copied after all */
+        slice = false;
+        while (start + i < s->pos - 1) {
+          accumchar((char)s->base[start + i], &i);
+        }
+      }
+      if (ch == '|') {
+        escaped = !escaped;
+      } else {
+        ch = GetChar();
+        if (ch == EOF) break;
+        accumchar((char)ch, &i);
+      }
+    } else if (!escaped &&
+               ((CHAR_CLASS(ch) & (kCharSpace | kCharSpecial)) ||
+                (digits && !(CHAR_CLASS(ch) & kCharDigit)))) {
+      UnGetChar();
       break;
     } else {
-      accumchar(c, &i);
+      NumAccum(&num, ch);
+      if (!slice) {
+        accumchar((char)ch, &i);
+      }
+    }
+    ch = GetChar();
+    if (ch == EOF) break;
+  }
+  if (slice) {
+    tok_name = (const char *)s->base + start;
+    tok_len = (LispIndex)(s->pos - start);
+  } else {
+    tok_name = (const char *)scratch_pad;
+    tok_len = i;
+  }
+  tok_escaped = escapes;
+  tok_number = !escapes && num.ndigits > 0 &&
+               (num.state == kNumZero || num.state == kNumDigits);
+  tok_fixnum = !num.overflow &&
+               num.value <= (num.neg ? (uint64_t)LISP_FIXNUM_MAX + 1
+                                     : (uint64_t)LISP_FIXNUM_MAX);
+  tok_integer = (LispFixNum)(num.neg ? 0 - num.value : num.value);
+  if (tok_number && !tok_fixnum) {
+    /* past the fixnums a double, as the builtins give; a decimal is
+       rounded from its text, the other bases must fit 64 bits */
+    if (num.base == 10) {
+      tok_double = Integer2Double(tok_name, tok_len);
+    } else if (num.overflow) {
+      LispError("read: error: integer too large\n");
+    } else {
+      tok_double = num.neg ? -(double)num.value : (double)num.value;
+    }
+  }
+  tok_float = (tok_number || escapes || digits)
+                  ? kFloatNone
+                  : Str2Float(tok_name, tok_len, &tok_single, &tok_double);
+  return (!escapes && tok_len == 1 && tok_name[0] == '.');
+}
+
+/* The string literal after the opening quote, built straight in the heap:
+ * runs of a memory stream are copied whole, and the buffer grows in place
+ * at the top of the heap */
+static LispObject read_string(void) {
+  LispStream *s = read_stream;
+  LispIndex slot = (LispIndex)stack_index;
+  uint32_t n = 0, run;
+  uint8_t c;
+  PUSH(LispAllocString(16));
+  for (;;) {
+    run = 0;
+    if (s->base != NULL) {
+      while (s->pos + run < s->end && s->base[s->pos + run] != '"' &&
+             s->base[s->pos + run] != '\\') {
+        ++run;
+      }
+    }
+    if (n + run + 1 > stack[slot]->string.size) {
+      /* grown in place it costs no copy, so only what is needed */
+      uint32_t size = (n + run + 32) & ~31U;
+      if (size > (LispIndex)-1) {
+        LispError("read: error: string too long\n");
+      }
+      stack[slot] = LispStringResize(stack[slot], (LispIndex)size);
+    }
+    if (run) {
+      memcpy(stack[slot]->string.self + n, s->base + s->pos, run);
+      s->pos += run;
+      n += run;
+    }
+    c = GetChar();
+    if (c == '\\') {
+      c = GetChar();
+      if (c == 'n') {
+        c = '\n';
+      } else if (c == 't') {
+        c = '\t';
+      } else if (c == 'r') {
+        c = '\r';
+      }
+    } else if (c == '"') {
+      break;
     }
+    if (c == EOF) {
+      LispError("read: error: end of input in string\n");
+    }
+    stack[slot]->string.self[n++] = (char)c;
+  }
+  stack[slot] = LispStringResize(stack[slot], (LispIndex)n);
+  return POP();
+}
+
+/* The bits after #*, bit 0 first; #* alone is the empty bit vector */
+static LispObject read_bit_vector(void) {
+  LispObject bv;
+  LispIndex i;
+  uint8_t c = GetChar();
+  if (c == EOF || (CHAR_CLASS(c) & (kCharSpace | kCharSpecial))) {
+    if (c != EOF) UnGetChar();
+    return LispMakeBitVector(0);
+  }
+  read_token((char)c, false);
+  for (i = 0; i < tok_len; ++i) {
+    if (tok_name[i] != '0' && tok_name[i] != '1') {
+      LispError("read: error: invalid bit vector\n");
+    }
+  }
+  bv = LispMakeBitVector(tok_len);
+  for (i = 0; i < tok_len; ++i) {
+    bv->bit_vector.self[i >> 3] |= (uint8_t)((tok_name[i] - '0') << (i & 7));
+  }
+  return bv;
+}
+
+/* Fixed point numbers are decimals ending in q15 or q31, e.g. -0.25q15 */
+static bool read_fixed(void) {
+  int32_t x;
+  uint8_t n;
+  if (tok_escaped || tok_len < 4 || tok_name[tok_len - 3] != 'q') {
+    return false;
+  }
+  if (memcmp(tok_name + tok_len - 2, "15", 2) == 0) {
+    n = 15;
+  } else if (memcmp(tok_name + tok_len - 2, "31", 2) == 0) {
+    n = 31;
+  } else {
+    return false;
+  }
+  if (!Str2Fixed(tok_name, (LispIndex)(tok_len - 3), n, &x)) {
+    return false;
+  }
+  toktype = kTokNum;
+  tokval = (n == 15) ? LISP_MAKE_Q15(x) : LispMakeQ31(x);
+  return true;
+}
+
+static void read_float_or_symbol(void) {
+  if (tok_float == kFloatSingle) {
+    toktype = kTokSingleFloat;
+    tokval = LispMakeSingleFloat(tok_single);
+  } else if (tok_float == kFloatDouble) {
+    toktype = kTokDoubleFloat;
+    tokval = LispMakeDoubleFloat(tok_double);
+  } else if (!read_fixed()) {
+    toktype = kTokSym;
+    tokval = LispMakeSymbolN(tok_name, tok_len);
   }
-  UnGetChar();
-terminate:
-  scratch_pad[i++] = '\0';
-  return (dot && (totread == 2));
 }
 
 LispTokenType peek() {
-  uint8_t c, *end;
-  LispFixNum x;
+  uint8_t c;
 
   if (toktype != kTokNone) return toktype;
   c = nextchar();
@@ -239,10 +582,18 @@ LispTokenType peek() {
     toktype = kTokQuote;
   } else if (c == '`') {
     toktype = kTokBackQuote;
+  } else if (c == '"') {
+    toktype = kTokString;
+    tokval = read_string();
   } else if (c == '#') {
     c = GetChar();
     if (c == EOF) LispError("read: error: invalid read macro\n");
-    if ((char)c == '.') {
+    if ((char)c == '(') {
+      toktype = kTokVector;
+    } else if ((char)c == '*') {
+      toktype = kTokBitVector;
+      tokval = read_bit_vector();
+    } else if ((char)c == '.') {
       toktype = kTokSharpDot;
     } else if ((char)c == '\'') {
       toktype = kTokSharpQuote;
@@ -250,7 +601,7 @@ LispTokenType peek() {
       /* FixMe: */
       toktype = kTokNum;
       tokval = LISP_MAKE_CHARACTER(UTF8GetChar());
-    } else if (isdigit(c)) {
+    } else if (CHAR_CLASS(c) & kCharDigit) {
       read_token((char)c, true);
       c = GetChar();
       if (c == '#')
@@ -259,11 +610,10 @@ LispTokenType peek() {
         toktype = kTokLabel;
       else
         LispError("read: error: invalid label\n");
-      x = strtol((char *)scratch_pad, (char **)&end, 10);
-      if (*end != '\0') {
+      if (!tok_number || !tok_fixnum) {
         LispError("read: error: invalid label\n");
       }
-      tokval = LISP_MAKE_FIXNUM(x);
+      tokval = LISP_MAKE_FIXNUM(tok_integer);
     } else {
       LispError("read: error: unknown read macro\n");
     }
@@ -277,26 +627,22 @@ LispTokenType peek() {
       toktype = kTokCommaDot;
     else
       UnGetChar();
-  } else if (isdigit(c) || c == '-' || c == '+') {
-    read_token(c, false);
-    if (c == '0' && (scratch_pad[1] == 'b')) {
-      x = strtol((char *)scratch_pad + 2, (char **)&end, 2);
-    } else {
-      x = strtol((char *)scratch_pad, (char **)&end, 0);
-    }
-    if (*end != '\0') {
-      toktype = kTokSym;
-      tokval = LispMakeSymbol((char *)scratch_pad);
-    } else {
+  } else if ((CHAR_CLASS(c) & kCharDigit) || c == '-' || c == '+') {
+    read_token((char)c, false);
+    if (tok_number && !tok_fixnum) {
+      toktype = kTokDoubleFloat;
+      tokval = LispMakeDoubleFloat(tok_double);
+    } else if (tok_number) {
       toktype = kTokNum;
-      tokval = LISP_MAKE_FIXNUM(x);
+      tokval = LISP_MAKE_FIXNUM(tok_integer);
+    } else {
+      read_float_or_symbol();
     }
   } else {
     if (read_token(c, false)) {
       toktype = kTokDot;
     } else {
-      toktype = kTokSym;
-      tokval = LispMakeSymbol((char *)scratch_pad);
+      read_float_or_symbol();
     }
   }
   return toktype;
@@ -315,10 +661,12 @@ void read_list(LispObject *pval, LispIndex fixup) {
   pc = &stack[stack_index - 1];  // to keep track of current cons cell
   t = peek();
   while (t != kTokClose) {
-    if (t == EOF) {
+    if (t == kTokNone) {
       LispError("read: error: unexpected end of input\n");
     }
+    PUSH(tokval); /* the peeked symbol moves if MakeCons collects */
     c = MakeCons();
+    tokval = POP();
     LISP_CONS_CAR(c) = LISP_CONS_CDR(c) = LISP_NIL;
     if (LISP_ConsP(*pc)) {
       LISP_CONS_CDR(*pc) = c;
@@ -338,7 +686,7 @@ void read_list(LispObject *pval, LispIndex fixup) {
       c = do_read_sexpr(NOTFOUND);
       LISP_CONS_CDR(*pc) = c;
       t = peek();
-      if (t == EOF) {
+      if (t == kTokNone) {
         LispError("read: error: unexpected end of input\n");
       }
       if (t != kTokClose) {
@@ -350,6 +698,35 @@ void read_list(LispObject *pval, LispIndex fixup) {
   POPN(1);
 }
 
+/* the elements of #( up to the closing paren. A label on the vector names
+ * its first allocation while the elements are read; if pushing moved the
+ * vector, the references to that in what was read are forwarded at the end */
+static LispObject read_vector(LispIndex fixup) {
+  LispObject v;
+  uint32_t t;
+  v = LispMakeVector(4);
+  PUSH(v); /* the first */
+  PUSH(v); /* the one to fill */
+  if (fixup != NOTFOUND) {
+    read_state->exprs.items->vector.self[fixup] = stack[stack_index - 1];
+  }
+  while ((t = peek()) != kTokClose) {
+    if (t == kTokNone) {
+      LispError("read: error: unexpected end of input\n");
+    }
+    v = do_read_sexpr(NOTFOUND);
+    stack[stack_index - 1] = LispVectorPush(stack[stack_index - 1], v);
+  }
+  take();
+  v = POP();
+  if (fixup != NOTFOUND && v != stack[stack_index - 1]) {
+    GcForwardAbove(stack[stack_index - 1], v);
+    read_state->exprs.items->vector.self[fixup] = v;
+  }
+  POPN(1);
+  return v;
+}
+
 /* fixup is the index of the label we'd like to fix up with this read */
 LispObject do_read_sexpr(LispIndex fixup) {
   LispObject v = LISP_NIL, head;
@@ -367,7 +744,11 @@ LispObject do_read_sexpr(LispIndex fixup) {
       break;
     }
     case kTokSym:
-    case kTokNum: {
+    case kTokNum:
+    case kTokString:
+    case kTokBitVector:
+    case kTokSingleFloat:
+    case kTokDoubleFloat: {
       v = tokval;
       break;
     }
@@ -406,6 +787,10 @@ LispObject do_read_sexpr(LispIndex fixup) {
       v = POP();
       break;
     }
+    case kTokVector: {
+      v = read_vector(fixup);
+      break;
+    }
     case kTokSharpDot: {
       /* eval-when-read */
       /*   evaluated expressions can refer to existing backreferences, but they
@@ -420,6 +805,7 @@ LispObject do_read_sexpr(LispIndex fixup) {
     case kTokLabel: {
       /* create backreference label */
       if (LabelTableLookUp(&read_state->labels, tokval) != NOTFOUND) {
+        LispErrorBegin();
         LispPrintStr("read: error: label ");
         LispPrintObject(tokval, false);
         LispError(" redefined\n");
@@ -436,6 +822,7 @@ LispObject do_read_sexpr(LispIndex fixup) {
       i = LabelTableLookUp(&read_state->labels, tokval);
       if (i == NOTFOUND || i >= read_state->exprs.items->vector.fillp ||
           read_state->exprs.items->vector.self[i] == LISP_UNBOUND) {
+        LispErrorBegin();
         LispPrintStr("read: error: undefined label ");
         LispPrintObject(tokval, false);
         LispError("\n");
@@ -462,7 +849,7 @@ LispObject do_read_sexpr(LispIndex fixup) {
   }
   return v;
 }
-LispObject ReadSexpr() {
+LispObject ReadSexpr(LispStream *s) {
   /* static structs */
   /* struct LispVector8 {  /\*  vector header  *\/ */
   /*   _LISP_HDR;          /\*  array element type*\/ */
@@ -476,16 +863,157 @@ LispObject ReadSexpr() {
 
   LispObject v;
   ReadState state;
+  LispStream *prev_stream = read_stream;
+  LispTokenType prev_toktype = toktype;
+  if (s != prev_stream) {
+    /* a lookahead token belongs to the stream it came from */
+    PUSH(tokval);
+    toktype = kTokNone;
+    read_stream = s;
+  }
   state.prev = read_state;
+  /* rooted before allocating, the second table may collect the first */
+  state.labels.items = state.labels.index = LISP_NIL;
+  state.exprs.items = state.exprs.index = LISP_NIL;
+  read_state = &state;
   LabelTableInit(&state.labels, 8);
   LabelTableInit(&state.exprs, 8);
-  /* FIXME: check labels are working correctly */
-  /* state.labels.items = (LispObject)&vec1; */
-  /* state.exprs.items = (LispObject)&vec2; */
-  read_state = &state;
 
-  v = do_read_sexpr(NOTFOUND);
+  v = (peek() == kTokNone) ? LISP_UNBOUND : do_read_sexpr(NOTFOUND);
 
   read_state = state.prev;
+  if (s != prev_stream) {
+    read_stream = prev_stream;
+    toktype = prev_toktype;
+    tokval = POP();
+  }
   return v;
 }
+LispObject LispLoad(LispStream *s) {
+  LispObject v;
+  PUSH(LISP_NIL);
+  while ((v = ReadSexpr(s)) != LISP_UNBOUND) {
+    stack[stack_index - 1] = TopLevelEval(v);
+  }
+  return POP();
+}
+
+/* Incremental reader */
+void LispReaderInit(LispReader *r) { memset(r, 0, sizeof(*r)); }
+static void ReaderAppend(LispReader *r, uint8_t c) {
+  LispIndex size = LISP_NULL(read_buffer) ? 0 : read_buffer->string.size;
+  if (r->fill == size) {
+    LispObject s;
+    if (size >= ((LispIndex)-1 >> 1)) {
+      LispReaderInit(r);
+      LispError("read: error: form too long\n");
+    }
+    s = LispAllocString((LispIndex)(size ? size << 1 : 64));
+    if (r->fill) {
+      memcpy(s->string.self, read_buffer->string.self, r->fill);
+    }
+    read_buffer = s;
+  }
+  read_buffer->string.self[r->fill++] = (char)c;
+}
+/* A token that only prefixes the next datum: # before ' ( or |, and #. */
+static inline bool ReaderPrefixToken(LispReader *r) {
+  return r->tok_first == '#' &&
+         (r->tok_len == 1 || (r->tok_len == 2 && r->tok_last == '.'));
+}
+/* Ends the current token, true when that ends the form too */
+static bool ReaderEndToken(LispReader *r) {
+  bool done = r->token && r->depth == 0 && !ReaderPrefixToken(r);
+  r->token = false;
+  return done;
+}
+static void ReaderTokenChar(LispReader *r, uint8_t c) {
+  if (c == '=' && r->token && r->tok_first == '#') {
+    /* #n= labels what follows, which is scanned as a token of its own */
+    r->token = false;
+    return;
+  }
+  if (!r->token) {
+    r->token = true;
+    r->tok_first = c;
+    r->tok_len = 0;
+  }
+  r->tok_last = c;
+  if (r->tok_len < (LispIndex)-1) {
+    ++r->tok_len;
+  }
+}
+
+/* Takes the bytes already in the terminal buffer without ever waiting; the
+ * text so far stays in read_buffer, so the caller is free to do other work
+ * between calls. Returns kReadForm with the parsed form once one is whole. */
+LispReadStatus LispReaderPoll(LispReader *r, LispObject *form) {
+  LispStream s;
+  uint32_t fill;
+  bool done = false;
+  while (!done && !TibEmpty()) {
+    uint8_t c = terminal_buffer[terminal_buffer_get_index];
+    bool keep = true;
+    if (r->comment) {
+      keep = false;
+      r->comment = (c != '\n');
+    } else if (r->escape) {
+      r->escape = false;
+      r->tok_last = 0;
+    } else if (r->bar) {
+      r->bar = (c != '|');
+      r->escape = (c == '\\');
+    } else if (r->quote) {
+      r->quote = (c != '"');
+      r->escape = (c == '\\');
+      done = (!r->quote && r->depth == 0);
+    } else if (CHAR_CLASS(c) & kCharSpace) {
+      done = ReaderEndToken(r);
+      keep = (r->fill != 0);
+    } else if (c == '\\' || c == '|') {
+      ReaderTokenChar(r, c);
+      r->escape = (c == '\\');
+      r->bar = (c == '|');
+    } else if (CHAR_CLASS(c) & kCharSpecial) {
+      if (ReaderEndToken(r)) {
+        /* the atom is whole, this byte belongs to what follows it */
+        done = true;
+        break;
+      }
+      if (c == ';') {
+        keep = false;
+        r->comment = true;
+      } else if (c == '"') {
+        r->quote = true;
+      } else if (c == '(') {
+        ++r->depth;
+      } else if (c == ')') {
+        /* a stray ) is left for the parser to complain about */
+        done = (r->depth <= 1);
+        r->depth = r->depth ? (LispIndex)(r->depth - 1) : 0;
+      }
+    } else {
+      ReaderTokenChar(r, c);
+    }
+    if (keep) {
+      ReaderAppend(r, c);
+    }
+    ++terminal_buffer_get_index;
+    terminal_buffer_get_index &= (TIB_SIZE - 1);
+  }
+  if (!done) {
+    return kReadMore;
+  }
+  fill = r->fill;
+  LispReaderInit(r);
+  PUSH(read_buffer);
+  LispStreamInitString(&s, stack_index - 1, 0);
+  s.end = fill;
+  *form = ReadSexpr(&s);
+  POPN(1);
+  if (read_buffer->string.size > 64) {
+    /* the heap is small, only keep a buffer for everyday forms */
+    read_buffer = LISP_NIL;
+  }
+  return (*form == LISP_UNBOUND) ? kReadMore : kReadForm;
+}
@@ -66,8 +66,47 @@
 #define UEOF ((uint32_t)-1)
 #define EOF ((uint8_t)-1)
 
+/* Input streams, the reader pulls bytes through the ops of read_stream */
+typedef struct _LispStream LispStream;
+typedef struct {
+  uint8_t (*get)(LispStream *s); /* next byte, EOF at the end */
+  void (*unget)(LispStream *s);  /* step back over the last byte got */
+  /* copy up to n bytes ahead without consuming them, returns the count */
+  LispIndex (*peek)(LispStream *s, uint8_t *buf, LispIndex n);
+  uint32_t (*position)(LispStream *s); /* bytes consumed so far */
+} LispStreamOps;
+struct _LispStream {
+  const LispStreamOps *ops;
+  const uint8_t *base; /* memory streams: the bytes, read inline */
+  LispIndex slot;      /* string streams: stack slot holding the string */
+  uint32_t pos;
+  uint32_t end;
+};
+extern LispStream lisp_tib_stream; /* the uart terminal input buffer */
+extern LispStream *read_stream;    /* stream of the read in progress */
+void LispStreamInitMemory(LispStream *s, const uint8_t *base, uint32_t len);
+/* the string must stay in stack[slot] while the stream is used, it moves */
+void LispStreamInitString(LispStream *s, LispIndex slot, uint32_t start);
+
+/* Non-blocking reader over the terminal buffer: LispReaderPoll takes the
+   bytes already received into read_buffer, following just enough syntax to
+   see where a top level form ends, and parses the form once it is whole */
+typedef enum { kReadMore, kReadForm } LispReadStatus;
+typedef struct {
+  uint32_t fill;   /* bytes of read_buffer in use */
+  LispIndex depth; /* open parens */
+  LispIndex tok_len;
+  uint8_t tok_first, tok_last;
+  bool token, bar, quote, escape, comment;
+} LispReader;
+void LispReaderInit(LispReader *r);
+LispReadStatus LispReaderPoll(LispReader *r, LispObject *form);
+
 /* Lexical analyzer         input string --> tokens */
-LispObject ReadSexpr();
+/* returns LISP_UNBOUND at the end of the stream */
+LispObject ReadSexpr(LispStream *s);
+/* read and evaluate every form of s, returns the last value */
+LispObject LispLoad(LispStream *s);
 bool SymCharP(char c);
 
 #endif /* LISPDOOR_READ_H_INCLUDED */
@@ -68,19 +68,26 @@
 #include "lispdoor/objects.h"
 #include "lispdoor/print.h"
 
-static inline int32_t SymbolArrayCompare(const void *a, const void *b) {
-  return strcmp(((LispObject)a)->symbol.name, ((LispObject)b)->symbol.name);
+/* compare the name slice (not NUL terminated) with a symbol name */
+static inline int32_t SymbolNameCompare(const char *name, LispIndex len,
+                                        const char *sym_name) {
+  int32_t x = strncmp(name, sym_name, len);
+  if (x == 0 && sym_name[len] != '\0') {
+    return -1; /* name is a proper prefix of sym_name */
+  }
+  return x;
 }
 
 /* A iterative binary search function. It returns */
 /* location of x in given array arr[l..r] if present, */
-/* otherwise -1 */
+/* otherwise -1, *insert is where it would go */
 int32_t SymbolArrayBinarySearch(LispObject arr[], int32_t l, int32_t r,
-                                char name[]) {
+                                const char *name, LispIndex len,
+                                int32_t *insert) {
   while (l <= r) {
     int32_t m = l + (r - l) / 2;
 
-    int32_t x = strcmp(name, arr[m]->symbol.name);
+    int32_t x = SymbolNameCompare(name, len, arr[m]->symbol.name);
     /* Check if name is present at mid */
     if (x == 0) {
       return m;
@@ -97,59 +104,38 @@ int32_t SymbolArrayBinarySearch(LispObject arr[], int32_t l, int32_t r,
 
   /* if we reach here, then element was */
   /* not present */
+  *insert = l;
   return -1;
 }
 
-static inline int32_t SymbolArrayLookUp(LispObject vec, char name[]) {
-  return SymbolArrayBinarySearch(vec->vector.self, 0, vec->vector.fillp - 1,
-                                 name);
-}
-
-void SymbolArraySwap(LispObject a[], int32_t n, int32_t m) {
-  if (n != m) {
-    LispObject tmp = a[n];
-    a[n] = a[m];
-    a[m] = tmp;
-  }
-}
-
-void SymbolArrayQuickSort(LispObject a[], int32_t n) {
-  while (n > 1) {
-    int32_t i;
-    int32_t last = 0;
-    SymbolArraySwap(a, 0, n / 2);
-    for (i = 1; i < n; i++) {
-      if (SymbolArrayCompare(a[i], a[0]) < 0) {
-        SymbolArraySwap(a, ++last, i);
-      }
-    }
-    SymbolArraySwap(a, 0, last);
-    /* TCO */
-    if (last > n - last - 1) {
-      SymbolArrayQuickSort(a + last + 1, n - last - 1);
-      n = last;
-    } else {
-      SymbolArrayQuickSort(a, last);
-      a = a + last + 1;
-      n = n - last - 1;
-    }
-  }
-}
-
-LispObject LispMakeSymbol(char *str) {
-  int32_t index;
+LispObject LispMakeSymbolN(const char *name, LispIndex len) {
+  int32_t index, insert;
   LispObject *symbols_vector = &LispEnv()->symbols;
+  LispObject *self;
 
-  index = SymbolArrayLookUp(*symbols_vector, str);
+  index = SymbolArrayBinarySearch((*symbols_vector)->vector.self, 0,
+                                  (*symbols_vector)->vector.fillp - 1, name,
+                                  len, &insert);
   if (index == -1) {
-    LispObject sym = LispAllocObject(kSymbol, (LispIndex)strlen(str));
+    /* name is not in the heap, the allocations cannot move it */
+    LispObject sym = LispAllocObject(kSymbol, len);
     sym->symbol.value = LISP_UNBOUND;
     sym->symbol.stype = kSymOrdinary;
-    strcpy(sym->symbol.name, str);
+    memcpy(sym->symbol.name, name, len);
+    sym->symbol.name[len] = '\0';
     *symbols_vector = LispVectorPush(*symbols_vector, sym);
-    SymbolArrayQuickSort((*symbols_vector)->vector.self,
-                         (*symbols_vector)->vector.fillp);
-    index = SymbolArrayLookUp(*symbols_vector, str);
+    /* keep the table sorted: shift the tail up over the pushed slot */
+    self = (*symbols_vector)->vector.self;
+    sym = self[(*symbols_vector)->vector.fillp - 1];
+    memmove(&self[insert + 1], &self[insert],
+            sizeof(LispObject) *
+                (size_t)((*symbols_vector)->vector.fillp - 1 - insert));
+    self[insert] = sym;
+    index = insert;
   }
   return (*symbols_vector)->vector.self[index];
 }
+
+LispObject LispMakeSymbol(char *str) {
+  return LispMakeSymbolN(str, (LispIndex)strlen(str));
+}
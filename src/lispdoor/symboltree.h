@@ -65,5 +65,7 @@
 #include "lispdoor/objects.h"
 
 LispObject LispMakeSymbol(char *str);
+/* intern a name slice, it needs no NUL terminator */
+LispObject LispMakeSymbolN(const char *name, LispIndex len);
 
 #endif /* LISPDOOR_SYMBOLTREE_H_INCLUDED */
@@ -65,60 +65,38 @@
 #include "lispdoor/gc.h"
 #include "lispdoor/memorylayout.h"
 #include "lispdoor/print.h"
-/* largest number for double is 2^53 = 9 * 10^15. */
-uint8_t Log10(uint64_t v) {
-  return (v >= 10000000000000000u)
-             ? 16
-             : (v >= 1000000000000000u)
-                   ? 15
-                   : (v >= 100000000000000u)
-                         ? 14
-                         : (v >= 10000000000000u)
-                               ? 13
-                               : (v >= 1000000000000u)
-                                     ? 12
-                                     : (v >= 100000000000u)
-                                           ? 11
-                                           : (v >= 10000000000u)
-                                                 ? 10
-                                                 : (v >= 1000000000u)
-                                                       ? 9
-                                                       : (v >= 100000000u)
-                                                             ? 8
-                                                             : (v >= 10000000u)
-                                                                   ? 7
-                                                                   : (v >=
-                                                                      1000000u)
-                                                                         ? 6
-                                                                         : (v >=
-                                                                            100000u)
-                                                                               ? 5
-                                                                               : (v >=
-                                                                                  10000u)
-                                                                                     ? 4
-                                                                                     : (v >=
-                                                                                        1000u)
-                                                                                           ? 3
-                                                                                           : (v >=
-                                                                                              100u)
-                                                                                                 ? 2
-                                                                                                 : (v >=
-                                                                                                    10u)
-                                                                                                       ? 1u
-                                                                                                       : 0u;
-}
-char *Uint642Str(char *dest, LispIndex len, uint64_t num) {
-  LispFixNum i = (LispFixNum)len - 1;
+/* Integers */
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+
+char *Uint2Str(char *dest, LispIndex len, uintptr_t num, Byte base) {
+  int16_t i = (int16_t)len - 1;
   char ch;
   dest[i--] = '\0';
+  if (base == 10) {
+    /* two digits per division */
+    while (num >= 100 && i >= 1) {
+      const char *pair = &digit_pairs[(num % 100) << 1];
+      num /= 100;
+      dest[i--] = pair[1];
+      dest[i--] = pair[0];
+    }
+    if (num >= 10 && i >= 1) {
+      dest[i--] = digit_pairs[(num << 1) + 1];
+      dest[i--] = digit_pairs[num << 1];
+      return &dest[i + 1];
+    }
+  }
   while (i >= 0) {
-    ch = (char)(num % 10);
+    ch = (char)(num % base);
     if (ch < 10)
       ch += '0';
     else
       ch = ch - 10 + 'a';
     dest[i--] = ch;
-    num /= 10;
+    num /= base;
     if (num == 0) break;
   }
   if (num != 0) {
@@ -126,152 +104,1112 @@ char *Uint642Str(char *dest, LispIndex len, uint64_t num) {
   }
   return &dest[i + 1];
 }
-char *Double2Str(char *str, LispIndex len, double f, uint8_t precision) {
-  uint8_t i, digit;
-  const double epsilon = 1e-5;
-  bool is_negative = f < 0;
-  if (is_negative) {
-    f = -f;
-  }
-  /* split f to integer and fraction */
-  uint64_t integer_part = (uint64_t)f;
-  f -= (double)integer_part;
-  uint8_t number_of_digits = 1 + Log10(integer_part);
-  if (is_negative) {
-    str[0] = '-';
-    str++;
-    len--;
-  }
-  /* write decimal value to string */
-  if (++number_of_digits > len) {
+char *Int2Str(char *dest, LispIndex len, LispFixNum num, Byte base) {
+  char *s = Uint2Str(dest, len,
+                     num < 0 ? (uintptr_t)0 - (uintptr_t)num : (uintptr_t)num,
+                     base);
+  if (num < 0) {
+    if (s > dest) {
+      *--s = '-';
+    } else {
+      LispPrintStr("warning: negative sign trancated\n");
+    }
+  }
+  return s;
+}
+
+/* Floats: shortest digits that read back to the same value, by Grisu2
+ * (Loitsch, "Printing floating-point numbers quickly and accurately with
+ * integers") in 64 bit integer arithmetic, so no FPU or libc is involved */
+typedef struct {
+  uint64_t f;
+  int16_t e;
+} DiyFp;
+
+static DiyFp DiyFpMul(DiyFp x, DiyFp y) {
+  const uint64_t m32 = 0xFFFFFFFFU;
+  uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t mid = (bd >> 32) + (ad & m32) + (bc & m32) + (1U << 31);
+  DiyFp r = {ac + (ad >> 32) + (bc >> 32) + (mid >> 32),
+             (int16_t)(x.e + y.e + 64)};
+  return r;
+}
+static DiyFp DiyFpNormalize(DiyFp x) {
+  int s = __builtin_clzll(x.f);
+  x.f <<= s;
+  x.e = (int16_t)(x.e - s);
+  return x;
+}
+
+/* 10^k for k = -348, -340, ..., 340 with 64 bit significands */
+static const struct {
+  uint64_t f;
+  int16_t e;
+} cached_powers[87] = {
+    {0xfa8fd5a0081c0288ULL, -1220},
+    {0xbaaee17fa23ebf76ULL, -1193},
+    {0x8b16fb203055ac76ULL, -1166},
+    {0xcf42894a5dce35eaULL, -1140},
+    {0x9a6bb0aa55653b2dULL, -1113},
+    {0xe61acf033d1a45dfULL, -1087},
+    {0xab70fe17c79ac6caULL, -1060},
+    {0xff77b1fcbebcdc4fULL, -1034},
+    {0xbe5691ef416bd60cULL, -1007},
+    {0x8dd01fad907ffc3cULL, -980},
+    {0xd3515c2831559a83ULL, -954},
+    {0x9d71ac8fada6c9b5ULL, -927},
+    {0xea9c227723ee8bcbULL, -901},
+    {0xaecc49914078536dULL, -874},
+    {0x823c12795db6ce57ULL, -847},
+    {0xc21094364dfb5637ULL, -821},
+    {0x9096ea6f3848984fULL, -794},
+    {0xd77485cb25823ac7ULL, -768},
+    {0xa086cfcd97bf97f4ULL, -741},
+    {0xef340a98172aace5ULL, -715},
+    {0xb23867fb2a35b28eULL, -688},
+    {0x84c8d4dfd2c63f3bULL, -661},
+    {0xc5dd44271ad3cdbaULL, -635},
+    {0x936b9fcebb25c996ULL, -608},
+    {0xdbac6c247d62a584ULL, -582},
+    {0xa3ab66580d5fdaf6ULL, -555},
+    {0xf3e2f893dec3f126ULL, -529},
+    {0xb5b5ada8aaff80b8ULL, -502},
+    {0x87625f056c7c4a8bULL, -475},
+    {0xc9bcff6034c13053ULL, -449},
+    {0x964e858c91ba2655ULL, -422},
+    {0xdff9772470297ebdULL, -396},
+    {0xa6dfbd9fb8e5b88fULL, -369},
+    {0xf8a95fcf88747d94ULL, -343},
+    {0xb94470938fa89bcfULL, -316},
+    {0x8a08f0f8bf0f156bULL, -289},
+    {0xcdb02555653131b6ULL, -263},
+    {0x993fe2c6d07b7facULL, -236},
+    {0xe45c10c42a2b3b06ULL, -210},
+    {0xaa242499697392d3ULL, -183},
+    {0xfd87b5f28300ca0eULL, -157},
+    {0xbce5086492111aebULL, -130},
+    {0x8cbccc096f5088ccULL, -103},
+    {0xd1b71758e219652cULL, -77},
+    {0x9c40000000000000ULL, -50},
+    {0xe8d4a51000000000ULL, -24},
+    {0xad78ebc5ac620000ULL, 3},
+    {0x813f3978f8940984ULL, 30},
+    {0xc097ce7bc90715b3ULL, 56},
+    {0x8f7e32ce7bea5c70ULL, 83},
+    {0xd5d238a4abe98068ULL, 109},
+    {0x9f4f2726179a2245ULL, 136},
+    {0xed63a231d4c4fb27ULL, 162},
+    {0xb0de65388cc8ada8ULL, 189},
+    {0x83c7088e1aab65dbULL, 216},
+    {0xc45d1df942711d9aULL, 242},
+    {0x924d692ca61be758ULL, 269},
+    {0xda01ee641a708deaULL, 295},
+    {0xa26da3999aef774aULL, 322},
+    {0xf209787bb47d6b85ULL, 348},
+    {0xb454e4a179dd1877ULL, 375},
+    {0x865b86925b9bc5c2ULL, 402},
+    {0xc83553c5c8965d3dULL, 428},
+    {0x952ab45cfa97a0b3ULL, 455},
+    {0xde469fbd99a05fe3ULL, 481},
+    {0xa59bc234db398c25ULL, 508},
+    {0xf6c69a72a3989f5cULL, 534},
+    {0xb7dcbf5354e9beceULL, 561},
+    {0x88fcf317f22241e2ULL, 588},
+    {0xcc20ce9bd35c78a5ULL, 614},
+    {0x98165af37b2153dfULL, 641},
+    {0xe2a0b5dc971f303aULL, 667},
+    {0xa8d9d1535ce3b396ULL, 694},
+    {0xfb9b7cd9a4a7443cULL, 720},
+    {0xbb764c4ca7a44410ULL, 747},
+    {0x8bab8eefb6409c1aULL, 774},
+    {0xd01fef10a657842cULL, 800},
+    {0x9b10a4e5e9913129ULL, 827},
+    {0xe7109bfba19c0c9dULL, 853},
+    {0xac2820d9623bf429ULL, 880},
+    {0x80444b5e7aa7cf85ULL, 907},
+    {0xbf21e44003acdd2dULL, 933},
+    {0x8e679c2f5e44ff8fULL, 960},
+    {0xd433179d9c8cb841ULL, 986},
+    {0x9e19db92b4e31ba9ULL, 1013},
+    {0xeb96bf6ebadf77d9ULL, 1039},
+    {0xaf87023b9bf0ee6bULL, 1066}
+};
+/* c = 10^-k such that w * c has its binary exponent in [-60, -32] */
+static DiyFp CachedPower(int16_t e, int16_t *k) {
+  /* ceil((-61 - e) * log10(2)), (n * 78913) >> 18 is floor(n * log10(2))
+   * for 0 <= n <= 1650 */
+  int32_t n = -61 - e;
+  int32_t dk = (n > 0) ? (int32_t)(((uint32_t)n * 78913U) >> 18) + 1
+                       : -(int32_t)(((uint32_t)-n * 78913U) >> 18);
+  uint16_t index = (uint16_t)(((dk + 347) >> 3) + 1);
+  DiyFp c = {cached_powers[index].f, cached_powers[index].e};
+  *k = (int16_t)(348 - index * 8);
+  return c;
+}
+
+static const uint64_t pow10_u64[20] = {1ULL,
+                                       10ULL,
+                                       100ULL,
+                                       1000ULL,
+                                       10000ULL,
+                                       100000ULL,
+                                       1000000ULL,
+                                       10000000ULL,
+                                       100000000ULL,
+                                       1000000000ULL,
+                                       10000000000ULL,
+                                       100000000000ULL,
+                                       1000000000000ULL,
+                                       10000000000000ULL,
+                                       100000000000000ULL,
+                                       1000000000000000ULL,
+                                       10000000000000000ULL,
+                                       100000000000000000ULL,
+                                       1000000000000000000ULL,
+                                       10000000000000000000ULL};
+
+/* moves the last digit towards w while still inside the interval */
+static void GrisuRound(char *buf, uint8_t len, uint64_t delta, uint64_t rest,
+                       uint64_t ten_kappa, uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+static uint8_t GrisuDigits(DiyFp w, DiyFp mp, uint64_t delta, char *buf,
+                           int16_t *k) {
+  const uint8_t shift = (uint8_t)-mp.e;
+  const uint64_t one = 1ULL << shift;
+  const uint64_t wp_w = mp.f - w.f;
+  uint32_t p1 = (uint32_t)(mp.f >> shift);
+  uint64_t p2 = mp.f & (one - 1);
+  int8_t kappa = 10;
+  uint8_t len = 0;
+  while (kappa > 1 && p1 < pow10_u64[kappa - 1]) {
+    --kappa;
+  }
+  while (kappa > 0) {
+    uint32_t d = p1 / (uint32_t)pow10_u64[kappa - 1];
+    p1 %= (uint32_t)pow10_u64[kappa - 1];
+    if (d || len) {
+      buf[len++] = (char)('0' + d);
+    }
+    --kappa;
+    if ((((uint64_t)p1) << shift) + p2 <= delta) {
+      *k = (int16_t)(*k + kappa);
+      GrisuRound(buf, len, delta, (((uint64_t)p1) << shift) + p2,
+                 pow10_u64[kappa] << shift, wp_w);
+      return len;
+    }
+  }
+  while (1) {
+    char d;
+    p2 *= 10;
+    delta *= 10;
+    d = (char)(p2 >> shift);
+    if (d || len) {
+      buf[len++] = (char)('0' + d);
+    }
+    p2 &= one - 1;
+    --kappa;
+    if (p2 < delta) {
+      *k = (int16_t)(*k + kappa);
+      GrisuRound(buf, len, delta, p2, one, wp_w * pow10_u64[-kappa]);
+      return len;
+    }
+  }
+}
+/* digits of f * 2^e (f != 0) that round back to it; the gap below is half
+ * the one above at a power of two; returns the count, value = digits * 10^k */
+static uint8_t Grisu2(uint64_t f, int16_t e, bool lower_closer, char *buf,
+                      int16_t *k) {
+  DiyFp v = {f, e}, mp = {(f << 1) + 1, (int16_t)(e - 1)}, mm, c, w;
+  mp = DiyFpNormalize(mp);
+  mm.f = lower_closer ? (f << 2) - 1 : (f << 1) - 1;
+  mm.e = (int16_t)(lower_closer ? e - 2 : e - 1);
+  mm.f <<= mm.e - mp.e;
+  mm.e = mp.e;
+  c = CachedPower(mp.e, k);
+  w = DiyFpMul(DiyFpNormalize(v), c);
+  mp = DiyFpMul(mp, c);
+  mm = DiyFpMul(mm, c);
+  mm.f++;
+  mp.f--;
+  return GrisuDigits(w, mp, mp.f - mm.f, buf, k);
+}
+/* lays out len digits * 10^k the way they read back: fixed point for
+ * 1e-3 <= |x| < 1e7, else d.ddd with an exponent; marker is 'e' for
+ * single floats and 'd' for doubles, which always carry it */
+static char *FloatLayout(char *str, LispIndex size, bool negative,
+                         const char *digits, uint8_t len, int16_t k,
+                         char marker) {
+  char exponent[8], *p = str;
+  const char *e;
+  int16_t point = (int16_t)(len + k); /* digits before the point */
+  int16_t i;
+  if (size < 32) {
     LispError("error: scratch pad overflow\n");
   }
-  Uint642Str(str, number_of_digits, integer_part);
-  str[number_of_digits - 1] = precision == 0 ? '\0' : '.';
-  for (i = 0; i < precision; ++i) {
-    if (number_of_digits + i >= len - 1) {
-      LispPrintStr("warning: double floating number trancated\n");
-      break;
+  if (negative) {
+    *p++ = '-';
+  }
+  if (point > 7 || point < -2) {
+    *p++ = digits[0];
+    *p++ = '.';
+    if (len == 1) {
+      *p++ = '0';
     }
-    f *= 10;
-    integer_part = (uint64_t)f;
-    digit = (uint8_t)(integer_part % 10);
-    str[number_of_digits + i] = '0' + digit;
-    f -= (double)integer_part;
-    if (f < epsilon) {
-      break;
+    for (i = 1; i < len; i++) {
+      *p++ = digits[i];
+    }
+    *p++ = marker;
+    for (e = Int2Str(exponent, sizeof(exponent), point - 1, 10); *e; e++) {
+      *p++ = *e;
+    }
+  } else {
+    if (point <= 0) {
+      *p++ = '0';
+      *p++ = '.';
+      for (i = point; i < 0; i++) {
+        *p++ = '0';
+      }
+      for (i = 0; i < len; i++) {
+        *p++ = digits[i];
+      }
+    } else {
+      for (i = 0; i < point; i++) {
+        *p++ = (i < len) ? digits[i] : '0';
+      }
+      *p++ = '.';
+      if (len <= point) {
+        *p++ = '0';
+      }
+      for (i = point; i < len; i++) {
+        *p++ = digits[i];
+      }
+    }
+    if (marker == 'd') {
+      *p++ = 'd';
+      *p++ = '0';
     }
   }
-  str[number_of_digits + i] = '\0';
-  return is_negative ? --str : str;
+  *p = '\0';
+  return str;
+}
+static char *FloatSpecial(char *str, bool negative, bool nan) {
+  strcpy(str, nan ? "nan" : negative ? "-inf" : "inf");
+  return str;
 }
-char *Float2Str(char *str, LispIndex len, float f, uint8_t precision) {
-  uint8_t i, digit;
-  const float epsilon = (float)1e-5;
-  bool is_negative = f < 0;
-  if (is_negative) {
-    f = -f;
+char *Float2Str(char *str, LispIndex len, float f) {
+  char digits[20];
+  uint32_t bits, mantissa;
+  uint16_t exponent;
+  int16_t k = 0;
+  uint8_t n;
+  memcpy(&bits, &f, sizeof(bits));
+  mantissa = bits & 0x7FFFFFU;
+  exponent = (uint16_t)((bits >> 23) & 0xFFU);
+  if (exponent == 0xFF) {
+    return FloatSpecial(str, bits >> 31, mantissa != 0);
   }
-  /* split f to integer and fraction */
-  uint32_t integer_part = (uint32_t)f;
-  f -= (float)integer_part;
-  uint8_t number_of_digits = 1 + Log10(integer_part);
-  if (is_negative) {
-    str[0] = '-';
-    str++;
-    len--;
+  if (exponent == 0 && mantissa == 0) {
+    digits[0] = '0';
+    return FloatLayout(str, len, bits >> 31, digits, 1, 0, 'e');
   }
-  /* write decimal value to string */
-  if (++number_of_digits > len) {
-    LispError("error: scratch pad overflow\n");
+  n = exponent ? Grisu2(mantissa | 0x800000U, (int16_t)(exponent - 150),
+                        mantissa == 0 && exponent > 1, digits, &k)
+               : Grisu2(mantissa, -149, false, digits, &k);
+  return FloatLayout(str, len, bits >> 31, digits, n, k, 'e');
+}
+char *Double2Str(char *str, LispIndex len, double f) {
+  char digits[20];
+  uint64_t bits, mantissa;
+  uint16_t exponent;
+  int16_t k = 0;
+  uint8_t n;
+  memcpy(&bits, &f, sizeof(bits));
+  mantissa = bits & 0xFFFFFFFFFFFFFULL;
+  exponent = (uint16_t)((bits >> 52) & 0x7FFU);
+  if (exponent == 0x7FF) {
+    return FloatSpecial(str, bits >> 63, mantissa != 0);
+  }
+  if (exponent == 0 && mantissa == 0) {
+    digits[0] = '0';
+    return FloatLayout(str, len, bits >> 63, digits, 1, 0, 'd');
+  }
+  n = exponent ? Grisu2(mantissa | 0x10000000000000ULL,
+                        (int16_t)(exponent - 1075),
+                        mantissa == 0 && exponent > 1, digits, &k)
+               : Grisu2(mantissa, -1074, false, digits, &k);
+  return FloatLayout(str, len, bits >> 63, digits, n, k, 'd');
+}
+
+/* Float reading: Clinger's exact fast path, else the cached powers above
+ * give the significand to a few units in 64 bits, and only when that is too
+ * close to halfway between two floats the decimal is compared exactly with
+ * the halfway point in big integers. Correctly rounded for up to
+ * FLOAT_MAX_DIGITS significant digits, more only count as sticky. */
+#define FLOAT_MAX_DIGITS 128
+#define BIG_WORDS 40 /* 1280 bits, the widest comparison needs about 1150 */
+
+typedef struct {
+  uint8_t p;       /* significand bits, with the hidden one */
+  uint8_t ebits;   /* exponent field width */
+  int16_t emin;    /* exponent of the smallest normal */
+  int16_t max10;   /* decimal positions that are certainly infinity */
+  int16_t min10;   /* and certainly zero */
+  int8_t exact10;  /* largest exactly representable power of ten */
+} FloatFormat;
+static const FloatFormat single_format = {24, 8, -126, 39, -46, 10};
+static const FloatFormat double_format = {53, 11, -1022, 309, -324, 22};
+
+typedef struct {
+  const char *digits; /* first significant digit */
+  const char *end;    /* the exponent marker or the end */
+  uint64_t w;         /* the first 19 significant digits */
+  int32_t q;          /* value ~ w * 10^q */
+  int32_t point;      /* value < 10^point */
+  LispIndex nd;       /* significant digits */
+  bool truncated;     /* nonzero digits beyond w */
+  bool negative;
+} Decimal;
+
+typedef struct {
+  uint32_t w[BIG_WORDS];
+  uint8_t n;
+} Big;
+static void BigMulAdd(Big *b, uint32_t m, uint32_t a) {
+  uint8_t i;
+  uint64_t t;
+  for (i = 0; i < b->n; i++) {
+    t = (uint64_t)b->w[i] * m + a;
+    b->w[i] = (uint32_t)t;
+    a = (uint32_t)(t >> 32);
+  }
+  if (a != 0 && b->n < BIG_WORDS) {
+    b->w[b->n++] = a;
+  }
+}
+static void BigMulPow5(Big *b, uint32_t e) {
+  static const uint32_t pow5[14] = {1,       5,        25,        125,
+                                    625,     3125,     15625,     78125,
+                                    390625,  1953125,  9765625,   48828125,
+                                    244140625, 1220703125};
+  for (; e >= 13; e -= 13) {
+    BigMulAdd(b, pow5[13], 0);
+  }
+  BigMulAdd(b, pow5[e], 0);
+}
+static void BigShiftLeft(Big *b, uint32_t s) {
+  uint8_t words = (uint8_t)(s >> 5), bits = (uint8_t)(s & 31);
+  int16_t i;
+  if (b->n == 0) {
+    return;
+  }
+  if (b->n + words + 1 > BIG_WORDS) {
+    return; /* BIG_WORDS covers every float, not reached */
+  }
+  b->w[b->n + words] = 0;
+  for (i = (int16_t)(b->n - 1); i >= 0; i--) {
+    if (bits) {
+      b->w[i + words + 1] |= b->w[i] >> (32 - bits);
+    }
+    b->w[i + words] = b->w[i] << bits;
+  }
+  memset(b->w, 0, sizeof(uint32_t) * words);
+  b->n = (uint8_t)(b->n + words + 1);
+  while (b->n > 0 && b->w[b->n - 1] == 0) {
+    b->n--;
+  }
+}
+static int8_t BigCompare(const Big *a, const Big *b) {
+  int16_t i;
+  if (a->n != b->n) {
+    return a->n > b->n ? 1 : -1;
+  }
+  for (i = (int16_t)(a->n - 1); i >= 0; i--) {
+    if (a->w[i] != b->w[i]) {
+      return a->w[i] > b->w[i] ? 1 : -1;
+    }
+  }
+  return 0;
+}
+/* sign of d - (2 m + 1) 2^(e - 1), the point halfway above m 2^e */
+static int8_t DecimalCompareHalfway(const Decimal *d, uint64_t m, int32_t e) {
+  Big dec = {{0}, 0}, half = {{0}, 0};
+  const char *p;
+  LispIndex n = 0;
+  int32_t q, e2 = e - 1;
+  int8_t cmp;
+  bool sticky = false;
+  for (p = d->digits; p < d->end; p++) {
+    if (*p == '.') {
+      continue;
+    }
+    if (n == FLOAT_MAX_DIGITS) {
+      sticky |= (*p != '0');
+      continue;
+    }
+    BigMulAdd(&dec, 10, (uint32_t)(*p - '0'));
+    ++n;
   }
-  Uint2Str(str, number_of_digits, integer_part, 10);
-  str[number_of_digits - 1] = precision == 0 ? '\0' : '.';
-  for (i = 0; i < precision; ++i) {
-    if (number_of_digits + i >= len - 1) {
-      LispPrintStr("warning: floating number trancated\n");
+  q = d->point - n;
+  m = 2 * m + 1;
+  half.w[0] = (uint32_t)m;
+  half.w[1] = (uint32_t)(m >> 32);
+  half.n = half.w[1] ? 2 : 1;
+  /* d 10^q against m 2^e2, in integers */
+  if (q >= 0) {
+    BigMulPow5(&dec, (uint32_t)q);
+  } else {
+    BigMulPow5(&half, (uint32_t)-q);
+  }
+  if (q > e2) {
+    BigShiftLeft(&dec, (uint32_t)(q - e2));
+  } else {
+    BigShiftLeft(&half, (uint32_t)(e2 - q));
+  }
+  cmp = BigCompare(&dec, &half);
+  return (cmp == 0 && sticky) ? 1 : cmp;
+}
+
+static uint64_t DecimalToBinary(const Decimal *d, const FloatFormat *fmt) {
+  static const double exact10[23] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                     1e18, 1e19, 1e20, 1e21, 1e22};
+  const uint64_t inf = ((1ULL << fmt->ebits) - 1) << (fmt->p - 1);
+  DiyFp x, c;
+  uint64_t low, half, mask, mant, err = d->truncated ? 32 : 8;
+  int32_t e, shift, k;
+  uint8_t index;
+  if (d->w == 0 || d->point <= fmt->min10) {
+    return 0;
+  }
+  if (d->point > fmt->max10) {
+    return inf;
+  }
+  if (!d->truncated && d->w <= (1ULL << fmt->p) && d->q <= fmt->exact10 &&
+      d->q >= -fmt->exact10) {
+    /* both operands exact, IEEE rounds the one operation correctly */
+    if (fmt == &single_format) {
+      float f = (float)d->w, p10 = (float)exact10[d->q < 0 ? -d->q : d->q];
+      uint32_t bits;
+      f = (d->q < 0) ? f / p10 : f * p10;
+      memcpy(&bits, &f, sizeof(bits));
+      return bits;
+    } else {
+      double f = (double)d->w, p10 = exact10[d->q < 0 ? -d->q : d->q];
+      uint64_t bits;
+      f = (d->q < 0) ? f / p10 : f * p10;
+      memcpy(&bits, &f, sizeof(bits));
+      return bits;
+    }
+  }
+  /* w 10^q = w 10^r 10^k, the latter cached */
+  index = (uint8_t)((d->q + 348) / 8);
+  k = index * 8 - 348;
+  x.f = d->w;
+  x.e = 0;
+  x = DiyFpNormalize(x);
+  if (d->q != k) {
+    c.f = pow10_u64[d->q - k];
+    c.e = 0;
+    x = DiyFpNormalize(DiyFpMul(x, DiyFpNormalize(c)));
+  }
+  c.f = cached_powers[index].f;
+  c.e = cached_powers[index].e;
+  x = DiyFpNormalize(DiyFpMul(x, c));
+  /* keep p bits, fewer below the normal range */
+  e = x.e + 63;
+  shift = 64 - fmt->p;
+  if (e < fmt->emin) {
+    shift += fmt->emin - e;
+  }
+  if (shift > 64) {
+    return 0;
+  }
+  mask = (shift == 64) ? ~0ULL : (1ULL << shift) - 1;
+  half = 1ULL << (shift - 1);
+  low = x.f & mask;
+  mant = (shift == 64) ? 0 : x.f >> shift;
+  e = x.e + shift; /* value ~ mant 2^e */
+  if (low >= half - err && low <= half + err) {
+    /* too close to call with the error above */
+    int8_t cmp = DecimalCompareHalfway(d, mant, e);
+    mant += (cmp > 0 || (cmp == 0 && (mant & 1)));
+  } else {
+    mant += (low > half);
+  }
+  if (mant == (1ULL << fmt->p)) {
+    mant >>= 1;
+    ++e;
+  }
+  if (mant < (1ULL << (fmt->p - 1))) {
+    return mant; /* subnormal */
+  }
+  e += fmt->p - 1 - fmt->emin + 1; /* biased exponent */
+  if (e >= (1 << fmt->ebits) - 1) {
+    return inf;
+  }
+  return ((uint64_t)e << (fmt->p - 1)) | (mant & ((1ULL << (fmt->p - 1)) - 1));
+}
+
+/* [+-]digits[.digits][marker[+-]digits] with at least one digit, and a
+ * point followed by digits or an exponent; markers e s f make a single
+ * float, d l a double */
+/* Str2Float, taking an integer for a double when integers is set */
+static FloatKind ScanFloat(const char *s, LispIndex len, bool integers,
+                           float *single, double *dbl) {
+  const char *p = s, *end = s + len;
+  Decimal d = {NULL, NULL, 0, 0, 0, 0, false, false};
+  bool seen_point = false, fraction = false, digits = false;
+  int32_t exponent = 0, before = 0;
+  FloatKind kind = kFloatSingle;
+  uint64_t bits;
+  if (p < end && (*p == '+' || *p == '-')) {
+    d.negative = (*p++ == '-');
+  }
+  for (; p < end; p++) {
+    if (*p == '.' && !seen_point) {
+      seen_point = true;
+      if (d.digits == NULL) {
+        d.point = before;
+      }
+    } else if (*p >= '0' && *p <= '9') {
+      digits = true;
+      fraction |= seen_point;
+      if (d.digits == NULL) {
+        if (*p == '0') {
+          if (seen_point) {
+            --before;
+          }
+          continue;
+        }
+        d.digits = p;
+        d.point = seen_point ? before : 0;
+      }
+      if (!seen_point) {
+        ++d.point;
+      }
+      if (d.nd < 19) {
+        d.w = d.w * 10 + (uint64_t)(*p - '0');
+      } else {
+        d.truncated |= (*p != '0');
+      }
+      ++d.nd;
+    } else {
       break;
     }
-    f *= 10;
-    integer_part = (uint32_t)f;
-    digit = (uint8_t)(integer_part % 10);
-    str[number_of_digits + i] = '0' + digit;
-    f -= (float)integer_part;
-    if (f < epsilon) {
+  }
+  d.end = p;
+  if (!digits) {
+    return kFloatNone;
+  }
+  if (p < end) {
+    char m = (char)(*p++ | 0x20);
+    bool negative = false;
+    if (m == 'd' || m == 'l') {
+      kind = kFloatDouble;
+    } else if (m != 'e' && m != 's' && m != 'f') {
+      return kFloatNone;
+    }
+    if (p < end && (*p == '+' || *p == '-')) {
+      negative = (*p++ == '-');
+    }
+    if (p == end) {
+      return kFloatNone;
+    }
+    for (; p < end; p++) {
+      if (*p < '0' || *p > '9') {
+        return kFloatNone;
+      }
+      if (exponent < 100000) {
+        exponent = exponent * 10 + (*p - '0');
+      }
+    }
+    d.point += negative ? -exponent : exponent;
+  } else if (!fraction) {
+    if (!integers) {
+      return kFloatNone; /* an integer, or a symbol like 1. */
+    }
+    kind = kFloatDouble;
+  }
+  d.q = d.point - (d.nd < 19 ? (int32_t)d.nd : 19);
+  if (kind == kFloatSingle) {
+    uint32_t b;
+    bits = DecimalToBinary(&d, &single_format) | (d.negative ? 1ULL << 31 : 0);
+    b = (uint32_t)bits;
+    memcpy(single, &b, sizeof(b));
+  } else {
+    bits = DecimalToBinary(&d, &double_format) | (d.negative ? 1ULL << 63 : 0);
+    memcpy(dbl, &bits, sizeof(bits));
+  }
+  return kind;
+}
+FloatKind Str2Float(const char *s, LispIndex len, float *single,
+                    double *dbl) {
+  return ScanFloat(s, len, false, single, dbl);
+}
+double Integer2Double(const char *s, LispIndex len) {
+  float single;
+  double dbl;
+  ScanFloat(s, len, true, &single, &dbl);
+  return dbl;
+}
+
+/* Strings are compared a 32 bit word at a time (SWAR); loads go through
+ * memcpy, which the M3 does as one unaligned ldr */
+#define SWAR_ONES 0x01010101U
+#define SWAR_HIGHS 0x80808080U
+/* nonzero iff some byte of w is zero */
+#define SWAR_HAS_ZERO(w) (((w)-SWAR_ONES) & ~(w)&SWAR_HIGHS)
+static inline uint32_t LoadWord(const char *p) {
+  uint32_t w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+LispIndex StrMismatch(const char *a, const char *b, LispIndex n) {
+  LispIndex i = 0;
+  while (i + 4u <= n && LoadWord(a + i) == LoadWord(b + i)) {
+    i = (LispIndex)(i + 4);
+  }
+  while (i < n && a[i] == b[i]) {
+    ++i;
+  }
+  return i;
+}
+LispIndex StrSearch(const char *s, LispIndex n, const char *p, LispIndex m) {
+  uint32_t first, i = 0, last;
+  if (m == 0) return 0;
+  if (m > n) return NOTFOUND;
+  last = (uint32_t)(n - m); /* last possible start */
+  first = (uint8_t)p[0] * SWAR_ONES;
+  for (;;) {
+    /* skip four starts at once while none has the first byte */
+    while (i + 4 <= last + 1 && !SWAR_HAS_ZERO(LoadWord(s + i) ^ first)) {
+      i += 4;
+    }
+    if (i > last) break;
+    if (s[i] == p[0] &&
+        StrMismatch(s + i + 1, p + 1, (LispIndex)(m - 1)) == m - 1) {
+      return (LispIndex)i;
+    }
+    ++i;
+  }
+  return NOTFOUND;
+}
+
+/* Typed arrays: each kernel is one loop per element type, over the packed
+ * elements, so no element is boxed */
+static const int32_t element_min[kElemF32] = {0, INT16_MIN, 0, INT32_MIN};
+static const int32_t element_max[kElemF32] = {UINT8_MAX, INT16_MAX,
+                                              UINT16_MAX, INT32_MAX};
+static inline int32_t Saturate(int64_t x, uint8_t etype) {
+  return (x < element_min[etype])   ? element_min[etype]
+         : (x > element_max[etype]) ? element_max[etype]
+                                    : (int32_t)x;
+}
+static inline int32_t SaturateFloat(float x, uint8_t etype) {
+  if (x != x) return 0; /* nan */
+  return (x <= (float)element_min[etype])   ? element_min[etype]
+         : (x >= (float)element_max[etype]) ? element_max[etype]
+                                            : (int32_t)x;
+}
+/* stmt on each element *p of [start, end), p an Elem * */
+#define ARRAY_EACH(a, start, end, T, stmt)                     \
+  do {                                                         \
+    typedef T Elem;                                            \
+    Elem *p = (Elem *)(void *)(a)->typed_array.self.u8;        \
+    Elem *const p_end = p + (end);                             \
+    for (p += (start); p < p_end; ++p) {                       \
+      stmt;                                                    \
+    }                                                          \
+  } while (0)
+#define ARRAY_SWITCH(a, start, end, int_stmt, float_stmt) \
+  switch ((a)->typed_array.etype) {                       \
+    case kElemU8:                                         \
+      ARRAY_EACH(a, start, end, uint8_t, int_stmt);       \
+      break;                                              \
+    case kElemI16:                                        \
+      ARRAY_EACH(a, start, end, int16_t, int_stmt);       \
+      break;                                              \
+    case kElemU16:                                        \
+      ARRAY_EACH(a, start, end, uint16_t, int_stmt);      \
+      break;                                              \
+    case kElemI32:                                        \
+      ARRAY_EACH(a, start, end, int32_t, int_stmt);       \
+      break;                                              \
+    default:                                              \
+      ARRAY_EACH(a, start, end, float, float_stmt);       \
+      break;                                              \
+  }
+
+int32_t ArrayGetInt(LispObject a, LispIndex i) {
+  switch (a->typed_array.etype) {
+    case kElemU8:
+      return a->typed_array.self.u8[i];
+    case kElemI16:
+      return a->typed_array.self.i16[i];
+    case kElemU16:
+      return a->typed_array.self.u16[i];
+    case kElemI32:
+      return a->typed_array.self.i32[i];
+    default:
+      return SaturateFloat(a->typed_array.self.f32[i], kElemI32);
+  }
+}
+float ArrayGetFloat(LispObject a, LispIndex i) {
+  return (a->typed_array.etype == kElemF32) ? a->typed_array.self.f32[i]
+                                             : (float)ArrayGetInt(a, i);
+}
+void ArrayFill(LispObject a, LispIndex start, LispIndex end, int32_t x) {
+  uint8_t t = a->typed_array.etype;
+  if (t == kElemU8) {
+    memset(a->typed_array.self.u8 + start, (uint8_t)Saturate(x, t),
+           (size_t)(end - start));
+    return;
+  }
+  if (t != kElemF32) {
+    x = Saturate(x, t);
+  }
+  ARRAY_SWITCH(a, start, end, *p = (Elem)x, *p = (float)x);
+}
+void ArrayFillFloat(LispObject a, LispIndex start, LispIndex end, float f) {
+  if (a->typed_array.etype == kElemF32) {
+    ARRAY_EACH(a, start, end, float, *p = f);
+  } else {
+    ArrayFill(a, start, end, SaturateFloat(f, kElemI32));
+  }
+}
+void ArrayCopy(LispObject dst, LispIndex at, LispObject src, LispIndex start,
+               LispIndex end) {
+  uint8_t t = dst->typed_array.etype, shift = lisp_element_shift[t];
+  LispIndex i = start;
+  if (src->typed_array.etype == t) {
+    memmove(dst->typed_array.self.u8 + ((uint32_t)at << shift),
+            src->typed_array.self.u8 + ((uint32_t)start << shift),
+            (uint32_t)(end - start) << shift);
+  } else if (src->typed_array.etype == kElemF32) {
+    ARRAY_SWITCH(dst, at, at + (end - start),
+                 *p = (Elem)SaturateFloat(src->typed_array.self.f32[i++], t),
+                 (void)0);
+  } else {
+    /* arrays of two types are two objects, they cannot overlap */
+    ARRAY_SWITCH(dst, at, at + (end - start),
+                 *p = (Elem)Saturate(ArrayGetInt(src, i++), t),
+                 *p = (float)ArrayGetInt(src, i++));
+  }
+}
+int64_t ArraySumInt(LispObject a) {
+  int64_t sum = 0;
+  ARRAY_SWITCH(a, 0, a->typed_array.size, sum += *p, sum += (int64_t)*p);
+  return sum;
+}
+float ArraySumFloat(LispObject a) {
+  float sum = 0;
+  ARRAY_SWITCH(a, 0, a->typed_array.size, sum += (float)*p, sum += *p);
+  return sum;
+}
+LispIndex ArrayExtremum(LispObject a, bool max) {
+  LispIndex best = 0;
+  if (a->typed_array.size == 0) {
+    return NOTFOUND;
+  }
+  if (a->typed_array.etype == kElemF32) {
+    const float *f = a->typed_array.self.f32;
+    float m = f[0];
+    ARRAY_EACH(a, 1, a->typed_array.size, float,
+               if (max ? *p > m : *p < m) {
+                 m = *p;
+                 best = (LispIndex)(p - f);
+               });
+  } else {
+    int32_t m = ArrayGetInt(a, 0);
+    LispIndex i = 0;
+    ARRAY_SWITCH(
+        a, 0, a->typed_array.size,
+        if (max ? *p > m : *p < m) {
+          m = *p;
+          best = i;
+        } ++i,
+        (void)0);
+  }
+  return best;
+}
+void ArrayScale(LispObject a, int32_t k, uint8_t shift) {
+  uint8_t t = a->typed_array.etype;
+  float f = (float)k / (float)(1UL << shift);
+  ARRAY_SWITCH(a, 0, a->typed_array.size,
+               *p = (Elem)Saturate(((int64_t)*p * k) >> shift, t), *p *= f);
+}
+
+/* Bit vectors go a 32 bit word at a time through LoadWord, then the odd
+ * bytes; the bits past the length are kept clear so no kernel masks them */
+static inline void StoreWord(uint8_t *p, uint32_t w) {
+  memcpy(p, &w, sizeof(w));
+}
+static inline uint32_t PopCount(uint32_t w) {
+  w = w - ((w >> 1) & 0x55555555U);
+  w = (w & 0x33333333U) + ((w >> 2) & 0x33333333U);
+  w = (w + (w >> 4)) & 0x0F0F0F0FU;
+  return (w * SWAR_ONES) >> 24;
+}
+#define BITS_EACH(n, expr)                                       \
+  do {                                                           \
+    LispIndex i_ = 0;                                            \
+    uint32_t x, y;                                               \
+    for (; i_ + 4u <= (n); i_ = (LispIndex)(i_ + 4)) {           \
+      x = LoadWord((const char *)a + i_);                        \
+      y = LoadWord((const char *)b + i_);                        \
+      StoreWord(d + i_, (expr));                                 \
+    }                                                            \
+    for (; i_ < (n); ++i_) {                                     \
+      x = a[i_];                                                 \
+      y = b[i_];                                                 \
+      d[i_] = (uint8_t)(expr);                                   \
+    }                                                            \
+    (void)y;                                                     \
+  } while (0)
+void BitVectorLogic(LispObject dst, LispObject x1, LispObject y1,
+                    LispBitOp op) {
+  uint8_t *d = dst->bit_vector.self;
+  const uint8_t *a = x1->bit_vector.self, *b = y1->bit_vector.self;
+  LispIndex n = dst->bit_vector.size;
+  switch (op) {
+    case kBitAnd:
+      BITS_EACH(n, x & y);
+      break;
+    case kBitOr:
+      BITS_EACH(n, x | y);
+      break;
+    case kBitXor:
+      BITS_EACH(n, x ^ y);
+      break;
+    case kBitNot:
+      BITS_EACH(n, ~x);
+      d[n - 1] &= (uint8_t)(0xFFu >> dst->bit_vector.pad);
       break;
+  }
+}
+uint32_t BitVectorCount(LispObject bv) {
+  const uint8_t *p = bv->bit_vector.self;
+  LispIndex i = 0, n = bv->bit_vector.size;
+  uint32_t count = 0;
+  for (; i + 4u <= n; i = (LispIndex)(i + 4)) {
+    count += PopCount(LoadWord((const char *)p + i));
+  }
+  for (; i < n; ++i) {
+    count += PopCount(p[i]);
+  }
+  return count;
+}
+LispIndex BitVectorFindSet(LispObject bv, LispIndex start) {
+  const uint8_t *p = bv->bit_vector.self;
+  LispIndex i = (LispIndex)(start >> 3), n = bv->bit_vector.size;
+  uint8_t b;
+  if (start >= LISP_BIT_VECTOR_LENGTH(bv)) {
+    return NOTFOUND;
+  }
+  b = (uint8_t)(p[i] & (0xFFu << (start & 7)));
+  while (b == 0) {
+    if (++i == n) {
+      return NOTFOUND;
+    }
+    /* whole clear words are skipped, the byte loop finds the bit */
+    while (i + 4u <= n && LoadWord((const char *)p + i) == 0) {
+      i = (LispIndex)(i + 4);
+    }
+    if (i == n) {
+      return NOTFOUND;
     }
+    b = p[i];
   }
-  str[number_of_digits + i] = '\0';
-  return is_negative ? --str : str;
+  return (LispIndex)(i * 8u + (unsigned)__builtin_ctz(b));
 }
-char *Int2Str(char *dest, LispIndex len, int32_t num, Byte base) {
-  int16_t i = (int16_t)len - 1;
-  bool is_negative = num < 0;
-  if (is_negative) {
-    num = -num;
+
+/* Fixed point: a Qn number is the int32_t x standing for x / 2^n, n being
+ * 15 or 31; all results saturate to [-1, 1) */
+int32_t QSaturate(int64_t x, uint8_t n) {
+  int64_t max = ((int64_t)1 << n) - 1;
+  return (int32_t)((x > max) ? max : (x < -max - 1) ? -max - 1 : x);
+}
+int32_t QMul(int32_t a, int32_t b, uint8_t n) {
+  /* rounded to nearest, one smull on the M3 */
+  return QSaturate(((int64_t)a * b + ((int64_t)1 << (n - 1))) >> n, n);
+}
+int32_t QMac(int32_t acc, int32_t a, int32_t b, uint8_t n) {
+  /* the product is added before it is rounded */
+  return QSaturate((((int64_t)acc << n) + (int64_t)a * b +
+                    ((int64_t)1 << (n - 1))) >> n,
+                   n);
+}
+int32_t QFromDouble(double f, uint8_t n) {
+  double x = f * (double)((int64_t)1 << n);
+  if (!(x < (double)((int64_t)1 << n))) {
+    return QSaturate(INT64_MAX, n); /* NaN too */
   }
-  char ch;
-  dest[i--] = '\0';
-  while (i >= 0) {
-    ch = (char)(num % base);
-    if (ch < 10)
-      ch += '0';
-    else
-      ch = ch - 10 + 'a';
-    dest[i--] = ch;
-    num /= base;
-    if (num == 0) break;
+  if (x < -(double)((int64_t)1 << n)) {
+    return QSaturate(INT64_MIN, n);
   }
-  if (num != 0) {
-    LispPrintStr("warning: number trancated\n");
+  return QSaturate((int64_t)(x < 0 ? x - 0.5 : x + 0.5), n);
+}
+/* Qn from the decimal [+-]d[.ddd], correctly rounded: the fraction digits
+ * are doubled in place, one bit of x each time. False when s is not one. */
+bool Str2Fixed(const char *s, LispIndex len, uint8_t n, int32_t *x) {
+  char d[24];
+  LispIndex i = 0, k = 0, j;
+  int64_t whole = 0, q = 0;
+  bool negative = false, digits = false;
+  uint8_t bit, carry;
+  if (i < len && (s[i] == '+' || s[i] == '-')) {
+    negative = (s[i++] == '-');
   }
-  if (is_negative) {
-    if (i >= 0) {
-      dest[i--] = '-';
-    } else {
-      LispPrintStr("warning: negative sign trancated\n");
+  for (; i < len && s[i] >= '0' && s[i] <= '9'; ++i, digits = true) {
+    if (whole < 2) {
+      whole = whole * 10 + (s[i] - '0');
     }
   }
-  return &dest[i + 1];
+  if (i < len && s[i] == '.') {
+    for (++i; i < len && s[i] >= '0' && s[i] <= '9'; ++i, digits = true) {
+      if (k < sizeof(d)) {
+        d[k++] = (char)(s[i] - '0'); /* more can only break a tie */
+      }
+    }
+  }
+  if (!digits || i != len) {
+    return false;
+  }
+  for (bit = 0; bit <= n; ++bit) {
+    for (carry = 0, j = k; j-- > 0;) {
+      d[j] = (char)(d[j] * 2 + carry);
+      carry = (d[j] >= 10);
+      d[j] = (char)(d[j] - (carry ? 10 : 0));
+    }
+    q = (q << 1) | carry;
+  }
+  /* q holds one bit past the last, which rounds */
+  q = (whole << n) + ((q + 1) >> 1);
+  *x = QSaturate(negative ? -q : q, n);
+  return true;
 }
-char *Uint2Str(char *dest, LispIndex len, uint32_t num, Byte base) {
-  int16_t i = (int16_t)len - 1;
-  char ch;
-  dest[i--] = '\0';
-  while (i >= 0) {
-    ch = (char)(num % base);
-    if (ch < 10)
-      ch += '0';
-    else
-      ch = ch - 10 + 'a';
-    dest[i--] = ch;
-    num /= base;
-    if (num == 0) break;
+/* the fewest fraction digits that Str2Fixed reads back to x, then q15 or
+ * q31; 5 always do for Q15, 10 for Q31 */
+char *Fixed2Str(char *str, int32_t x, uint8_t n) {
+  uint64_t m = (x < 0) ? 0u - (uint64_t)(int64_t)x : (uint64_t)x;
+  uint64_t one = (uint64_t)1 << n, frac;
+  uint8_t digits = 0, most = (n > 15) ? 10 : 5, i;
+  char *d = str + (x < 0) + 2;
+  int32_t back;
+  str[0] = '-';
+  do {
+    ++digits;
+    frac = m & (one - 1);
+    for (i = 0; i < digits; ++i) {
+      frac *= 10;
+      d[i] = (char)('0' + (frac >> n));
+      frac &= one - 1;
+    }
+    /* rounded to nearest, a carry out of the fraction goes to the 0 or 1
+     * before the point */
+    i = digits;
+    if (2 * frac >= one) {
+      while (i-- > 0 && ++d[i] > '9') {
+        d[i] = '0';
+      }
+    }
+    d[-2] = (char)('0' + (m >> n) + (i == (uint8_t)-1));
+    d[-1] = '.';
+  } while (digits < most &&
+           (!Str2Fixed(str, (LispIndex)(d + digits - str), n, &back) ||
+            back != x || (x > 0 && d[-2] == '1'))); /* 1 only saturates */
+  while (digits > 1 && d[digits - 1] == '0') {
+    --digits;
   }
-  if (num != 0) {
-    LispPrintStr("warning: number trancated\n");
+  memcpy(d + digits, (n > 15) ? "q31" : "q15", 4);
+  return str;
+}
+
+#define LABEL_SLOTS(t) \
+  ((LispIndex)((t)->index->string.size / sizeof(LispIndex)))
+static inline LispIndex LabelHash(LispObject item, LispIndex mask) {
+  return (LispIndex)((((uint32_t)(uintptr_t)item >> 2) * 2654435761U) >> 16) &
+         mask;
+}
+/* slot holding item, or the empty slot where it would go */
+static LispIndex *LabelSlot(LabelTable *t, LispObject item) {
+  LispIndex *slots = (LispIndex *)t->index->string.self;
+  LispIndex mask = (LispIndex)(LABEL_SLOTS(t) - 1);
+  LispIndex h = LabelHash(item, mask);
+  while (slots[h] != 0 && t->items->vector.self[slots[h] - 1] != item) {
+    h = (LispIndex)((h + 1) & mask);
+  }
+  return &slots[h];
+}
+static void LabelTableRehash(LabelTable *t) {
+  LispIndex i;
+  memset(t->index->string.self, 0, t->index->string.size);
+  for (i = 0; i < t->items->vector.fillp; i++) {
+    LispIndex *slot = LabelSlot(t, t->items->vector.self[i]);
+    if (*slot == 0) {
+      *slot = (LispIndex)(i + 1);
+    }
+  }
+  t->gc_epoch = *LispNumberOfCollections();
+}
+/* the index for n items, kept at most half full */
+static void LabelTableReserve(LabelTable *t, LispIndex n) {
+  uint32_t slots = 8;
+  while (slots < 2u * n) {
+    slots <<= 1;
+  }
+  if (slots * sizeof(LispIndex) > (LispIndex)-1) {
+    LispError("label table overflow.\n");
+  }
+  if (LISP_NULL(t->index) || slots > LABEL_SLOTS(t)) {
+    t->index = LispAllocString((LispIndex)(slots * sizeof(LispIndex)));
+    t->gc_epoch = *LispNumberOfCollections() - 1;
   }
-  return &dest[i + 1];
 }
 
 void LabelTableInit(LabelTable *t, LispIndex n) {
+  t->index = LISP_NIL;
   t->items = LispMakeVector(n);
+  LabelTableReserve(t, n);
+  LabelTableRehash(t);
 }
 
-void LabelTableClear(LabelTable *t) { t->items->vector.fillp = 0; }
+void LabelTableClear(LabelTable *t) {
+  t->items->vector.fillp = 0;
+  LabelTableRehash(t);
+}
 
 void LabelTableInsert(LabelTable *t, LispObject item) {
-  LispVectorPush(t->items, item);
+  PUSH(item);
+  LabelTableReserve(t, (LispIndex)(t->items->vector.fillp + 1));
+  t->items = LispVectorPush(t->items, stack[stack_index - 1]);
+  item = POP();
+  if (t->gc_epoch != *LispNumberOfCollections()) {
+    LabelTableRehash(t);
+  } else {
+    LispIndex *slot = LabelSlot(t, item);
+    if (*slot == 0) {
+      *slot = t->items->vector.fillp;
+    }
+  }
 }
 
+/* never allocates, printing holds bare pointers around it */
 LispIndex LabelTableLookUp(LabelTable *t, LispObject item) {
-  LispIndex i;
-  for (i = 0; i < t->items->vector.size; i++) {
-    if (t->items->vector.self[i] == item) {
-      return i;
-    }
+  if (t->items->vector.fillp == 0) {
+    return NOTFOUND;
   }
-  return NOTFOUND;
+  if (t->gc_epoch != *LispNumberOfCollections()) {
+    LabelTableRehash(t);
+  }
+  return (LispIndex)(*LabelSlot(t, item) - 1);
 }
 
 void LabelTableAdjoin(LabelTable *t, LispObject item) {
@@ -279,3 +1217,276 @@ void LabelTableAdjoin(LabelTable *t, LispObject item) {
     LabelTableInsert(t, item);
   }
 }
+
+/* Hash tables. Keys are hashed by value where the test allows it, symbols
+ * by name, so a collection only invalidates the index of a table holding a
+ * key hashed by its address; a growing index is filled a few pairs per
+ * operation instead of all at once. */
+#define HASH_SEED 2166136261U
+#define HASH_PRIME 16777619U
+#define HASH_MIGRATE_STEP 4
+#define HASH_MAX_SLOTS 16384U
+#define HASH_SLOTS(index) \
+  ((LispIndex)((index)->string.size / sizeof(LispIndex)))
+bool LispEql(LispObject a, LispObject b) {
+  if (a == b) {
+    return true;
+  }
+  if (LISP_SingleFloatP(a)) {
+    return LISP_SingleFloatP(b) &&
+           memcmp(&a->single_float.value, &b->single_float.value,
+                  sizeof(float)) == 0;
+  }
+  if (LISP_DoubleFloatP(a)) {
+    return LISP_DoubleFloatP(b) &&
+           memcmp(&a->double_float.value, &b->double_float.value,
+                  sizeof(double)) == 0;
+  }
+  if (LISP_Q31P(a)) {
+    return LISP_Q31P(b) && LISP_Q31(a) == LISP_Q31(b);
+  }
+  return false;
+}
+bool LispEqual(LispObject a, LispObject b) {
+  while (LISP_ConsP(a) && a != b) {
+    if (!LISP_ConsP(b) || !LispEqual(LISP_CONS_CAR(a), LISP_CONS_CAR(b))) {
+      return false;
+    }
+    a = LISP_CONS_CDR(a);
+    b = LISP_CONS_CDR(b);
+  }
+  if (LispEql(a, b)) {
+    return true;
+  }
+  if (LISP_StringP(a)) {
+    return LISP_StringP(b) && a->string.size == b->string.size &&
+           StrMismatch(a->string.self, b->string.self, a->string.size) ==
+               a->string.size;
+  }
+  if (LISP_BitVectorP(a)) {
+    return LISP_BitVectorP(b) && a->bit_vector.size == b->bit_vector.size &&
+           a->bit_vector.pad == b->bit_vector.pad &&
+           memcmp(a->bit_vector.self, b->bit_vector.self,
+                  a->bit_vector.size) == 0;
+  }
+  return false;
+}
+static inline bool HashTestEqual(LispObject a, LispObject b, uint8_t test) {
+  return (test == kHashEq)    ? a == b
+         : (test == kHashEql) ? LispEql(a, b)
+                              : LispEqual(a, b);
+}
+static uint32_t HashBytes(const void *p, uint32_t n, uint32_t h) {
+  const uint8_t *s = p;
+  while (n--) {
+    h = (h ^ *s++) * HASH_PRIME;
+  }
+  return h;
+}
+static uint32_t Hash(LispObject x, uint8_t test, bool *moving, uint8_t depth) {
+  uint32_t h = HASH_SEED;
+  uint8_t n = 0;
+  if (LISP_UNBOUNDP(x) || LISP_IMMEDIATE(x) >= kCharacter || LISP_NULL(x)) {
+    return (uint32_t)(uintptr_t)x;
+  }
+  if (LISP_ConsP(x)) {
+    if (test != kHashEqual) {
+      /* by address below */
+    } else {
+      /* the first few elements, a few levels deep */
+      for (; LISP_ConsP(x) && n < 8 && depth > 0; ++n) {
+        h = (h ^ Hash(LISP_CONS_CAR(x), test, moving,
+                      (uint8_t)(depth - 1))) *
+            HASH_PRIME;
+        x = LISP_CONS_CDR(x);
+      }
+      return LISP_ConsP(x) ? h : (h ^ Hash(x, test, moving, 0)) * HASH_PRIME;
+    }
+  } else if (LISP_SymbolP(x)) {
+    if (LISP_SYMBOL_GENSYMP(x)) {
+      return HASH_SEED ^ x->gen_sym.id;
+    }
+    return HashBytes(x->symbol.name, (uint32_t)strlen(x->symbol.name), h);
+  } else if (test != kHashEq && LISP_SingleFloatP(x)) {
+    return HashBytes(&x->single_float.value, sizeof(float), h);
+  } else if (test != kHashEq && LISP_DoubleFloatP(x)) {
+    return HashBytes(&x->double_float.value, sizeof(double), h);
+  } else if (test != kHashEq && LISP_Q31P(x)) {
+    return HashBytes(&x->q31.value, sizeof(int32_t), h);
+  } else if (test == kHashEqual && LISP_StringP(x)) {
+    return HashBytes(x->string.self, x->string.size, h);
+  } else if (test == kHashEqual && LISP_BitVectorP(x)) {
+    return HashBytes(x->bit_vector.self, x->bit_vector.size, h);
+  }
+  if (moving == NULL) {
+    /* stable, if poor: its type */
+    return HASH_SEED ^ LISP_TYPE_OF(x);
+  }
+  *moving = true;
+  return (uint32_t)((uintptr_t)x >> 2);
+}
+uint32_t LispHash(LispObject x, uint8_t test, bool *moving) {
+  return Hash(x, test, moving, 4);
+}
+static inline LispIndex HashStart(uint32_t h, LispIndex mask) {
+  return (LispIndex)(((h * 2654435761U) >> 16) & mask);
+}
+/* slot of key's pair in index, or the empty slot ending its probe */
+static LispIndex *HashSlot(struct LispHashTable *t, LispObject index,
+                           LispObject key, uint32_t h) {
+  LispIndex *slots = (LispIndex *)(void *)index->string.self;
+  LispIndex mask = (LispIndex)(HASH_SLOTS(index) - 1);
+  LispIndex i = HashStart(h, mask);
+  LispObject *pairs = t->entries->vector.self, k;
+  while (slots[i] != 0) {
+    k = pairs[2 * (slots[i] - 1)];
+    if (!LISP_UNBOUNDP(k) && HashTestEqual(k, key, t->test)) {
+      break;
+    }
+    i = (LispIndex)((i + 1) & mask);
+  }
+  return &slots[i];
+}
+/* pair p, absent from index, into it */
+static void HashIndexAdd(struct LispHashTable *t, LispIndex p) {
+  LispIndex *slots = (LispIndex *)(void *)t->index->string.self;
+  LispIndex mask = (LispIndex)(HASH_SLOTS(t->index) - 1);
+  bool moving = false;
+  LispIndex i = HashStart(
+      LispHash(t->entries->vector.self[2 * p], t->test, &moving), mask);
+  while (slots[i] != 0) {
+    i = (LispIndex)((i + 1) & mask);
+  }
+  slots[i] = (LispIndex)(p + 1);
+  t->moving |= moving;
+}
+static void HashTableRehash(struct LispHashTable *t) {
+  LispIndex p, pairs = (LispIndex)(t->entries->vector.fillp / 2);
+  memset(t->index->string.self, 0, t->index->string.size);
+  t->moving = false;
+  for (p = 0; p < pairs; ++p) {
+    if (!LISP_UNBOUNDP(t->entries->vector.self[2 * p])) {
+      HashIndexAdd(t, p);
+    }
+  }
+  t->old_index = LISP_NIL;
+  t->migrated = t->migrate_end = 0;
+  t->gc_epoch = *LispNumberOfCollections();
+}
+static void HashTableMigrate(struct LispHashTable *t, LispIndex n) {
+  for (; n > 0 && t->migrated < t->migrate_end; --n, ++t->migrated) {
+    if (!LISP_UNBOUNDP(t->entries->vector.self[2 * t->migrated])) {
+      HashIndexAdd(t, t->migrated);
+    }
+  }
+  if (t->migrated >= t->migrate_end) {
+    t->old_index = LISP_NIL;
+  }
+}
+/* the index valid for the current heap, never allocates */
+static void HashTableFresh(struct LispHashTable *t) {
+  if (t->moving && t->gc_epoch != *LispNumberOfCollections()) {
+    HashTableRehash(t);
+  } else if (!LISP_NULL(t->old_index)) {
+    HashTableMigrate(t, HASH_MIGRATE_STEP);
+  }
+}
+/* the pair holding key, NOTFOUND if none */
+static LispIndex HashTableFind(struct LispHashTable *t, LispObject key) {
+  bool moving = false;
+  uint32_t h;
+  LispIndex *slot;
+  HashTableFresh(t);
+  if (t->count == 0) {
+    return NOTFOUND;
+  }
+  h = LispHash(key, t->test, &moving);
+  slot = HashSlot(t, t->index, key, h);
+  if (*slot == 0 && !LISP_NULL(t->old_index)) {
+    slot = HashSlot(t, t->old_index, key, h);
+  }
+  return (LispIndex)(*slot - 1);
+}
+LispObject HashTableGet(LispObject table, LispObject key, LispObject dflt) {
+  LispIndex p = HashTableFind(&table->hash_table, key);
+  return (p == NOTFOUND) ? dflt
+                         : table->hash_table.entries->vector.self[2 * p + 1];
+}
+bool HashTableRemove(LispObject table, LispObject key) {
+  struct LispHashTable *t = &table->hash_table;
+  LispIndex p = HashTableFind(t, key);
+  if (p == NOTFOUND) {
+    return false;
+  }
+  /* its slots now lead to an unbound key, skipped until the next rehash */
+  t->entries->vector.self[2 * p] = LISP_UNBOUND;
+  t->entries->vector.self[2 * p + 1] = LISP_NIL;
+  --t->count;
+  return true;
+}
+/* room for one more pair, the table at stack[slot] */
+static void HashTableReserve(LispIndex slot) {
+  struct LispHashTable *t = &stack[slot]->hash_table;
+  LispObject e = t->entries, index;
+  LispIndex i, n = 0, pairs = (LispIndex)(e->vector.fillp / 2);
+  uint32_t slots;
+  if (e->vector.fillp + 2u > e->vector.size && t->count <= pairs / 2) {
+    /* mostly removed pairs: squeeze them out rather than grow */
+    for (i = 0; i < e->vector.fillp; i = (LispIndex)(i + 2)) {
+      if (!LISP_UNBOUNDP(e->vector.self[i])) {
+        e->vector.self[n] = e->vector.self[i];
+        e->vector.self[n + 1] = e->vector.self[i + 1];
+        n = (LispIndex)(n + 2);
+      }
+    }
+    e->vector.fillp = n;
+    HashTableRehash(t);
+    return;
+  }
+  if (e->vector.fillp + 2u > e->vector.size) {
+    e = LispVectorResize(e, (LispIndex)(e->vector.fillp + 2));
+    stack[slot]->hash_table.entries = e;
+  }
+  t = &stack[slot]->hash_table;
+  slots = HASH_SLOTS(t->index);
+  if (2u * (pairs + 1u) > slots) {
+    if (slots >= HASH_MAX_SLOTS) {
+      LispError("hash table overflow.\n");
+    }
+    HashTableFresh(t);
+    HashTableMigrate(t, (LispIndex)-1);
+    index = LispAllocString((LispIndex)(2 * slots * sizeof(LispIndex)));
+    memset(index->string.self, 0, index->string.size);
+    t = &stack[slot]->hash_table;
+    t->old_index = t->index;
+    t->index = index;
+    t->migrated = 0;
+    t->migrate_end = pairs;
+  }
+}
+void HashTablePut(LispObject table, LispObject key, LispObject value) {
+  struct LispHashTable *t = &table->hash_table;
+  LispIndex p = HashTableFind(t, key);
+  LispObject e;
+  if (p != NOTFOUND) {
+    t->entries->vector.self[2 * p + 1] = value;
+    return;
+  }
+  PUSH(table);
+  PUSH(key);
+  PUSH(value);
+  HashTableReserve((LispIndex)(stack_index - 3));
+  t = &stack[stack_index - 3]->hash_table;
+  /* collected while reserving, a moving index is stale */
+  HashTableFresh(t);
+  e = t->entries;
+  p = (LispIndex)(e->vector.fillp / 2);
+  e->vector.self[e->vector.fillp++] = stack[stack_index - 2];
+  e->vector.self[e->vector.fillp++] = stack[stack_index - 1];
+  ++t->count;
+  if (!t->moving) {
+    t->gc_epoch = *LispNumberOfCollections();
+  }
+  HashIndexAdd(t, p);
+  POPN(3);
+}
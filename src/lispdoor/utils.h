@@ -66,10 +66,61 @@
 
 #define NOTFOUND ((LispIndex)-1)
 
-char *Int2Str(char *dest, LispIndex len, int32_t num, Byte base);
-char *Uint2Str(char *dest, LispIndex len, uint32_t num, Byte base);
-char *Float2Str(char *str, LispIndex len, float f, uint8_t precision);
-char *Double2Str(char *str, LispIndex len, double f, uint8_t precision);
+char *Int2Str(char *dest, LispIndex len, LispFixNum num, Byte base);
+char *Uint2Str(char *dest, LispIndex len, uintptr_t num, Byte base);
+/* shortest text that reads back to f, len >= 32 */
+char *Float2Str(char *str, LispIndex len, float f);
+char *Double2Str(char *str, LispIndex len, double f);
+typedef enum { kFloatNone, kFloatSingle, kFloatDouble } FloatKind;
+/* the float s spells, correctly rounded, or kFloatNone if it is no float */
+FloatKind Str2Float(const char *s, LispIndex len, float *single, double *dbl);
+/* the decimal integer s spells, correctly rounded to a double */
+double Integer2Double(const char *s, LispIndex len);
+/* first index where a and b differ, n if none */
+LispIndex StrMismatch(const char *a, const char *b, LispIndex n);
+/* first start of p (m bytes) in s (n bytes), or NOTFOUND */
+LispIndex StrSearch(const char *s, LispIndex n, const char *p, LispIndex m);
+/* typed array elements, the integers of f32 truncated */
+int32_t ArrayGetInt(LispObject a, LispIndex i);
+float ArrayGetFloat(LispObject a, LispIndex i);
+/* bulk kernels, stores saturate to the element range: fill [start, end) */
+void ArrayFill(LispObject a, LispIndex start, LispIndex end, int32_t x);
+void ArrayFillFloat(LispObject a, LispIndex start, LispIndex end, float f);
+/* src [start, end) to dst from at, converting when the types differ */
+void ArrayCopy(LispObject dst, LispIndex at, LispObject src, LispIndex start,
+               LispIndex end);
+int64_t ArraySumInt(LispObject a); /* integer types */
+float ArraySumFloat(LispObject a);
+/* index of the first least (or greatest) element, NOTFOUND when empty */
+LispIndex ArrayExtremum(LispObject a, bool max);
+/* each x to x * k / 2^shift, shifted down for integers */
+void ArrayScale(LispObject a, int32_t k, uint8_t shift);
+typedef enum { kBitAnd, kBitOr, kBitXor, kBitNot } LispBitOp;
+/* dst = x op y over bit vectors of the length of dst, y unused by kBitNot */
+void BitVectorLogic(LispObject dst, LispObject x, LispObject y, LispBitOp op);
+uint32_t BitVectorCount(LispObject bv);
+/* index of the first set bit at or after start, NOTFOUND when none */
+LispIndex BitVectorFindSet(LispObject bv, LispIndex start);
+/* Qn fixed point, n 15 or 31: x stands for x / 2^n, results saturate */
+int32_t QSaturate(int64_t x, uint8_t n);
+int32_t QMul(int32_t a, int32_t b, uint8_t n);
+int32_t QMac(int32_t acc, int32_t a, int32_t b, uint8_t n); /* acc + a * b */
+int32_t QFromDouble(double f, uint8_t n);
+/* the Qn nearest the decimal s, false when s is no decimal */
+bool Str2Fixed(const char *s, LispIndex len, uint8_t n, int32_t *x);
+/* x as it reads back, e.g. -0.25q15, into at least 20 bytes */
+char *Fixed2Str(char *str, int32_t x, uint8_t n);
+/* eql also compares floats by value, equal conses, strings and bit vectors
+ * by contents */
+bool LispEql(LispObject a, LispObject b);
+bool LispEqual(LispObject a, LispObject b);
+/* a hash of x, the same for objects alike under test; *moving is set when it
+ * is x's address, which a GC changes; moving NULL asks for a stable hash */
+uint32_t LispHash(LispObject x, uint8_t test, bool *moving);
+/* hash tables; lookups never allocate */
+LispObject HashTableGet(LispObject table, LispObject key, LispObject dflt);
+void HashTablePut(LispObject table, LispObject key, LispObject value);
+bool HashTableRemove(LispObject table, LispObject key);
 void LabelTableInit(LabelTable *t, LispIndex n);
 void LabelTableClear(LabelTable *t);
 void LabelTableInsert(LabelTable *t, LispObject item);
@@ -72,6 +72,7 @@
 
 int main() {
   LispObject expr;
+  static LispReader reader;
   extern int __stack_start__;
   stack_bottom = (Byte *)((intptr_t)&__stack_start__ + 100);
   /* TODO: HW failure */
@@ -82,10 +83,18 @@ int main() {
   LispPrintStr("LispDoor Version: " VERSION_STRING "\n");
   GC();
   setjmp(LispEnv()->top_level);
+  /* an error leaves the stack as it was raised, with its garbage rooted */
+  stack_index = 0;
+  LispReaderInit(&reader);
 
   while (1) {
     LispPrintStr("> ");
-    expr = ReadSexpr();
+    LispPortFlush(&lisp_uart_port);
+    while (LispReaderPoll(&reader, &expr) == kReadMore) {
+      if (!BspIdle()) {
+        BspWaitInput();
+      }
+    }
     expr = TopLevelEval(expr);
     LispPrintObject(expr, false);
     LispPrintStr("\n\n");
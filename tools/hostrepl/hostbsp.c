@@ -0,0 +1,174 @@
+/*
+ *    \file hostbsp.c
+ *
+ * Copyright (c) 2020 Islam Omar (io1131@fayoum.edu.eg)
+ *
+ * This file is part of LispDoor.
+ *
+ *     LispDoor is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     LispDoor is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with LispDoor.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This file incorporates work covered by the following copyrights and
+ * permission notices:
+ *
+ *    Copyright (c) 2008 Jeff Bezanson
+ *
+ *    All rights reserved.
+ *
+ *    Redistribution and use in source and binary forms, with or without
+ *    modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *        * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *        * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *        * Neither the author nor the names of any contributors may be used to
+ *          endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ *    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *    Copyright (c) 1984, Taiichi Yuasa and Masami Hagiya.
+ *    Copyright (c) 1990, Giuseppe Attardi.
+ *    Copyright (c) 2001, Juan Jose Garcia Ripoll.
+ *
+ *    ECL is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Library General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2 of the License, or (at your option) any later version.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hal/bsp.h"
+#include "hal/qassert.h"
+#include "lispdoor/memorylayout.h"
+
+/* main.c takes the lisp stack bottom from the linker script symbol */
+int __stack_start__;
+
+/* Plays the uart rx dma of src/hal/bsp.c: bytes go into the ring as they
+ * arrive, whether the reader is keeping up or not, and the insert index only
+ * moves on "idle line" (the pipe ran dry) and at the half and full ring marks.
+ * An overrun is counted each time a byte lands on one the reader has not
+ * consumed (or may still un-read). */
+static Byte dma_index;
+static unsigned long rx_bytes, rx_overruns;
+static volatile unsigned long rx_waits; /* calls to BspWaitInput */
+
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void Pause(double seconds) {
+  struct timespec ts;
+  ts.tv_sec = (time_t)seconds;
+  ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+  nanosleep(&ts, NULL);
+}
+
+static void RxSync() {
+  __sync_synchronize();
+  terminal_buffer_insert_index = dma_index;
+}
+
+static void RxByte(Byte c) {
+  if ((Byte)(dma_index - terminal_buffer_get_index) == TIB_SIZE - 1) {
+    ++rx_overruns;
+  }
+  terminal_buffer[dma_index] = c;
+  dma_index = (Byte)((dma_index + 1) & (TIB_SIZE - 1));
+  ++rx_bytes;
+  if ((dma_index & (TIB_SIZE / 2 - 1)) == 0) {
+    RxSync(); /* half transfer / transfer complete */
+  }
+}
+
+static void *HostRx(void *arg) {
+  /* 8N1: ten bit times per byte */
+  const double baud = (double)(intptr_t)arg;
+  const double byte_time = baud > 0 ? 10.0 / baud : 0;
+  Byte chunk[64];
+  ssize_t n, i;
+  double start = Now(), due = start, elapsed;
+  unsigned long waits;
+
+  while ((n = read(STDIN_FILENO, chunk, sizeof(chunk))) > 0) {
+    for (i = 0; i < n; ++i) {
+      due += byte_time;
+      /* sleep in slices of a millisecond or more, like bytes on the wire */
+      if (due - Now() > 1e-3) {
+        Pause(due - Now());
+      }
+      RxByte(chunk[i]);
+    }
+    RxSync(); /* idle line */
+  }
+  while (terminal_buffer_get_index != terminal_buffer_insert_index) {
+    Pause(1e-3);
+  }
+  elapsed = Now() - start;
+  /* the last form has printed once the repl waits for more input */
+  waits = rx_waits;
+  while (rx_waits == waits) {
+    Pause(1e-3);
+  }
+  fprintf(stderr, "\nhostrepl: %lu bytes in %.3f s (%.0f bytes/s), %lu overruns\n",
+          rx_bytes, elapsed, elapsed > 0 ? (double)rx_bytes / elapsed : 0.0,
+          rx_overruns);
+  fflush(stdout);
+  _exit(rx_overruns ? 1 : 0);
+}
+
+void BspInit() {
+  pthread_t t;
+  const char *baud = getenv("LISPDOOR_BAUD");
+  if (pthread_create(&t, NULL, HostRx,
+                     (void *)(intptr_t)(baud ? atol(baud) : 115200)) != 0) {
+    fprintf(stderr, "hostrepl: error: cannot start uart thread\n");
+    exit(1);
+  }
+  pthread_detach(t);
+}
+void BspWaitInput() {
+  ++rx_waits;
+  Pause(1e-5);
+}
+__attribute__((weak)) bool BspIdle() { return false; }
+
+void UART1_SendStr(char *s) { fputs(s, stdout); }
+void UART1_SendStrN(char *s, uint16_t len) { fwrite(s, 1, len, stdout); }
+void UART1_SendByte(uint8_t s) { fputc(s, stdout); }
+void UART1_Flush() { fflush(stdout); }
+
+Q_NORETURN Q_onAssert(char const *const module, int_t const id) {
+  fprintf(stderr, "assertion failed: %s %d\n", module, id);
+  exit(2);
+}
@@ -0,0 +1,186 @@
+/*
+ *    \file circle.c
+ *
+ * Copyright (c) 2020 Islam Omar (io1131@fayoum.edu.eg)
+ *
+ * This file is part of LispDoor.
+ *
+ *     LispDoor is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     LispDoor is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with LispDoor.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This file incorporates work covered by the following copyrights and
+ * permission notices:
+ *
+ *    Copyright (c) 2008 Jeff Bezanson
+ *
+ *    All rights reserved.
+ *
+ *    Redistribution and use in source and binary forms, with or without
+ *    modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *        * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *        * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *        * Neither the author nor the names of any contributors may be used to
+ *          endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ *    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *    Copyright (c) 1984, Taiichi Yuasa and Masami Hagiya.
+ *    Copyright (c) 1990, Giuseppe Attardi.
+ *    Copyright (c) 2001, Juan Jose Garcia Ripoll.
+ *
+ *    ECL is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Library General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2 of the License, or (at your option) any later version.
+ */
+
+/*
+ * circle: printing and reading deeply shared structure with labels
+ *
+ *     circle [n [runs]]
+ *
+ * builds the list of cells c0 = (leaf), ci = (ci-1 . ci-1) for i < n, each
+ * sharing the one before twice, so 2^n paths lead through n cells, prints it
+ * with *print-circle* t as (#0=(leaf) #1=(#0# . #0#) ... (#n-2# . #n-2#)),
+ * reads that back and prints it again. Times are per print and per read, gc
+ * included.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "lispdoor/functions.h"
+#include "lispdoor/memorylayout.h"
+#include "lispdoor/objects.h"
+#include "lispdoor/print.h"
+#undef EOF /* the reader's EOF is a byte */
+#include "lispdoor/read.h"
+#include "lispdoor/symboltree.h"
+
+/* the text of the list, as the printer must write it */
+static size_t Expected(char *text, int n) {
+  size_t len = (size_t)sprintf(text, "(#0=(leaf)");
+  int i;
+  for (i = 1; i < n - 1; ++i) {
+    len += (size_t)sprintf(text + len, " #%d=(#%d# . #%d#)", i, i - 1, i - 1);
+  }
+  len += (size_t)sprintf(text + len, " (#%d# . #%d#))", n - 2, n - 2);
+  return len;
+}
+
+/* the printed text of stack[slot] into out, runs times; us per print */
+static double Print(LispPort *out, char *buf, size_t size, LispIndex slot,
+                    int runs) {
+  LispPort *port = print_port;
+  double start = BenchNow();
+  int i;
+  print_port = out;
+  for (i = 0; i < runs; ++i) {
+    LispPortInitBuffer(out, buf, (uint32_t)size);
+    LispPrintObject(stack[slot], false);
+  }
+  print_port = port;
+  return (BenchNow() - start) / runs * 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  static LispStream in;
+  static LispPort out;
+  /* static, they live across the setjmp */
+  static int n, runs;
+  static size_t size, len;
+  static char *text, *printed;
+  LispObject cell;
+  LispIndex base;
+  double start, print_us, read_us;
+  int i;
+
+  n = argc > 1 ? atoi(argv[1]) : 200;
+  runs = argc > 2 ? atoi(argv[2]) : 100;
+  size = 32 * (size_t)n + 64;
+  text = malloc(size);
+  printed = malloc(size);
+  if (n < 2 || runs < 1 || text == NULL || printed == NULL) {
+    fprintf(stderr, "usage: circle [n [runs]], n >= 2\n");
+    return 1;
+  }
+  len = Expected(text, n);
+
+  stack_bottom = NULL;
+  if (setjmp(LispEnv()->top_level) != 0) {
+    fprintf(stderr, "\ncircle: lisp error, a bigger heap may help\n");
+    return 1;
+  }
+  LispInit();
+  LispMakeSymbol("*print-circle*")->symbol.value = LISP_T;
+  base = stack_index;
+
+  /* stack[base] the list, stack[base + 1] the last cell */
+  PUSH(LISP_NIL);
+  cell = LispMakeSymbol("leaf");
+  PUSH(cons(cell, LISP_NIL));
+  stack[base] = cons(stack[base + 1], LISP_NIL);
+  for (i = 1; i < n; ++i) {
+    stack[base + 1] = cons(stack[base + 1], stack[base + 1]);
+    stack[base] = cons(stack[base + 1], stack[base]);
+  }
+  /* the cells were consed in front, put c0 first */
+  cell = LISP_NIL;
+  while (LISP_ConsP(stack[base])) {
+    LispObject next = LISP_CONS_CDR(stack[base]);
+    LISP_CONS_CDR(stack[base]) = cell;
+    cell = stack[base];
+    stack[base] = next;
+  }
+  stack[base] = cell;
+
+  print_us = Print(&out, printed, size, base, runs);
+  if (out.fill != len || memcmp(printed, text, len) != 0) {
+    fprintf(stderr, "circle: printed %.*s\n", (int)out.fill, printed);
+    return 1;
+  }
+
+  start = BenchNow();
+  for (i = 0; i < runs; ++i) {
+    stack_index = (LispIndex)(base + 1);
+    LispStreamInitMemory(&in, (const uint8_t *)text, (uint32_t)len);
+    stack[base + 1] = ReadSexpr(&in);
+  }
+  read_us = (BenchNow() - start) / runs * 1e6;
+  Print(&out, printed, size, (LispIndex)(base + 1), 1);
+  if (out.fill != len || memcmp(printed, text, len) != 0) {
+    fprintf(stderr, "circle: read back as %.*s\n", (int)out.fill, printed);
+    return 1;
+  }
+
+  printf("circle: %d shared cells, %zu bytes: print %.1f us, read %.1f us\n",
+         n, len, print_us, read_us);
+  return 0;
+}
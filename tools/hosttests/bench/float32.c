@@ -0,0 +1,204 @@
+/*
+ *    \file float32.c
+ *
+ * Copyright (c) 2020 Islam Omar (io1131@fayoum.edu.eg)
+ *
+ * This file is part of LispDoor.
+ *
+ *     LispDoor is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     LispDoor is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with LispDoor.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This file incorporates work covered by the following copyrights and
+ * permission notices:
+ *
+ *    Copyright (c) 2008 Jeff Bezanson
+ *
+ *    All rights reserved.
+ *
+ *    Redistribution and use in source and binary forms, with or without
+ *    modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *        * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *        * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *        * Neither the author nor the names of any contributors may be used to
+ *          endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ *    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *    Copyright (c) 1984, Taiichi Yuasa and Masami Hagiya.
+ *    Copyright (c) 1990, Giuseppe Attardi.
+ *    Copyright (c) 2001, Juan Jose Garcia Ripoll.
+ *
+ *    ECL is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Library General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2 of the License, or (at your option) any later version.
+ */
+
+/*
+ * float32: every float32 prints as text that reads back to it
+ *
+ *     float32 [stride [runs]]
+ *
+ * checks the bit patterns 0, stride, 2 stride, ... below 2^32, and both signs
+ * of each power of two and its neighbours: a finite float must print through
+ * Float2Str as text that Str2Float and strtof both read back to the same bits,
+ * inf and nan must print as such. An odd stride reaches every exponent; stride
+ * 1 checks all 2^32 patterns, which takes some minutes. Then times Float2Str,
+ * Str2Float and strtof over 4096 spread floats, runs passes each.
+ */
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "lispdoor/utils.h"
+
+#define N_TIMED 4096
+
+static uint64_t checked;
+
+static float FromBits(uint32_t u) {
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+static uint32_t Bits(float f) {
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+/* false, with a report, unless pattern u prints and reads back */
+static bool Check(uint32_t u) {
+  char text[32];
+  float f = FromBits(u), single;
+  double dbl;
+  FloatKind kind;
+  ++checked;
+  Float2Str(text, sizeof(text), f);
+  if (isnan(f) || isinf(f)) {
+    const char *want = isnan(f) ? "nan" : (u >> 31) ? "-inf" : "inf";
+    if (strcmp(text, want) == 0) {
+      return true;
+    }
+    fprintf(stderr, "float32: 0x%08" PRIx32 " printed %s\n", u, text);
+    return false;
+  }
+  kind = Str2Float(text, (LispIndex)strlen(text), &single, &dbl);
+  if (kind != kFloatSingle || Bits(single) != u) {
+    fprintf(stderr, "float32: 0x%08" PRIx32 " printed %s, read back as %s\n",
+            u, text, kind == kFloatSingle ? "another float" : "no float");
+    return false;
+  }
+  if (Bits(strtof(text, NULL)) != u) {
+    fprintf(stderr, "float32: 0x%08" PRIx32 " printed %s, strtof reads %a\n",
+            u, text, (double)strtof(text, NULL));
+    return false;
+  }
+  return true;
+}
+
+/* ns (and cycles, 0 if unknown) per call of what over the timed floats */
+enum { kPrint, kRead, kStrtof };
+static double Time(int what, const float *f, char (*text)[32], int runs,
+                   double *cycles) {
+  volatile float sink = 0;
+  float single;
+  double dbl, start = BenchNow();
+  uint64_t c0 = BenchCycles();
+  int r, i;
+  for (r = 0; r < runs; ++r) {
+    for (i = 0; i < N_TIMED; ++i) {
+      if (what == kPrint) {
+        Float2Str(text[i], sizeof(text[i]), f[i]);
+      } else if (what == kRead) {
+        Str2Float(text[i], (LispIndex)strlen(text[i]), &single, &dbl);
+        sink = single;
+      } else {
+        sink = strtof(text[i], NULL);
+      }
+    }
+  }
+  (void)sink;
+  *cycles = (double)(BenchCycles() - c0) / ((double)runs * N_TIMED);
+  return (BenchNow() - start) / ((double)runs * N_TIMED) * 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  static float f[N_TIMED];
+  static char text[N_TIMED][32];
+  uint64_t stride = argc > 1 ? strtoull(argv[1], NULL, 0) : 4099;
+  int runs = argc > 2 ? atoi(argv[2]) : 100;
+  double print_ns, read_ns, strtof_ns, print_cycles, read_cycles, cycles;
+  uint64_t u;
+  uint32_t e;
+  bool ok = true;
+  int i;
+
+  if (stride < 1 || runs < 1) {
+    fprintf(stderr, "usage: float32 [stride [runs]], stride >= 1\n");
+    return 1;
+  }
+  for (u = 0; u <= UINT32_MAX; u += stride) {
+    ok &= Check((uint32_t)u);
+  }
+  for (e = 0; e < 256; ++e) {
+    uint32_t power = e << 23, sign;
+    for (sign = 0; sign <= 1; ++sign) {
+      ok &= Check(power | sign << 31);
+      ok &= Check((power + 1) | sign << 31);
+      ok &= Check(((power - 1) & 0x7fffffff) | sign << 31);
+    }
+  }
+  if (!ok) {
+    return 1;
+  }
+
+  /* spread over the patterns by a stride prime to 2^32, finite only */
+  for (i = 0, u = 0; i < N_TIMED; u += 1048573) {
+    float x = FromBits((uint32_t)u);
+    if (isfinite(x)) {
+      f[i++] = x;
+    }
+  }
+  print_ns = Time(kPrint, f, text, runs, &print_cycles);
+  read_ns = Time(kRead, f, text, runs, &read_cycles);
+  strtof_ns = Time(kStrtof, f, text, runs, &cycles);
+
+  printf("float32: %" PRIu64 " patterns round-trip\n", checked);
+  printf("float32: per number Float2Str %.1f ns, Str2Float %.1f ns, "
+         "strtof %.1f ns\n", print_ns, read_ns, strtof_ns);
+  if (cycles > 0) {
+    printf("float32: per number Float2Str %.0f cycles, Str2Float %.0f cycles, "
+           "strtof %.0f cycles\n", print_cycles, read_cycles, cycles);
+  }
+  return 0;
+}
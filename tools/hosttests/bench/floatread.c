@@ -0,0 +1,293 @@
+/*
+ *    \file floatread.c
+ *
+ * Copyright (c) 2020 Islam Omar (io1131@fayoum.edu.eg)
+ *
+ * This file is part of LispDoor.
+ *
+ *     LispDoor is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     LispDoor is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with LispDoor.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This file incorporates work covered by the following copyrights and
+ * permission notices:
+ *
+ *    Copyright (c) 2008 Jeff Bezanson
+ *
+ *    All rights reserved.
+ *
+ *    Redistribution and use in source and binary forms, with or without
+ *    modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *        * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *        * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *        * Neither the author nor the names of any contributors may be used to
+ *          endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ *    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *    Copyright (c) 1984, Taiichi Yuasa and Masami Hagiya.
+ *    Copyright (c) 1990, Giuseppe Attardi.
+ *    Copyright (c) 2001, Juan Jose Garcia Ripoll.
+ *
+ *    ECL is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Library General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2 of the License, or (at your option) any later version.
+ */
+
+/*
+ * floatread: float literals read correctly rounded
+ *
+ *     floatread [count [runs]]
+ *
+ * reads float texts through Str2Float as singles (marker e) and as doubles
+ * (marker d) and compares the bits with strtof and strtod, which round
+ * correctly: the edges of overflow to inf and of underflow through the
+ * subnormals, count random literals, and the points halfway between count
+ * random pairs of neighbouring floats and doubles, subnormals included, with
+ * the floats just above and below them. Double halfway points need up to 767
+ * digits and are cut to the 128 the reader keeps, and also to 17 to 40, around
+ * the 19 digits its first estimate holds. Then times Str2Float and strtof on
+ * 4096 short literals, runs passes each.
+ */
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "lispdoor/utils.h"
+
+#define N_TIMED 4096
+
+static uint64_t checked;
+
+/* texts on the edges of the formats, with e markers */
+static const char *const edges[] = {
+    "0.0", "-0.0", "0e999999", "1e-99999", "1e99999", "-1e99999",
+    /* float overflow: FLT_MAX, halfway above it (ties to inf), and below */
+    "3.4028235e38", "3.4028236e38", "3.40282357e38", "1e39",
+    "340282356779733661637539395458142568448.0",
+    "340282356779733661637539395458142568447.9999",
+    /* double overflow */
+    "1.7976931348623157e308", "1.7976931348623158e308",
+    "1.797693134862315807937289714053e308",
+    "1.797693134862315807937289714054e308", "1e309",
+    /* float subnormals and underflow */
+    "1.4e-45", "1.401298464324817e-45", "7.006492321624085e-46",
+    "7.006492321624086e-46", "7e-46", "1e-46", "1.1754942e-38",
+    "1.17549435e-38", "5.877471754111438e-39",
+    /* double subnormals and underflow */
+    "4.9e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+    "2.2250738585072011e-308", "2.2250738585072014e-308", "1e-400",
+    /* exact, past 19 digits, long runs of zeros */
+    "9007199254740993.0", "9007199254740993.00000000000000000001",
+    "16777217.0", "16777217.000000000000000000000001", "0.1", "1.5",
+    "123456789012345678901234567890e-30", "0.000000000000000000000000001e27",
+};
+
+/* false, with a report, unless text reads as strtof or strtod do */
+static bool Check(const char *text) {
+  char lisp[200];
+  size_t len = strlen(text);
+  float single, want_single = strtof(text, NULL);
+  double dbl, want_dbl = strtod(text, NULL);
+  char *e;
+  ++checked;
+  if (Str2Float(text, (LispIndex)len, &single, &dbl) != kFloatSingle ||
+      memcmp(&single, &want_single, sizeof(single)) != 0) {
+    fprintf(stderr, "floatread: %s read as single %a, strtof %a\n", text,
+            (double)single, (double)want_single);
+    return false;
+  }
+  /* the same text with a d marker */
+  memcpy(lisp, text, len + 1);
+  e = strchr(lisp, 'e');
+  if (e != NULL) {
+    *e = 'd';
+  } else {
+    memcpy(lisp + len, "d0", 3);
+  }
+  if (Str2Float(lisp, (LispIndex)strlen(lisp), &single, &dbl) !=
+          kFloatDouble ||
+      memcmp(&dbl, &want_dbl, sizeof(dbl)) != 0) {
+    fprintf(stderr, "floatread: %s read as double %a, strtod %a\n", lisp, dbl,
+            want_dbl);
+    return false;
+  }
+  return true;
+}
+
+/* a literal of 1 to 20 random digits with a random point and exponent */
+static void RandomLiteral(char *text, uint64_t *state) {
+  uint64_t r = BenchRandom(state);
+  int digits = 1 + (int)(r % 20), point = (int)((r >> 8) % (unsigned)digits);
+  int exponent = (int)((r >> 16) % 700) - 350, i;
+  char *p = text;
+  if ((r >> 32) & 1) {
+    *p++ = '-';
+  }
+  for (i = 0; i < digits; ++i) {
+    *p++ = (char)('0' + BenchRandom(state) % 10);
+    if (i == point) {
+      *p++ = '.';
+    }
+  }
+  if (point == digits - 1) {
+    *p++ = '0';
+  }
+  sprintf(p, "e%d", exponent);
+}
+
+/* u and a neighbour, their halfway point and the doubles next to it */
+static bool CheckFloatHalfway(uint32_t u) {
+  char text[200];
+  float lo, hi;
+  double mid, around[3];
+  int i;
+  bool ok = true;
+  u &= 0x7f7fffff; /* finite and below FLT_MAX */
+  memcpy(&lo, &u, sizeof(lo));
+  hi = nextafterf(lo, INFINITY);
+  mid = ((double)lo + (double)hi) / 2; /* exact, 25 bits */
+  around[0] = mid;
+  around[1] = nextafter(mid, -INFINITY);
+  around[2] = nextafter(mid, INFINITY);
+  for (i = 0; i < 3; ++i) {
+    snprintf(text, sizeof(text), "%.127e", around[i]);
+    ok &= Check(text);
+  }
+  return ok;
+}
+
+/* the halfway point of u and its neighbour, cut to some lengths */
+static bool CheckDoubleHalfway(uint64_t u) {
+#if LDBL_MANT_DIG >= 54
+  static const int cuts[] = {127, 16, 17, 18, 19, 20, 24, 40};
+  char text[200];
+  double lo, hi;
+  long double mid;
+  size_t i;
+  bool ok = true;
+  u &= 0x7fefffffffffffffULL; /* finite and below DBL_MAX */
+  memcpy(&lo, &u, sizeof(lo));
+  hi = nextafter(lo, INFINITY);
+  mid = ((long double)lo + (long double)hi) / 2; /* exact, 54 bits */
+  for (i = 0; i < sizeof(cuts) / sizeof(cuts[0]); ++i) {
+    snprintf(text, sizeof(text), "%.*Le", cuts[i], mid);
+    ok &= Check(text);
+  }
+  return ok;
+#else
+  (void)u;
+  return true; /* no wider type to hold the halfway point */
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  static char text[N_TIMED][32];
+  uint64_t count = argc > 1 ? strtoull(argv[1], NULL, 0) : 100000;
+  int runs = argc > 2 ? atoi(argv[2]) : 100;
+  uint64_t state = 0x9e3779b97f4a7c15ULL, n;
+  double start, read_ns, strtof_ns, read_cycles, cycles;
+  volatile float sink = 0;
+  float single;
+  double dbl;
+  uint64_t c0;
+  size_t i;
+  bool ok = true;
+  int r;
+
+  if (runs < 1) {
+    fprintf(stderr, "usage: floatread [count [runs]]\n");
+    return 1;
+  }
+  for (i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+    ok &= Check(edges[i]);
+  }
+  for (n = 0; n < count; ++n) {
+    char literal[64];
+    uint64_t u = BenchRandom(&state);
+    RandomLiteral(literal, &state);
+    ok &= Check(literal);
+    /* one in four in the subnormals */
+    ok &= CheckFloatHalfway((n & 3) ? (uint32_t)u : (uint32_t)u & 0x807fffff);
+    ok &= CheckDoubleHalfway((n & 3) ? u : u & 0x800fffffffffffffULL);
+  }
+  if (!ok) {
+    return 1;
+  }
+
+  /* short literals as source spells them: up to 7 digits, small exponents */
+  for (i = 0; i < N_TIMED; ++i) {
+    uint64_t r = BenchRandom(&state);
+    int digits = 1 + (int)(r % 7);
+    double x = (double)(r >> 8 & 0xffffff) / 1e4;
+    if ((r >> 40) & 1) {
+      snprintf(text[i], sizeof(text[i]), "%.*g", digits, x);
+      if (strchr(text[i], '.') == NULL && strchr(text[i], 'e') == NULL) {
+        strcat(text[i], ".5");
+      }
+    } else {
+      snprintf(text[i], sizeof(text[i]), "%.*e", digits - 1,
+               x * pow(10, (double)((int)(r >> 48 & 31) - 15)));
+    }
+  }
+  start = BenchNow();
+  c0 = BenchCycles();
+  for (r = 0; r < runs; ++r) {
+    for (i = 0; i < N_TIMED; ++i) {
+      Str2Float(text[i], (LispIndex)strlen(text[i]), &single, &dbl);
+      sink = single;
+    }
+  }
+  read_cycles = (double)(BenchCycles() - c0) / ((double)runs * N_TIMED);
+  read_ns = (BenchNow() - start) / ((double)runs * N_TIMED) * 1e9;
+  start = BenchNow();
+  c0 = BenchCycles();
+  for (r = 0; r < runs; ++r) {
+    for (i = 0; i < N_TIMED; ++i) {
+      sink = strtof(text[i], NULL);
+    }
+  }
+  cycles = (double)(BenchCycles() - c0) / ((double)runs * N_TIMED);
+  strtof_ns = (BenchNow() - start) / ((double)runs * N_TIMED) * 1e9;
+  (void)sink;
+
+  printf("floatread: %" PRIu64 " texts read as strtof and strtod do\n",
+         checked);
+  printf("floatread: per short literal Str2Float %.1f ns, strtof %.1f ns\n",
+         read_ns, strtof_ns);
+  if (cycles > 0) {
+    printf("floatread: per short literal Str2Float %.0f cycles, "
+           "strtof %.0f cycles\n", read_cycles, cycles);
+  }
+  return 0;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+# expect.sh hostrepl test.lisp: the results of test.lisp must be test.out
+repl=$1 test=$2
+out=$(sh "$(dirname "$0")/repl.sh" "$repl" "$test") || exit 1
+printf '%s\n' "$out" | diff -u "${test%.lisp}.out" -
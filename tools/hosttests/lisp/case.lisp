@@ -0,0 +1,29 @@
+(set 'f (lambda (x) (case x ((a) 1) ((b c) 2) ((d) 3) ((5 6) 4) ((#\z) 5) (t 6))))
+f
+(f 'a)
+(f 'c)
+(f 6)
+(f #\z)
+(f 'zz)
+(f (vector 1 2 3))
+(gc)
+(f 'd)
+(f 5)
+(set 'g (lambda (x) (case x ((a b c d e) 'first) ((a) 'shadowed) (otherwise 'none))))
+(g 'a)
+(g 'e)
+(g 'q)
+(case (vector 1 2 3) ((x) 1) (t 'default))
+(case 3 (("str") 1) ((3) 'three) (t 'default))
+(set 'form '(case k ((a) 1) ((b) 2) ((c) 3) ((d) 4) (t 0)))
+(set 'k 'c)
+(eval form)
+form
+(set 'n 0)
+(while (< n 40) (eval (cons 'case (cons 'k (cdr (cdr form))))) (set 'n (+ n 1)))
+(gc)
+(set '*optimize* t)
+(set 'h (lambda (x) (case x ((a) 1) ((b) 2) ((c) 3) ((d) 4) ((e) 5) (t 0))))
+h
+(h 'e)
+(h 'x)
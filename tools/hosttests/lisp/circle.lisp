@@ -0,0 +1,27 @@
+; large shared and cyclic structure prints with labels and reads back
+(set '*print-circle* t)
+(set 'c (cons 'leaf nil))
+(set 'l (cons c nil))
+(set 'n 1)
+(while (< n 60) (set 'c (cons c c)) (set 'l (cons c l)) (set 'n (+ n 1)))
+(set 's (prin1-to-string l))
+(string-length s)
+(substring s 0 40)
+(set 'r (read-from-string s))
+(string= s (prin1-to-string r))
+(eq (car (car r)) (cdr (car r)))
+(set 'ring (cons 1 (cons 2 (cons 3 nil))))
+(rplacd (cdr (cdr ring)) ring)
+ring
+(set 'ring2 (read-from-string (prin1-to-string ring)))
+(eq ring2 (cdr (cdr (cdr ring2))))
+'(#1=(a b) #1# #2=(c . #2#) #1#)
+(set 'v (vector 1 2 3 4 5 6))
+(aset v 0 v)
+(aset v 5 (cons v v))
+v
+(set 'v2 (read-from-string (prin1-to-string v)))
+(eq v2 (aref v2 0))
+(eq v2 (car (aref v2 5)))
+(set '*print-circle* nil)
+ring
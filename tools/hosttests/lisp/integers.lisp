@@ -0,0 +1,18 @@
+; host fixnums have 62 bits, past them integers read as doubles
+123456789012345678901234567890
+-123456789012345678901234567890
+2305843009213693951
+2305843009213693952
+-2305843009213693952
+-2305843009213693953
+(fixnump 2305843009213693951)
+(fixnump 2305843009213693952)
+0x7fffffff
+0xFFFFFFFFFFFFFFFF
+0x10000000000000000
+-0b1
+017
+(read-from-string "18446744073709551616")
+(read-from-string "9007199254740993")
+#2305843009213693952=(a)
+(+ 1 2)
@@ -0,0 +1,33 @@
+; a labelled vector that grows while it is read keeps its identity
+(set '*print-circle* t)
+(set 'z '#2=#(#2# (a) (b) (c) (d) (e)))
+(eq z (aref z 0))
+(set 'y (read-from-string "#1=(x #2=#(#1# #2# 1 2 3 4 5 6 7 8 9 #2#) #2#)"))
+(eq (car (cdr y)) (aref (car (cdr y)) 1))
+(eq (car (cdr y)) (aref (car (cdr y)) 11))
+(eq (car (cdr y)) (car (cdr (cdr y))))
+(eq y (aref (car (cdr y)) 0))
+y
+(set 's "#3=#((a #3#) (b . #3#) #(#3#) c d e f g h i j k l m n o p #3#)")
+(set 'n 0)
+(set 'ok t)
+(while (< n 200) (set 'x (read-from-string s)) (set 'ok (and ok (eq x (car (cdr (aref x 0)))) (eq x (cdr (aref x 1))) (eq x (aref (aref x 2) 0)) (eq x (aref x 17)))) (set 'n (+ n 1)))
+ok
+x
+; vector-push fills in place and never copies
+(set 'v (make-vector 3 nil 0))
+(set 'same v)
+(vector-push 'a v)
+(vector-push 'b v)
+(vector-push 'c v)
+v
+(eq v same)
+(vector-push 'd v)
+(set 'w (make-vector 2 0 1))
+(vector-push 1 w)
+(length w)
+(vector-pop w)
+(vector-push 2 w)
+w
+(make-vector 2 nil 3)
+(make-vector 2 nil -1)
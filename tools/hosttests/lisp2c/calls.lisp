@@ -0,0 +1,37 @@
+(fact 10)
+(fact 0)
+(fib 15)
+(sum-squares 10)
+(len '(a b c d))
+(len nil)
+(rev '(1 2 3 4))
+(classify 0)
+(classify 2)
+(classify 'b)
+(classify "x")
+(sign -5)
+(sign 0)
+(sign 7)
+(both 1 2)
+(both nil 2)
+(either nil 2)
+(either nil nil)
+(kind 1)
+(kind 'a)
+(kind '(1))
+(kind nil)
+(kind "s")
+(mix 3 4)
+last-mix
+(quoted)
+(nth-of 2 '(a b c d))
+(scale 2)
+(scale 2.5)
+(+ (sq 3) 1)
+(range 12)
+(len (range 5))
+(join "ab" "cd")
+(hyphen-name 1)
+(hyphen_name 1)
+(fact 'x)
+(car (rev '(x y z)))
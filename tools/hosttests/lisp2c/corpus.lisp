@@ -0,0 +1,67 @@
+; Definitions compiled by lisp2c and interpreted, differential.sh compares
+; the results of calls.lisp under both. Only forms lisp2c accepts go here.
+
+(define-inline sq (x) (* x x))
+
+(set 'fact (lambda (n) (if (< n 2) 1 (* n (fact (- n 1))))))
+
+(set 'fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))
+
+(set 'sum-squares
+     (lambda (n)
+       (progn
+         (set 'acc 0)
+         (while (< 0 n)
+           (set 'acc (+ acc (sq n)))
+           (set 'n (- n 1)))
+         acc)))
+
+(set 'len (lambda (l) (cond ((atom l) 0) (t (+ 1 (len (cdr l)))))))
+
+(set 'rev2 (lambda (l acc) (if (consp l) (rev2 (cdr l) (cons (car l) acc)) acc)))
+
+(set 'rev (lambda (l) (rev2 l nil)))
+
+(set 'classify
+     (lambda (x)
+       (case x
+         ((0) 'zero)
+         ((1 2 3) 'small)
+         ((a b) 'letter)
+         (t 'other))))
+
+(set 'sign
+     (lambda (x)
+       (cond ((< x 0) -1)
+             ((eq x 0) 0)
+             (t 1))))
+
+(set 'both (lambda (a b) (and a b)))
+
+(set 'either (lambda (a b) (or a b)))
+
+(set 'kind
+     (lambda (x)
+       (cond ((fixnump x) 'fixnum)
+             ((symbolp x) 'symbol)
+             ((consp x) 'cons)
+             ((not x) 'nil)
+             (t 'other))))
+
+(set 'mix (lambda (a b) (progn (set 'last-mix (cons a b)) (+ a b))))
+
+(set 'quoted (lambda () '(1 "two" #\3 (4 . 5))))
+
+(set 'nth-of (lambda (n l) (if (eq n 0) (car l) (nth-of (- n 1) (cdr l)))))
+
+(set 'scale (lambda (x) (* x 1.5)))
+
+(set 'range2 (lambda (i n acc) (if (< i n) (range2 (+ i 1) n (cons i acc)) acc)))
+
+(set 'range (lambda (n) (rev (range2 0 n nil))))
+
+(set 'join (lambda (a b) (string-append a b)))
+
+(set 'hyphen-name (lambda (x) (cons 'dash x)))
+
+(set 'hyphen_name (lambda (x) (cons 'underscore x)))
@@ -0,0 +1,27 @@
+#!/bin/sh
+# differential.sh hostrepl hostrepl_compiled corpus.lisp calls.lisp: the calls
+# must print the same under the interpreter, the interpreter with *optimize*,
+# and the repl with the corpus compiled in by lisp2c
+set -e
+repl=$1 compiled=$2 corpus=$3 calls=$4
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+here=$(dirname "$0")
+echo "'calls" >"$dir/marker"
+echo "(set '*optimize* t)" >"$dir/optimize"
+
+# the results printed after the marker
+run() {
+  out=$1
+  shift
+  sh "$here/../repl.sh" "$@" >"$dir/raw"
+  awk 'after { print } /^calls$/ { after = 1 }' "$dir/raw" >"$dir/$out"
+}
+
+run interpreted "$repl" "$corpus" "$dir/marker" "$calls"
+run optimized "$repl" "$dir/optimize" "$corpus" "$dir/marker" "$calls"
+run compiled "$compiled" "$dir/marker" "$calls"
+
+test "$(wc -l <"$dir/interpreted")" -eq "$(grep -c . "$calls")"
+diff -u "$dir/interpreted" "$dir/optimized"
+diff -u "$dir/interpreted" "$dir/compiled"
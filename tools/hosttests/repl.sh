@@ -0,0 +1,14 @@
+#!/bin/sh
+# repl.sh hostrepl [file ...]: feed the files to the host repl at the firmware
+# baud and print the results one per line, without the banner, prompts, blank
+# lines and gc reports; fails if the repl does, on an rx overrun. The repl's
+# receive report goes to $REPL_STATS when set
+repl=$1
+shift
+out=$(cat "$@" |
+  LISPDOOR_BAUD=${LISPDOOR_BAUD:-115200} "$repl" 2>"${REPL_STATS:-/dev/null}") || {
+  echo "repl.sh: $repl failed" >&2
+  exit 1
+}
+printf '%s\n' "$out" |
+  sed -e 's/^\(> \)*//' -e '/^LispDoor Version: /d' -e '/^gc: found /d' -e '/^$/d'
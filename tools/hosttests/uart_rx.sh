@@ -0,0 +1,42 @@
+#!/bin/sh
+# uart_rx.sh hostrepl [baud ...]: stream a few kilobytes of forms into the
+# repl at each baud, 115200 (the firmware's) when none is given; every byte
+# must arrive without an rx ring overrun and every form must be evaluated
+set -e
+repl=$1
+shift
+[ $# -gt 0 ] || set -- 115200
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# short forms, and strings longer than the 256 byte ring
+i=0
+while [ $i -lt 200 ]; do
+  echo "(+ $i 1)"
+  if [ $((i % 50)) -eq 0 ]; then
+    printf '(string-length "'
+    j=0
+    while [ $j -lt 60 ]; do printf 'abcdefghij'; j=$((j + 1)); done
+    echo '")'
+  fi
+  i=$((i + 1))
+done >"$dir/in"
+forms=$(grep -c . "$dir/in")
+bytes=$(wc -c <"$dir/in")
+
+for baud in "$@"; do
+  LISPDOOR_BAUD=$baud REPL_STATS="$dir/stats" \
+    sh "$(dirname "$0")/repl.sh" "$repl" "$dir/in" >"$dir/out" || true
+  grep -q "hostrepl: $bytes bytes in .*, 0 overruns" "$dir/stats" || {
+    echo "baud $baud: expected $bytes bytes and no overruns:" >&2
+    cat "$dir/stats" >&2
+    exit 1
+  }
+  [ "$(grep -c . "$dir/out")" -eq "$forms" ] || {
+    echo "baud $baud: expected $forms results, got $(grep -c . "$dir/out")" >&2
+    exit 1
+  }
+  grep -qx 600 "$dir/out"
+  grep -qx 200 "$dir/out"
+  echo "baud $baud: $(tail -n 1 "$dir/stats")"
+done
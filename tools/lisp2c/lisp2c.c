@@ -0,0 +1,869 @@
+/*
+ *    \file lisp2c.c
+ *
+ * Copyright (c) 2020 Islam Omar (io1131@fayoum.edu.eg)
+ *
+ * This file is part of LispDoor.
+ *
+ *     LispDoor is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 2 of the License, or
+ *     (at your option) any later version.
+ *
+ *     LispDoor is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with LispDoor.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This file incorporates work covered by the following copyrights and
+ * permission notices:
+ *
+ *    Copyright (c) 2008 Jeff Bezanson
+ *
+ *    All rights reserved.
+ *
+ *    Redistribution and use in source and binary forms, with or without
+ *    modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *        * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *        * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *        * Neither the author nor the names of any contributors may be used to
+ *          endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ *    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *    Copyright (c) 1984, Taiichi Yuasa and Masami Hagiya.
+ *    Copyright (c) 1990, Giuseppe Attardi.
+ *    Copyright (c) 2001, Juan Jose Garcia Ripoll.
+ *
+ *    ECL is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Library General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2 of the License, or (at your option) any later version.
+ */
+
+/*
+ * lisp2c: compile top level function definitions of a lisp file to C
+ *
+ *     lisp2c input.lisp output.c
+ *
+ * Every top level form must be (set (quote name) (lambda (args ...) body))
+ * or (define-inline name (args ...) body); calls to the latter are direct
+ * calls to a static function, which the C compiler is free to inline.
+ * Each definition becomes a LispFunc, registered as a kCFunction under name
+ * by LispInitCompiled(). LispInit calls it when LISP_COMPILED is defined,
+ * which the firmware build does when the cmake cache variable
+ * LISPDOOR_COMPILED names the output, e.g. -DLISPDOOR_COMPILED=output.c.
+ *
+ * Compiled bodies support constants, quote, argument and global variable
+ * references, set, if, cond, case, and, or, progn, while and calls. Calls to
+ * functions compiled earlier in the same file are direct C calls, car, cdr,
+ * cons, eq, atom, consp, symbolp, fixnump, not and fixnum +, -, *, < are open
+ * coded and fall back to the global function for other types, everything
+ * else is called through the symbol's value at run time. lambda, label and
+ * macros are not supported, free variables are global.
+ *
+ * Generated code follows the interpreter's rooting discipline: values live
+ * on the lisp stack across anything that allocates, v only holds the last
+ * result.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hal/bsp.h"
+#include "lispdoor/eval.h"
+#include "lispdoor/functions.h"
+#include "lispdoor/memorylayout.h"
+#include "lispdoor/objects.h"
+#include "lispdoor/print.h"
+#undef EOF /* the reader's EOF is a byte */
+#include "lispdoor/read.h"
+#include "lispdoor/symboltree.h"
+
+#define MAX_PARAMS 16
+
+typedef struct {
+  char *s;
+  size_t len, size;
+} Text;
+
+typedef struct {
+  char *name;
+  char *c_name;
+  int nparams;
+} Function;
+
+static Text prototypes, functions, init;
+static char **constants; /* symbol names, NULL for other data */
+static int n_constants;
+static Function *compiled;
+static int n_compiled;
+
+/* function being compiled */
+static LispObject params[MAX_PARAMS];
+static int n_params;
+static const char *current = "";
+
+static void Fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "lisp2c: error: %s: ", current);
+  vfprintf(stderr, fmt, ap);
+  fputc('\n', stderr);
+  va_end(ap);
+  exit(1);
+}
+
+static void *XAlloc(void *p, size_t n) {
+  p = realloc(p, n);
+  if (p == NULL) {
+    Fail("out of memory");
+  }
+  return p;
+}
+
+static char *XStrDup(const char *s) {
+  char *d = XAlloc(NULL, strlen(s) + 1);
+  strcpy(d, s);
+  return d;
+}
+
+static void Reserve(Text *t, size_t n) {
+  if (t->len + n + 1 > t->size) {
+    t->size = 2 * (t->len + n + 1);
+    t->s = XAlloc(t->s, t->size);
+  }
+}
+
+/* one line of C at indent */
+static void Emit(Text *t, int indent, const char *fmt, ...) {
+  va_list ap;
+  int n;
+  va_start(ap, fmt);
+  n = vsnprintf(NULL, 0, fmt, ap);
+  va_end(ap);
+  Reserve(t, (size_t)(2 * indent + n + 1));
+  memset(t->s + t->len, ' ', (size_t)(2 * indent));
+  t->len += (size_t)(2 * indent);
+  va_start(ap, fmt);
+  vsnprintf(t->s + t->len, (size_t)n + 1, fmt, ap);
+  va_end(ap);
+  t->len += (size_t)n;
+  t->s[t->len++] = '\n';
+  t->s[t->len] = '\0';
+}
+
+/* C identifier for a lisp name, one to one: '-' is "__" and any other
+   character but a letter or digit, '_' too, is '_' and two hex digits,
+   which are never '_' */
+static char *Mangle(const char *name) {
+  char *c_name = XAlloc(NULL, 3 * strlen(name) + 4);
+  char *p = c_name + sprintf(c_name, "Lc_");
+  for (; *name; ++name) {
+    if (isalnum((unsigned char)*name)) {
+      *p++ = *name;
+    } else if (*name == '-') {
+      p += sprintf(p, "__");
+    } else {
+      p += sprintf(p, "_%02x", (unsigned char)*name);
+    }
+  }
+  *p = '\0';
+  return c_name;
+}
+
+static const char *Name(LispObject sym) { return LispSymbolName(sym); }
+
+static bool SymbolIs(LispObject x, const char *name) {
+  return LISP_SymbolP(x) && strcmp(Name(x), name) == 0;
+}
+
+static int ListLength(LispObject x) {
+  int n = 0;
+  while (LISP_ConsP(x)) {
+    n++;
+    x = LISP_CONS_CDR(x);
+  }
+  if (!LISP_NULL(x)) {
+    Fail("dotted list in code");
+  }
+  return n;
+}
+
+static int ParamIndex(LispObject sym) {
+  int i;
+  for (i = 0; i < n_params; ++i) {
+    if (params[i] == sym) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static Function *FindCompiled(const char *name) {
+  int i;
+  for (i = 0; i < n_compiled; ++i) {
+    if (strcmp(compiled[i].name, name) == 0) {
+      return &compiled[i];
+    }
+  }
+  return NULL;
+}
+
+/* immediate objects are emitted as C expressions */
+static bool ImmediateP(LispObject x) {
+  return LISP_NULL(x) || x == LISP_T || LISP_FixNumP(x) ||
+         LISP_CharacterP(x) || LISP_Q15P(x);
+}
+
+static void EmitImmediate(Text *t, int indent, const char *dst,
+                          LispObject x) {
+  if (LISP_NULL(x)) {
+    Emit(t, indent, "%s = LISP_NIL;", dst);
+  } else if (x == LISP_T) {
+    Emit(t, indent, "%s = LISP_T;", dst);
+  } else if (LISP_FixNumP(x)) {
+    Emit(t, indent, "%s = LISP_MAKE_FIXNUM(%ld);", dst,
+         (long)LISP_FIXNUM(x));
+  } else if (LISP_Q15P(x)) {
+    Emit(t, indent, "%s = LISP_MAKE_Q15(%d);", dst, (int)LISP_Q15(x));
+  } else {
+    Emit(t, indent, "%s = LISP_MAKE_CHARACTER(%ld);", dst,
+         (long)LISP_CHAR_CODE(x));
+  }
+}
+
+/* init code leaving data x in v */
+static void EmitData(LispObject x, int indent) {
+  if (ImmediateP(x)) {
+    EmitImmediate(&init, indent, "v", x);
+  } else if (LISP_SymbolP(x)) {
+    Emit(&init, indent, "v = LispMakeSymbol(\"%s\");", Name(x));
+  } else if (LISP_ConsP(x)) {
+    EmitData(LISP_CONS_CAR(x), indent);
+    Emit(&init, indent, "PUSH(v);");
+    EmitData(LISP_CONS_CDR(x), indent);
+    Emit(&init, indent, "v = cons(stack[stack_index - 1], v);");
+    Emit(&init, indent, "POPN(1);");
+  } else if (LISP_TYPE_OF(x) == kString) {
+    char *lit = XAlloc(NULL, 4 * (size_t)x->string.size + 1), *p = lit;
+    LispIndex i;
+    for (i = 0; i < x->string.size; ++i) {
+      unsigned char c = (unsigned char)x->string.self[i];
+      if (c == '"' || c == '\\') {
+        p += sprintf(p, "\\%c", c);
+      } else if (isprint(c)) {
+        *p++ = (char)c;
+      } else {
+        p += sprintf(p, "\\%03o", c);
+      }
+    }
+    *p = '\0';
+    Emit(&init, indent, "v = LispMakeString(\"%s\");", lit);
+    free(lit);
+  } else if (LISP_TYPE_OF(x) == kVector) {
+    LispIndex i;
+    Emit(&init, indent, "PUSH(LispMakeVector(%u));", x->vector.fillp);
+    for (i = 0; i < x->vector.fillp; ++i) {
+      EmitData(x->vector.self[i], indent);
+      Emit(&init, indent,
+           "stack[stack_index - 1] = LispVectorPush(stack[stack_index - 1], "
+           "v);");
+    }
+    Emit(&init, indent, "v = POP();");
+  } else if (LISP_TYPE_OF(x) == kSingleFloat) {
+    /* hex float literals are exact */
+    Emit(&init, indent, "v = LispMakeSingleFloat(%af);",
+         (double)LISP_SINGLE_FLOAT(x));
+  } else if (LISP_TYPE_OF(x) == kDoubleFloat) {
+    Emit(&init, indent, "v = LispMakeDoubleFloat(%a);", LISP_DOUBLE_FLOAT(x));
+  } else if (LISP_TYPE_OF(x) == kQ31) {
+    Emit(&init, indent, "v = LispMakeQ31(%ld);", (long)LISP_Q31(x));
+  } else {
+    Fail("unsupported constant type");
+  }
+}
+
+/* index of a constant in compiled_constants */
+static int Constant(LispObject x) {
+  int i;
+  if (LISP_SymbolP(x)) {
+    for (i = 0; i < n_constants; ++i) {
+      if (constants[i] != NULL && strcmp(constants[i], Name(x)) == 0) {
+        return i;
+      }
+    }
+  }
+  constants = XAlloc(constants, sizeof(char *) * (size_t)(n_constants + 1));
+  constants[n_constants] = LISP_SymbolP(x) ? XStrDup(Name(x)) : NULL;
+  EmitData(x, 1);
+  Emit(&init, 1, "K(%d) = v;", n_constants);
+  return n_constants++;
+}
+
+static void CompExpr(LispObject x, int depth, int indent);
+
+/* restore the stack after a call, depth temporaries stay */
+static void EmitRestore(int depth, int indent) {
+  Emit(&functions, indent, "stack_index = (LispIndex)(sp + %d);", depth);
+}
+
+/* evaluate args onto the stack above depth */
+static int CompArgs(LispObject args, int depth, int indent) {
+  int n = 0;
+  while (LISP_ConsP(args)) {
+    CompExpr(LISP_CONS_CAR(args), depth + n, indent);
+    Emit(&functions, indent, "PUSH(v);");
+    args = LISP_CONS_CDR(args);
+    n++;
+  }
+  return n;
+}
+
+static void CompBody(LispObject body, int depth, int indent) {
+  if (LISP_NULL(body)) {
+    Emit(&functions, indent, "v = LISP_NIL;");
+  }
+  while (LISP_ConsP(body)) {
+    CompExpr(LISP_CONS_CAR(body), depth, indent);
+    body = LISP_CONS_CDR(body);
+  }
+}
+
+static void CompGlobalCall(LispObject f, LispObject args, int depth,
+                           int indent) {
+  int n = CompArgs(args, depth, indent);
+  Emit(&functions, indent, "v = LcCallGlobal(K(%d), %d);", Constant(f), n);
+  EmitRestore(depth, indent);
+}
+
+/* open coded builtins, false when f is not one of them */
+static bool CompInline(LispObject f, LispObject args, int depth,
+                       int indent) {
+  static const char *unary[][2] = {
+      {"atom", "LISP_MAKE_BOOL(LISP_ATOM(v))"},
+      {"consp", "LISP_MAKE_BOOL(LISP_ConsP(v))"},
+      {"symbolp", "LISP_MAKE_BOOL(LISP_SymbolP(v))"},
+      {"fixnump", "LISP_MAKE_BOOL(LISP_FixNumP(v))"},
+      {"not", "LISP_MAKE_BOOL(LISP_NULL(v))"}};
+  static const char *arith[][2] = {{"+", "+"}, {"-", "-"}, {"*", "*"}};
+  const char *name = Name(f);
+  LispObject v = f->symbol.value;
+  int n = ListLength(args), i, k;
+  if (ParamIndex(f) >= 0 || LISP_UNBOUNDP(v) || !LISP_CFunctionP(v) ||
+      strcmp(v->cfun.name, name) != 0) {
+    return false;
+  }
+  for (i = 0; i < (int)(sizeof(unary) / sizeof(unary[0])); ++i) {
+    if (n == 1 && strcmp(name, unary[i][0]) == 0) {
+      CompExpr(LISP_CONS_CAR(args), depth, indent);
+      Emit(&functions, indent, "v = %s;", unary[i][1]);
+      return true;
+    }
+  }
+  if (n == 1 && (strcmp(name, "car") == 0 || strcmp(name, "cdr") == 0)) {
+    k = Constant(f);
+    CompExpr(LISP_CONS_CAR(args), depth, indent);
+    Emit(&functions, indent, "if (LISP_ConsP(v)) {");
+    Emit(&functions, indent + 1, "v = LISP_CONS_%s(v);",
+         name[1] == 'a' ? "CAR" : "CDR");
+    Emit(&functions, indent, "} else {");
+    Emit(&functions, indent + 1, "PUSH(v);");
+    Emit(&functions, indent + 1, "v = LcCallGlobal(K(%d), 1);", k);
+    EmitRestore(depth, indent + 1);
+    Emit(&functions, indent, "}");
+    return true;
+  }
+  if (n != 2) {
+    return false;
+  }
+  if (strcmp(name, "cons") == 0 || strcmp(name, "eq") == 0) {
+    CompExpr(LISP_CONS_CAR(args), depth, indent);
+    Emit(&functions, indent, "PUSH(v);");
+    CompExpr(LISP_CONS_CAR(LISP_CONS_CDR(args)), depth + 1, indent);
+    if (name[0] == 'c') {
+      Emit(&functions, indent, "v = cons(stack[sp + %d], v);", depth);
+    } else {
+      Emit(&functions, indent, "v = LISP_MAKE_BOOL(stack[sp + %d] == v);",
+           depth);
+    }
+    EmitRestore(depth, indent);
+    return true;
+  }
+  for (i = 0; i < 4; ++i) {
+    if (i == 3 ? strcmp(name, "<") == 0 : strcmp(name, arith[i][0]) == 0) {
+      k = Constant(f);
+      CompExpr(LISP_CONS_CAR(args), depth, indent);
+      Emit(&functions, indent, "PUSH(v);");
+      CompExpr(LISP_CONS_CAR(LISP_CONS_CDR(args)), depth + 1, indent);
+      Emit(&functions, indent,
+           "if (LISP_FixNumP(stack[sp + %d]) && LISP_FixNumP(v)) {", depth);
+      if (i == 3) {
+        Emit(&functions, indent + 1,
+             "v = LISP_MAKE_BOOL(LISP_FIXNUM_LOWER(stack[sp + %d], v));",
+             depth);
+      } else {
+        Emit(&functions, indent + 1,
+             "v = LISP_MAKE_FIXNUM(LISP_FIXNUM(stack[sp + %d]) %s "
+             "LISP_FIXNUM(v));",
+             depth, arith[i][1]);
+      }
+      Emit(&functions, indent, "} else {");
+      Emit(&functions, indent + 1, "PUSH(v);");
+      Emit(&functions, indent + 1, "v = LcCallGlobal(K(%d), 2);", k);
+      Emit(&functions, indent, "}");
+      EmitRestore(depth, indent);
+      return true;
+    }
+  }
+  return false;
+}
+
+static void CompCall(LispObject x, int depth, int indent) {
+  LispObject f = LISP_CONS_CAR(x), args = LISP_CONS_CDR(x), v;
+  Function *fn;
+  int i, n;
+  if (!LISP_SymbolP(f)) {
+    Fail("operator must be a symbol");
+  }
+  if ((i = ParamIndex(f)) >= 0) {
+    /* function passed as argument */
+    Emit(&functions, indent, "PUSH(arg[%d]);", i);
+    n = CompArgs(args, depth + 1, indent);
+    Emit(&functions, indent, "v = LispFuncall(%d);", n);
+    EmitRestore(depth, indent);
+    return;
+  }
+  if ((fn = FindCompiled(Name(f))) != NULL) {
+    n = CompArgs(args, depth, indent);
+    if (n != fn->nparams) {
+      Fail("%s called with %d arguments, expected %d", fn->name, n,
+           fn->nparams);
+    }
+    Emit(&functions, indent, "v = %s(%d);", fn->c_name, n);
+    EmitRestore(depth, indent);
+    return;
+  }
+  v = f->symbol.value;
+  if (!LISP_UNBOUNDP(v) &&
+      ((LISP_CFunctionP(v) && LISP_CFUNCTION_SPECIALP(v)) ||
+       (LISP_ConsP(v) && SymbolIs(LISP_CONS_CAR(v), "macro")))) {
+    Fail("%s is not supported in compiled code", Name(f));
+  }
+  if (!CompInline(f, args, depth, indent)) {
+    CompGlobalCall(f, args, depth, indent);
+  }
+}
+
+static void CompIf(LispObject args, int depth, int indent) {
+  CompExpr(LISP_CONS_CAR(args), depth, indent);
+  args = LISP_CONS_CDR(args);
+  Emit(&functions, indent, "if (!LISP_NULL(v)) {");
+  CompExpr(LISP_ConsP(args) ? LISP_CONS_CAR(args) : LISP_NIL, depth,
+           indent + 1);
+  args = LISP_ConsP(args) ? LISP_CONS_CDR(args) : LISP_NIL;
+  Emit(&functions, indent, "} else {");
+  /* only the first else form counts, as in LdIf */
+  CompExpr(LISP_ConsP(args) ? LISP_CONS_CAR(args) : LISP_NIL, depth,
+           indent + 1);
+  Emit(&functions, indent, "}");
+}
+
+static void CompCond(LispObject clauses, int depth, int indent) {
+  Emit(&functions, indent, "do {");
+  while (LISP_ConsP(clauses)) {
+    LispObject clause = LISP_CONS_CAR(clauses);
+    if (!LISP_ConsP(clause)) {
+      Fail("malformed cond clause");
+    }
+    CompExpr(LISP_CONS_CAR(clause), depth, indent + 1);
+    Emit(&functions, indent + 1, "if (!LISP_NULL(v)) {");
+    /* a clause without body yields nil, as in LdCond */
+    CompBody(LISP_CONS_CDR(clause), depth, indent + 2);
+    Emit(&functions, indent + 2, "break;");
+    Emit(&functions, indent + 1, "}");
+    clauses = LISP_CONS_CDR(clauses);
+  }
+  Emit(&functions, indent + 1, "v = LISP_NIL;");
+  Emit(&functions, indent, "} while (0);");
+}
+
+/* append to cond an eq test of the case key at depth against key */
+static void CaseTest(Text *cond, LispObject key, int depth) {
+  char test[64];
+  if (!(LISP_SymbolP(key) || ImmediateP(key))) {
+    Fail("case keys must be symbols, characters or fixnums");
+  }
+  if (LISP_FixNumP(key)) {
+    snprintf(test, sizeof(test), "LISP_MAKE_FIXNUM(%ld)",
+             (long)LISP_FIXNUM(key));
+  } else if (LISP_CharacterP(key)) {
+    snprintf(test, sizeof(test), "LISP_MAKE_CHARACTER(%ld)",
+             (long)LISP_CHAR_CODE(key));
+  } else {
+    snprintf(test, sizeof(test), "K(%d)", Constant(key));
+  }
+  Reserve(cond, strlen(test) + 32);
+  cond->len += (size_t)sprintf(cond->s + cond->len, "%sstack[sp + %d] == %s",
+                               cond->len > 0 ? " || " : "", depth, test);
+}
+
+/* a chain of eq tests, the c compiler is left to build a jump table */
+static void CompCase(LispObject args, int depth, int indent) {
+  LispObject clauses, keys;
+  if (!LISP_ConsP(args)) {
+    Fail("case expects a key");
+  }
+  CompExpr(LISP_CONS_CAR(args), depth, indent);
+  Emit(&functions, indent, "PUSH(v);");
+  Emit(&functions, indent, "do {");
+  for (clauses = LISP_CONS_CDR(args); LISP_ConsP(clauses);
+       clauses = LISP_CONS_CDR(clauses)) {
+    LispObject clause = LISP_CONS_CAR(clauses);
+    if (!LISP_ConsP(clause)) {
+      Fail("malformed case clause");
+    }
+    keys = LISP_CONS_CAR(clause);
+    if (keys == LISP_T || SymbolIs(keys, "t") || SymbolIs(keys, "otherwise")) {
+      Emit(&functions, indent + 1, "{");
+    } else {
+      Text cond = {NULL, 0, 0};
+      Reserve(&cond, 1);
+      cond.s[0] = '\0';
+      while (!LISP_NULL(keys)) {
+        CaseTest(&cond, LISP_ConsP(keys) ? LISP_CONS_CAR(keys) : keys, depth);
+        keys = LISP_ConsP(keys) ? LISP_CONS_CDR(keys) : LISP_NIL;
+      }
+      Emit(&functions, indent + 1, "if (%s) {", cond.len > 0 ? cond.s : "0");
+      free(cond.s);
+    }
+    CompBody(LISP_CONS_CDR(clause), depth + 1, indent + 2);
+    Emit(&functions, indent + 2, "break;");
+    Emit(&functions, indent + 1, "}");
+  }
+  Emit(&functions, indent + 1, "v = LISP_NIL;");
+  Emit(&functions, indent, "} while (0);");
+  EmitRestore(depth, indent);
+}
+
+static void CompAndOr(LispObject args, bool and_p, int depth, int indent) {
+  if (LISP_NULL(args)) {
+    Emit(&functions, indent, "v = %s;", and_p ? "LISP_T" : "LISP_NIL");
+    return;
+  }
+  Emit(&functions, indent, "do {");
+  while (LISP_ConsP(LISP_CONS_CDR(args))) {
+    CompExpr(LISP_CONS_CAR(args), depth, indent + 1);
+    if (and_p) {
+      Emit(&functions, indent + 1, "if (LISP_NULL(v)) break;");
+    } else {
+      /* or yields t, not the value, as in LdOr */
+      Emit(&functions, indent + 1, "if (!LISP_NULL(v)) {");
+      Emit(&functions, indent + 2, "v = LISP_T;");
+      Emit(&functions, indent + 2, "break;");
+      Emit(&functions, indent + 1, "}");
+    }
+    args = LISP_CONS_CDR(args);
+  }
+  CompExpr(LISP_CONS_CAR(args), depth, indent + 1);
+  Emit(&functions, indent, "} while (0);");
+}
+
+static void CompWhile(LispObject args, int depth, int indent) {
+  LispObject body;
+  Emit(&functions, indent, "PUSH(LISP_NIL);");
+  Emit(&functions, indent, "for (;;) {");
+  CompExpr(LISP_CONS_CAR(args), depth + 1, indent + 1);
+  Emit(&functions, indent + 1, "if (LISP_NULL(v)) break;");
+  for (body = LISP_CONS_CDR(args); LISP_ConsP(body);
+       body = LISP_CONS_CDR(body)) {
+    CompExpr(LISP_CONS_CAR(body), depth + 1, indent + 1);
+    Emit(&functions, indent + 1, "stack[sp + %d] = v;", depth);
+  }
+  Emit(&functions, indent, "}");
+  Emit(&functions, indent, "v = stack[sp + %d];", depth);
+  EmitRestore(depth, indent);
+}
+
+static void CompSet(LispObject x, int depth, int indent) {
+  LispObject args = LISP_CONS_CDR(x), place = LISP_CONS_CAR(args);
+  int i;
+  if (ListLength(args) != 2) {
+    Fail("set expects 2 arguments");
+  }
+  if (LISP_ConsP(place) && SymbolIs(LISP_CONS_CAR(place), "quote") &&
+      LISP_SymbolP(LISP_CONS_CAR(LISP_CONS_CDR(place)))) {
+    LispObject sym = LISP_CONS_CAR(LISP_CONS_CDR(place));
+    CompExpr(LISP_CONS_CAR(LISP_CONS_CDR(args)), depth, indent);
+    if ((i = ParamIndex(sym)) >= 0) {
+      Emit(&functions, indent, "arg[%d] = v;", i);
+    } else {
+      Emit(&functions, indent, "v = LcSetGlobal(K(%d), v);", Constant(sym));
+    }
+  } else {
+    CompGlobalCall(LISP_CONS_CAR(x), args, depth, indent);
+  }
+}
+
+/* code leaving the value of x in v, depth temporaries are on the stack */
+static void CompExpr(LispObject x, int depth, int indent) {
+  int i;
+  if (LISP_SymbolP(x)) {
+    if ((i = ParamIndex(x)) >= 0) {
+      Emit(&functions, indent, "v = arg[%d];", i);
+    } else if (LISP_SYMBOL_CONSTANTP(x) && ImmediateP(x->symbol.value)) {
+      EmitImmediate(&functions, indent, "v", x->symbol.value);
+    } else {
+      Emit(&functions, indent, "v = LcSymbolValue(K(%d));", Constant(x));
+    }
+  } else if (ImmediateP(x)) {
+    EmitImmediate(&functions, indent, "v", x);
+  } else if (!LISP_ConsP(x)) {
+    Emit(&functions, indent, "v = K(%d);", Constant(x));
+  } else {
+    LispObject f = LISP_CONS_CAR(x), args = LISP_CONS_CDR(x);
+    ListLength(x);
+    if (LISP_SymbolP(f) && ParamIndex(f) < 0) {
+      const char *name = Name(f);
+      if (strcmp(name, "quote") == 0) {
+        LispObject q = LISP_CONS_CAR_SAFE(args);
+        if (ImmediateP(q)) {
+          EmitImmediate(&functions, indent, "v", q);
+        } else {
+          Emit(&functions, indent, "v = K(%d);", Constant(q));
+        }
+        return;
+      } else if (strcmp(name, "if") == 0) {
+        CompIf(args, depth, indent);
+        return;
+      } else if (strcmp(name, "cond") == 0) {
+        CompCond(args, depth, indent);
+        return;
+      } else if (strcmp(name, "case") == 0) {
+        CompCase(args, depth, indent);
+        return;
+      } else if (strcmp(name, "and") == 0 || strcmp(name, "or") == 0) {
+        CompAndOr(args, name[0] == 'a', depth, indent);
+        return;
+      } else if (strcmp(name, "progn") == 0) {
+        CompBody(args, depth, indent);
+        return;
+      } else if (strcmp(name, "while") == 0) {
+        CompWhile(args, depth, indent);
+        return;
+      } else if (strcmp(name, "set") == 0) {
+        CompSet(x, depth, indent);
+        return;
+      }
+    }
+    CompCall(x, depth, indent);
+  }
+}
+
+static void CompDefinition(LispObject form) {
+  LispObject name, lambda, arg_syms;
+  Function *fn;
+  if (LISP_ConsP(form) && SymbolIs(LISP_CONS_CAR(form), "define-inline") &&
+      ListLength(form) == 4 && LISP_SymbolP(LISP_CONS_CAR(LISP_CONS_CDR(form)))) {
+    /* (define-inline name (args ...) body), (name (args ...) body) has the
+       shape of the lambda */
+    lambda = LISP_CONS_CDR(form);
+    name = LISP_CONS_CAR(lambda);
+    current = Name(name);
+  } else {
+    /* (set (quote name) (lambda (args ...) body)) */
+    if (!(LISP_ConsP(form) && SymbolIs(LISP_CONS_CAR(form), "set") &&
+          ListLength(form) == 3)) {
+      Fail("top level form is not (set (quote name) (lambda ...))");
+    }
+    name = LISP_CONS_CAR(LISP_CONS_CDR(form));
+    lambda = LISP_CONS_CAR(LISP_CONS_CDR(LISP_CONS_CDR(form)));
+    if (!(LISP_ConsP(name) && SymbolIs(LISP_CONS_CAR(name), "quote") &&
+          LISP_SymbolP(LISP_CONS_CAR_SAFE(LISP_CONS_CDR(name))))) {
+      Fail("defined name is not a quoted symbol");
+    }
+    name = LISP_CONS_CAR(LISP_CONS_CDR(name));
+    current = Name(name);
+    if (!(LISP_ConsP(lambda) && SymbolIs(LISP_CONS_CAR(lambda), "lambda") &&
+          ListLength(lambda) == 3)) {
+      Fail("value is not (lambda args body)");
+    }
+  }
+  arg_syms = LISP_CONS_CAR(LISP_CONS_CDR(lambda));
+  for (n_params = 0; LISP_ConsP(arg_syms); ++n_params) {
+    if (n_params == MAX_PARAMS || !LISP_SymbolP(LISP_CONS_CAR(arg_syms))) {
+      Fail("too many or malformed arguments");
+    }
+    params[n_params] = LISP_CONS_CAR(arg_syms);
+    arg_syms = LISP_CONS_CDR(arg_syms);
+  }
+  if (!LISP_NULL(arg_syms)) {
+    Fail("rest arguments are not supported");
+  }
+  if (FindCompiled(Name(name)) != NULL) {
+    Fail("defined twice");
+  }
+  compiled = XAlloc(compiled, sizeof(Function) * (size_t)(n_compiled + 1));
+  fn = &compiled[n_compiled++];
+  fn->name = XStrDup(Name(name));
+  fn->c_name = Mangle(fn->name);
+  fn->nparams = n_params;
+
+  Emit(&prototypes, 0, "static LispObject %s(LispNArg narg);", fn->c_name);
+  Emit(&functions, 0, "/* %s */", fn->name);
+  Emit(&functions, 0, "static LispObject %s(LispNArg narg) {", fn->c_name);
+  Emit(&functions, 1, "LispObject *arg = &stack[stack_index - narg], v;");
+  Emit(&functions, 1, "LispIndex sp = stack_index;");
+  Emit(&functions, 1, "if ((Byte *)&v < stack_bottom) {");
+  Emit(&functions, 2, "LispError(\"eval: error: c-stack overflow\\n\");");
+  Emit(&functions, 1, "}");
+  Emit(&functions, 1, "(void)arg;");
+  Emit(&functions, 1, "/* free variables are global */");
+  Emit(&functions, 1, "LispEnv()->frame = LISP_NIL;");
+  CompExpr(LISP_CONS_CAR(LISP_CONS_CDR(LISP_CONS_CDR(lambda))), 0, 1);
+  Emit(&functions, 1, "stack_index = sp;");
+  Emit(&functions, 1, "return v;");
+  Emit(&functions, 0, "}\n");
+  Emit(&init, 1, "v = LispMakeCFunction(\"%s\", %s, %d, %d, "
+       "kFunctionAllocating);", fn->name, fn->c_name, n_params, n_params);
+  Emit(&init, 1, "PUSH(v);");
+  Emit(&init, 1, "o = LispMakeSymbol(\"%s\");", fn->name);
+  Emit(&init, 1, "o->symbol.value = POP();");
+}
+
+static const char *prelude =
+    "#include \"lispdoor/eval.h\"\n"
+    "#include \"lispdoor/functions.h\"\n"
+    "#include \"lispdoor/memorylayout.h\"\n"
+    "#include \"lispdoor/objects.h\"\n"
+    "#include \"lispdoor/print.h\"\n"
+    "#include \"lispdoor/symboltree.h\"\n"
+    "\n"
+    "#define K(i) (compiled_constants->vector.self[i])\n"
+    "\n"
+    "static inline LispObject LcSymbolValue(LispObject sym) {\n"
+    "  if (LISP_UNBOUNDP(sym->symbol.value)) {\n"
+    "    LispErrorBegin();\n"
+    "    LispPrintStr(\"eval: error: variable \");\n"
+    "    LispPrintStr(LispSymbolName(sym));\n"
+    "    LispError(\" has no value\\n\");\n"
+    "  }\n"
+    "  return sym->symbol.value;\n"
+    "}\n"
+    "static inline LispObject LcSetGlobal(LispObject sym, LispObject v) {\n"
+    "  if (LISP_SYMBOL_CONSTANTP(sym)) {\n"
+    "    LispErrorBegin();\n"
+    "    LispPrintStr(\"set: error: constant \");\n"
+    "    LispPrintStr(LispSymbolName(sym));\n"
+    "    LispError(\" cannot be set\\n\");\n"
+    "  }\n"
+    "  return sym->symbol.value = v;\n"
+    "}\n"
+    "/* call the global function of sym on the nargs values on the stack */\n"
+    "static inline LispObject LcCallGlobal(LispObject sym, LispIndex nargs) {\n"
+    "  LispIndex i;\n"
+    "  PUSH(LcSymbolValue(sym));\n"
+    "  for (i = 0; i < nargs; ++i) {\n"
+    "    LispObject a = stack[stack_index - 2 - i];\n"
+    "    stack[stack_index - 2 - i] = stack[stack_index - 1 - i];\n"
+    "    stack[stack_index - 1 - i] = a;\n"
+    "  }\n"
+    "  return LispFuncall(nargs);\n"
+    "}\n";
+
+static void Write(FILE *out, const char *source) {
+  fprintf(out, "/* generated by lisp2c from %s, do not edit */\n", source);
+  fputs(prelude, out);
+  fputc('\n', out);
+  if (prototypes.s != NULL) {
+    fputs(prototypes.s, out);
+    fputc('\n', out);
+  }
+  if (functions.s != NULL) {
+    fputs(functions.s, out);
+  }
+  fprintf(out, "void LispInitCompiled(void) {\n");
+  fprintf(out, "  LispObject o, v;\n");
+  fprintf(out, "  LispIndex i;\n");
+  fprintf(out, "  (void)o;\n");
+  fprintf(out, "  v = LispMakeVector(%d);\n", n_constants ? n_constants : 1);
+  fprintf(out, "  for (i = 0; i < v->vector.size; ++i) {\n");
+  fprintf(out, "    v->vector.self[i] = LISP_NIL;\n");
+  fprintf(out, "  }\n");
+  fprintf(out, "  v->vector.fillp = v->vector.size;\n");
+  fprintf(out, "  compiled_constants = v;\n");
+  if (init.s != NULL) {
+    fputs(init.s, out);
+  }
+  fprintf(out, "}\n");
+}
+
+/* the whole source, the reader takes it as a memory stream */
+static uint8_t *ReadFile(const char *name, uint32_t *len) {
+  FILE *in = fopen(name, "rb");
+  uint8_t *buf = NULL;
+  long n;
+  if (in == NULL || fseek(in, 0, SEEK_END) != 0 || (n = ftell(in)) < 0 ||
+      fseek(in, 0, SEEK_SET) != 0 || (buf = malloc((size_t)n + 1)) == NULL ||
+      fread(buf, 1, (size_t)n, in) != (size_t)n) {
+    perror(name);
+    exit(1);
+  }
+  fclose(in);
+  *len = (uint32_t)n;
+  return buf;
+}
+
+int main(int argc, char *argv[]) {
+  static LispStream in;
+  FILE *out;
+  LispObject form;
+  uint8_t *src;
+  uint32_t len;
+  if (argc != 3) {
+    fprintf(stderr, "usage: lisp2c input.lisp output.c\n");
+    return 1;
+  }
+  src = ReadFile(argv[1], &len);
+  LispStreamInitMemory(&in, src, len);
+  stack_bottom = NULL;
+  if (setjmp(LispEnv()->top_level) != 0) {
+    /* the reader reported the error */
+    fprintf(stderr, "%s: near byte %lu\n", argv[1],
+            (unsigned long)in.ops->position(&in));
+    return 1;
+  }
+  LispInit();
+  while ((form = ReadSexpr(&in)) != LISP_UNBOUND) {
+    CompDefinition(form);
+    stack_index = 0;
+  }
+  out = fopen(argv[2], "w");
+  if (out == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+  Write(out, argv[1]);
+  fclose(out);
+  return 0;
+}